@@ -0,0 +1,229 @@
+#include "audio_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <miniaudio.h>
+
+void audio_sink::pull(std::span<int16_t> out)
+{
+    if (!started_ && ring_.size() < prebuffer_)
+    {
+        std::fill(out.begin(), out.end(), int16_t{0});
+        return;
+    }
+    started_ = true;
+
+    const size_t count = ring_.read(out);
+    std::fill(out.begin() + static_cast<std::ptrdiff_t>(count), out.end(), int16_t{0});
+    if (count < out.size())
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace
+{
+    // plays through miniaudio, which pulls samples from its own thread whenever the device needs them
+    class device_sink : public audio_sink
+    {
+    public:
+        device_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer) :
+            audio_sink(ring, prebuffer)
+        {
+            ma_device_config config = ma_device_config_init(ma_device_type_playback);
+            config.playback.format = ma_format_s16;
+            config.playback.channels = 2;
+            config.sampleRate = sample_rate;
+            config.dataCallback = &device_sink::callback;
+            config.pUserData = this;
+
+            if (ma_device_init(nullptr, &config, &device_) != MA_SUCCESS)
+                throw std::runtime_error("Failed to open the sound device");
+            if (ma_device_start(&device_) != MA_SUCCESS)
+            {
+                ma_device_uninit(&device_);
+                throw std::runtime_error("Failed to start the sound device");
+            }
+        }
+
+        ~device_sink() override
+        {
+            ma_device_uninit(&device_);
+        }
+
+        device_sink(const device_sink&) = delete;
+        device_sink& operator=(const device_sink&) = delete;
+
+        [[nodiscard]] uint32_t sample_rate() const override
+        {
+            return device_.sampleRate;
+        }
+
+    private:
+        static void callback(ma_device* device, void* output, const void*, ma_uint32 frames)
+        {
+            auto* sink = static_cast<device_sink*>(device->pUserData);
+            sink->pull({static_cast<int16_t*>(output), size_t{frames} * 2});
+        }
+
+        ma_device device_ {};
+    };
+
+    // stands in for a device: a thread pulling a period's worth of samples every period, by the steady clock
+    class paced_sink : public audio_sink
+    {
+    public:
+        static constexpr uint32_t PERIODS_PER_SECOND = 100;
+
+        paced_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer) :
+            audio_sink(ring, prebuffer),
+            sample_rate_(sample_rate)
+        {
+        }
+
+        ~paced_sink() override
+        {
+            stop();
+        }
+
+        paced_sink(const paced_sink&) = delete;
+        paced_sink& operator=(const paced_sink&) = delete;
+
+        [[nodiscard]] uint32_t sample_rate() const override
+        {
+            return sample_rate_;
+        }
+
+        // separate from the constructor, consume() must not be called before the derived class is constructed
+        void start()
+        {
+            thread_ = std::thread{[this]
+            {
+                const uint32_t frames = std::max(sample_rate_ / PERIODS_PER_SECOND, 1u);
+                const std::chrono::nanoseconds period{1'000'000'000ull * frames / sample_rate_};
+                std::vector<int16_t> samples(size_t{frames} * 2);
+
+                auto next = std::chrono::steady_clock::now();
+                while (running_.load(std::memory_order_relaxed))
+                {
+                    next += period;
+                    std::this_thread::sleep_until(next);
+                    pull(samples);
+                    consume(samples);
+                }
+            }};
+        }
+
+    protected:
+        // likewise, derived classes stop the thread before they're destroyed
+        void stop()
+        {
+            running_ = false;
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        virtual void consume(std::span<const int16_t>)
+        {
+        }
+
+    private:
+        uint32_t sample_rate_;
+        std::atomic<bool> running_ {true};
+        std::thread thread_;
+    };
+
+    class wav_sink : public paced_sink
+    {
+    public:
+        wav_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer, const std::filesystem::path& path) :
+            paced_sink(ring, sample_rate, prebuffer),
+            file_(path, std::ios::binary)
+        {
+            if (!file_)
+                throw std::runtime_error("Failed to open " + path.string());
+            write_header(0);
+        }
+
+        ~wav_sink() override
+        {
+            stop();
+            file_.seekp(0);
+            write_header(data_size_);
+        }
+
+    protected:
+        void consume(std::span<const int16_t> samples) override
+        {
+            // wav is little endian, like everything this runs on
+            file_.write(reinterpret_cast<const char*>(samples.data()),
+                        static_cast<std::streamsize>(samples.size_bytes()));
+            data_size_ += static_cast<uint32_t>(samples.size_bytes());
+        }
+
+    private:
+        void write_u32(uint32_t value)
+        {
+            const char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8),
+                                   static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+            file_.write(bytes, 4);
+        }
+
+        void write_u16(uint16_t value)
+        {
+            const char bytes[2] = {static_cast<char>(value), static_cast<char>(value >> 8)};
+            file_.write(bytes, 2);
+        }
+
+        void write_header(uint32_t data_size)
+        {
+            file_.write("RIFF", 4);
+            write_u32(36 + data_size);
+            file_.write("WAVEfmt ", 8);
+            write_u32(16);
+            write_u16(1); // pcm
+            write_u16(2); // stereo
+            write_u32(sample_rate());
+            write_u32(sample_rate() * 4); // bytes per second
+            write_u16(4); // bytes per frame
+            write_u16(16); // bits per sample
+            file_.write("data", 4);
+            write_u32(data_size);
+        }
+
+        std::ofstream file_;
+        uint32_t data_size_ {0};
+    };
+}
+
+std::unique_ptr<audio_sink> make_device_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer)
+{
+    try
+    {
+        return std::make_unique<device_sink>(ring, sample_rate, prebuffer);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+std::unique_ptr<audio_sink> make_null_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer)
+{
+    auto sink = std::make_unique<paced_sink>(ring, sample_rate, prebuffer);
+    sink->start();
+    return sink;
+}
+
+std::unique_ptr<audio_sink> make_wav_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer,
+                                          const std::filesystem::path& path)
+{
+    auto sink = std::make_unique<wav_sink>(ring, sample_rate, prebuffer, path);
+    sink->start();
+    return sink;
+}
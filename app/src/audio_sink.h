@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+
+#include "audio_ring.h"
+
+// where the emulator's audio goes. a sink pulls interleaved stereo samples out of the ring at its own pace, on a
+// thread of its own, and plays silence for whatever isn't there in time. the emulation only ever writes to the
+// ring, so sinks can be swapped without it noticing.
+class audio_sink
+{
+public:
+    virtual ~audio_sink() = default;
+
+    [[nodiscard]] virtual uint32_t sample_rate() const = 0;
+
+    // times the ring ran dry after playback started
+    [[nodiscard]] uint64_t underruns() const
+    {
+        return underruns_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    audio_sink(gb::audio_ring& ring, size_t prebuffer) :
+        ring_(ring),
+        prebuffer_(prebuffer)
+    {
+    }
+
+    // fills out from the ring, the rest with silence. nothing is played until the ring first holds prebuffer samples
+    void pull(std::span<int16_t> out);
+
+    gb::audio_ring& ring_;
+
+private:
+    size_t prebuffer_;
+    bool started_ {false};
+    std::atomic<uint64_t> underruns_ {0};
+};
+
+// every sink waits for prebuffer samples in the ring before it starts playing, so it doesn't start out running dry
+
+/** the default sound device
+ * @returns nullptr if there is none, or it can't be opened
+ */
+std::unique_ptr<audio_sink> make_device_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer);
+
+// plays to nowhere, in real time. for running without a sound device
+std::unique_ptr<audio_sink> make_null_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer);
+
+// writes everything to a 16 bit stereo wav file, in real time
+std::unique_ptr<audio_sink> make_wav_sink(gb::audio_ring& ring, uint32_t sample_rate, size_t prebuffer,
+                                          const std::filesystem::path& path);
@@ -1,9 +1,15 @@
 #include "fb_renderer.h"
 
+#include "host_trace.h"
+
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <ostream>
 
-fb_renderer::fb_renderer()
+fb_renderer::fb_renderer(uint32_t fb_width, uint32_t fb_height) :
+    fb_width_(fb_width),
+    fb_height_(fb_height)
 {
     glGenVertexArrays(1, &vao_id_);
     glGenBuffers(1, &vbo_id_);
@@ -13,16 +19,16 @@ fb_renderer::fb_renderer()
 
     constexpr float scale_x = 1.0f, scale_y = 1.0f;
 
-    // Quad vertices with positions and texture coordinates
+    // Quad vertices with positions and texture coordinates. the first row of the texture is the top of the screen
     float vertices[] = {
         // positions  // texture coords
-        -scale_x, scale_y,  0.0f, 1.0f, // top left
-        -scale_x, -scale_y, 0.0f, 0.0f, // bottom left
-        scale_x,  -scale_y, 1.0f, 0.0f, // bottom right
+        -scale_x, scale_y,  0.0f, 0.0f, // top left
+        -scale_x, -scale_y, 0.0f, 1.0f, // bottom left
+        scale_x,  -scale_y, 1.0f, 1.0f, // bottom right
 
-        -scale_x, scale_y,  0.0f, 1.0f, // top left
-        scale_x,  -scale_y, 1.0f, 0.0f, // bottom right
-        scale_x,  scale_y,  1.0f, 1.0f  // top right
+        -scale_x, scale_y,  0.0f, 0.0f, // top left
+        scale_x,  -scale_y, 1.0f, 1.0f, // bottom right
+        scale_x,  scale_y,  1.0f, 0.0f  // top right
     };
     glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), &vertices, GL_STATIC_DRAW);
 
@@ -42,8 +48,31 @@ fb_renderer::fb_renderer()
     // texture filtering
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // immutable storage, allocated once. uploads only ever replace the contents.
+    // the frames are packed 2 bit shades, each texel holds 4 pixels and the shader expands them with the palette
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, (int)packed_width(), (int)fb_height_);
+
+    if (GLAD_GL_VERSION_4_4)
+    {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const auto size = static_cast<GLsizeiptr>(frame_size() * UPLOAD_REGIONS);
+
+        glGenBuffers(1, &pbo_id_);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_id_);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        pbo_data_ = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (pbo_data_ == nullptr)
+        {
+            std::cerr << "Failed to map the pixel buffer, uploading from client memory" << std::endl;
+            glDeleteBuffers(1, &pbo_id_);
+            pbo_id_ = 0;
+        }
+    }
 
     shader_program_ = create_shader_program();
+    set_filter(fb_filter::sharp_bilinear);
 }
 
 fb_renderer::~fb_renderer()
@@ -52,18 +81,133 @@ fb_renderer::~fb_renderer()
     glDeleteBuffers(1, &vbo_id_);
     glDeleteTextures(1, &fb_tex_id_);
     glDeleteProgram(shader_program_);
+    for (GLsync fence : fences_)
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    if (pbo_id_)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_id_);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo_id_);
+    }
+}
+
+void fb_renderer::set_palette(const std::array<uint32_t, 4>& colors) const
+{
+    GLfloat palette[4 * 4];
+    for (size_t i = 0; i < colors.size(); i++)
+    {
+        palette[i * 4 + 0] = static_cast<float>((colors[i] >> 16) & 0xFF) / 255.0f;
+        palette[i * 4 + 1] = static_cast<float>((colors[i] >> 8) & 0xFF) / 255.0f;
+        palette[i * 4 + 2] = static_cast<float>(colors[i] & 0xFF) / 255.0f;
+        palette[i * 4 + 3] = static_cast<float>((colors[i] >> 24) & 0xFF) / 255.0f;
+    }
+    glProgramUniform4fv(shader_program_, glGetUniformLocation(shader_program_, "palette"), 4, palette);
+}
+
+void fb_renderer::set_filter(fb_filter filter) const
+{
+    set_uniform("sharpBilinear", filter == fb_filter::sharp_bilinear ? 1.0f : 0.0f);
+}
+
+void fb_renderer::set_scanlines(float strength) const
+{
+    set_uniform("scanlines", strength);
+}
+
+void fb_renderer::set_lcd_grid(float strength) const
+{
+    set_uniform("lcdGrid", strength);
+}
+
+void fb_renderer::set_uniform(const char* name, float value) const
+{
+    glProgramUniform1f(shader_program_, glGetUniformLocation(shader_program_, name), value);
 }
 
-void fb_renderer::render(const uint32_t* fb_data, uint32_t fb_width, uint32_t fb_height) const
+void fb_renderer::upload(const uint8_t* shades, std::span<const uint64_t> changed_rows)
 {
+    const auto row_changed = [&](uint32_t row)
+    {
+        return changed_rows.empty() || (changed_rows[row / 64] & (uint64_t{1} << (row % 64)));
+    };
+    // calls upload_rows(first, count) for every run of consecutive changed rows
+    const auto for_each_run = [&](auto&& upload_rows)
+    {
+        for (uint32_t row = 0; row < fb_height_; row++)
+        {
+            if (!row_changed(row))
+                continue;
+            const uint32_t first = row;
+            while (row + 1 < fb_height_ && row_changed(row + 1))
+                row++;
+            upload_rows(first, row + 1 - first);
+        }
+    };
+
+    if (!changed_rows.empty() && std::ranges::all_of(changed_rows, [](uint64_t word) { return word == 0; }))
+        return;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fb_tex_id_);
+    // rows are packed_width() bytes, which doesn't have to be a multiple of 4
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (!pbo_id_)
+    {
+        for_each_run([&](uint32_t first, uint32_t count)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (int)first, (int)packed_width(), (int)count, GL_RED_INTEGER,
+                            GL_UNSIGNED_BYTE, shades + first * packed_width());
+        });
+        return;
+    }
+
+    // with UPLOAD_REGIONS regions the gpu has had a couple of frames to copy out of this one, so this hardly
+    // ever actually waits
+    GLsync& fence = fences_[region_];
+    if (fence)
+    {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000) == GL_TIMEOUT_EXPIRED)
+        {
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_id_);
+    for_each_run([&](uint32_t first, uint32_t count)
+    {
+        // rows sit at the same place in the region as in the frame
+        const size_t offset = region_ * frame_size() + first * packed_width();
+        std::memcpy(pbo_data_ + offset, shades + first * packed_width(), count * packed_width());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (int)first, (int)packed_width(), (int)count, GL_RED_INTEGER,
+                        GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+    });
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    region_ = (region_ + 1) % UPLOAD_REGIONS;
+}
+
+void fb_renderer::render() const
+{
+    GB_TRACE_SCOPE("fb_renderer::render");
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
     glUseProgram(shader_program_);
 
+    // the window may have been resized since the last frame
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glUniform2f(glGetUniformLocation(shader_program_, "outputSize"), (float)viewport[2], (float)viewport[3]);
+
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, fb_tex_id_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (int)fb_width, (int)fb_height, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, fb_data);
 
     glBindVertexArray(vao_id_);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
@@ -87,10 +231,55 @@ GLuint fb_renderer::create_shader_program()
         #version 430 core
         out vec4 FragColor;
         in vec2 TexCoords;
-        uniform sampler2D screenTexture;
+        uniform usampler2D screenTexture; // 4 pixels of 2 bit shades per texel, leftmost in the low bits
+        uniform vec4 palette[4];
+        uniform vec2 outputSize; // viewport size in window pixels
+        uniform float sharpBilinear; // 0 for nearest
+        uniform float scanlines;
+        uniform float lcdGrid;
+
+        vec4 shade(ivec2 pixel, ivec2 size)
+        {
+            pixel = clamp(pixel, ivec2(0), size - 1);
+            uint texel = texelFetch(screenTexture, ivec2(pixel.x / 4, pixel.y), 0).r;
+            return palette[(texel >> (2 * (pixel.x % 4))) & 3u];
+        }
+
         void main()
         {
-            FragColor = texture(screenTexture, TexCoords);
+            ivec2 size = textureSize(screenTexture, 0) * ivec2(4, 1);
+            vec2 scale = outputSize / vec2(size); // window pixels per framebuffer pixel
+            vec2 pixel = TexCoords * vec2(size);
+
+            vec4 color;
+            if (sharpBilinear != 0.0)
+            {
+                // flat inside a pixel, and blended over the one window pixel at its edge. the same as scaling up
+                // by an integer with nearest and then down to the window bilinearly
+                vec2 center_offset = fract(pixel) - 0.5;
+                vec2 flat_range = max(0.5 - 0.5 / scale, 0.0);
+                vec2 offset = (center_offset - clamp(center_offset, -flat_range, flat_range)) * scale;
+                vec2 position = floor(pixel) + offset;
+                ivec2 corner = ivec2(floor(position));
+                vec2 weight = position - floor(position);
+                color = mix(mix(shade(corner, size), shade(corner + ivec2(1, 0), size), weight.x),
+                            mix(shade(corner + ivec2(0, 1), size), shade(corner + ivec2(1, 1), size), weight.x),
+                            weight.y);
+            }
+            else
+            {
+                color = shade(ivec2(pixel), size);
+            }
+
+            // 0 at the center of a framebuffer pixel, 1 at its edges
+            vec2 edge_distance = abs(fract(pixel) - 0.5) * 2.0;
+            color.rgb *= 1.0 - scanlines * edge_distance.y * edge_distance.y;
+
+            // the last window pixel row and column of every framebuffer pixel
+            vec2 border = step(1.0 - 1.0 / scale, fract(pixel)) * step(2.0, scale);
+            color.rgb *= 1.0 - lcdGrid * max(border.x, border.y);
+
+            FragColor = color;
         }
     )";
 
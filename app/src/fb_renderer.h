@@ -3,22 +3,84 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-// renderer for a framebuffer
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// how the framebuffer is scaled to the window
+enum class fb_filter
+{
+    nearest, // blocky, uneven pixel sizes when the window isn't a whole multiple of the framebuffer
+    sharp_bilinear // nearest scaling with a blended seam of at most one window pixel between framebuffer pixels
+};
+
+// renderer for a framebuffer. palette lookup, scaling and effects all run in the fragment shader, so the cpu cost
+// of a frame doesn't depend on the window size
 class fb_renderer
 {
 public:
-    fb_renderer();
+    // note that this doesn't take scaled parameters, it takes the exact frame_buffer dimensions
+    fb_renderer(uint32_t fb_width, uint32_t fb_height);
     ~fb_renderer();
 
-    // note that this doesn't take scaled parameters, it takes the exact frame_buffer dimensions
-    void render(const uint32_t* fb_data, uint32_t fb_width, uint32_t fb_height) const;
+    fb_renderer(const fb_renderer&) = delete;
+    fb_renderer& operator=(const fb_renderer&) = delete;
+
+    // the color of each shade, as 0xAARRGGBB. everything is black until this is set
+    void set_palette(const std::array<uint32_t, 4>& colors) const;
+
+    /** copies a new frame of packed 2 bit shades (4 pixels a byte, leftmost in the low bits) into the texture.
+     * only rows with their bit set in changed_rows are uploaded, all of them if it's empty.
+     * frames go through a persistently mapped pixel buffer when the context supports it (gl 4.4), so this neither
+     * reallocates nor waits for the gpu to finish with the previous upload
+     */
+    void upload(const uint8_t* shades, std::span<const uint64_t> changed_rows = {});
+
+    void set_filter(fb_filter filter) const;
+
+    // darkens the space between lines like a crt, 0 (off) to 1
+    void set_scanlines(float strength) const;
+
+    // darkens the border of every pixel like the dmg lcd, 0 (off) to 1. needs a window at least twice the size of
+    // the framebuffer
+    void set_lcd_grid(float strength) const;
+
+    // draws the last uploaded frame over the whole viewport
+    void render() const;
 
 private:
+    // uploads in flight, each one has its own region of the pixel buffer
+    static constexpr size_t UPLOAD_REGIONS = 3;
+
+    uint32_t fb_width_;
+    uint32_t fb_height_;
+
     // stores the texture id for the framebuffer
     GLuint fb_tex_id_ {0};
     GLuint vao_id_ {0}, vbo_id_ {0};
     GLuint shader_program_ {0};
 
+    // persistently mapped pixel unpack buffer, 0 when falling back to uploads from client memory
+    GLuint pbo_id_ {0};
+    uint8_t* pbo_data_ {nullptr};
+    size_t region_ {0};
+    // signalled once the gpu is done reading a region
+    std::array<GLsync, UPLOAD_REGIONS> fences_ {};
+
+    // bytes per row of packed shades
+    [[nodiscard]] size_t packed_width() const
+    {
+        return fb_width_ / 4;
+    }
+
+    [[nodiscard]] size_t frame_size() const
+    {
+        return packed_width() * fb_height_;
+    }
+
     // helper method for creating a shader program
     GLuint create_shader_program();
+
+    void set_uniform(const char* name, float value) const;
 };
@@ -1,63 +1,270 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
 
-#include "cpu.h"
+#include "audio_ring.h"
+#include "audio_sink.h"
 #include "fb_renderer.h"
+#include "gameboy.h"
+#include "host_trace.h"
+#include "input_movie.h"
+#include "joypad.h"
 #include "ppu.h"
+#include "run_ahead.h"
+#include "video_capture.h"
 #include "window.h"
 
 #define SCREEN_WIDTH 160
 #define SCREEN_HEIGHT 144
 #define SCREEN_MULTIPLIER 3
 
+// battery-backed ram is written back once per emulated second, only the parts that changed. the run-ahead cost is
+// logged just as often
+#define SAVE_FLUSH_INTERVAL (gb::cartridge::RTC_CYCLES_PER_SECOND)
+
+// the emulation thread runs at the speed of the real console, 4194304 cycles per second
+#define FRAME_DURATION (std::chrono::nanoseconds{1'000'000'000ull * gb::ppu::CYCLES_FRAME / 4194304})
+
+// the emulation keeps about 50 ms of stereo samples ahead of the sound device, and has room for 4 times that
+#define AUDIO_SAMPLE_RATE 48000
+#define AUDIO_TARGET_FILL (AUDIO_SAMPLE_RATE / 20 * 2)
+#define AUDIO_RING_SIZE (AUDIO_TARGET_FILL * 4)
+
+namespace
+{
+    // arrows, x for a, z for b, enter for start, backspace or right shift for select
+    uint8_t read_buttons(const window& win)
+    {
+        uint8_t buttons = 0;
+        if (win.is_key_down(GLFW_KEY_RIGHT)) buttons |= gb::joypad::RIGHT;
+        if (win.is_key_down(GLFW_KEY_LEFT)) buttons |= gb::joypad::LEFT;
+        if (win.is_key_down(GLFW_KEY_UP)) buttons |= gb::joypad::UP;
+        if (win.is_key_down(GLFW_KEY_DOWN)) buttons |= gb::joypad::DOWN;
+        if (win.is_key_down(GLFW_KEY_X)) buttons |= gb::joypad::A;
+        if (win.is_key_down(GLFW_KEY_Z)) buttons |= gb::joypad::B;
+        if (win.is_key_down(GLFW_KEY_ENTER)) buttons |= gb::joypad::START;
+        if (win.is_key_down(GLFW_KEY_BACKSPACE) || win.is_key_down(GLFW_KEY_RIGHT_SHIFT))
+            buttons |= gb::joypad::SELECT;
+        return buttons;
+    }
+}
+
 int main(int argc, char* argv[])
 {
     window win{SCREEN_WIDTH * SCREEN_MULTIPLIER, SCREEN_HEIGHT * SCREEN_MULTIPLIER, "gbemu"};
-    gb::memory_map mem{};
-    //mem.skip_boot_rom();
-    gb::cpu cpu{};
-    gb::ppu ppu{};
+    gb::gameboy gb{};
+    //gb.mem.skip_boot_rom();
 
-    fb_renderer renderer{};
+    fb_renderer renderer{SCREEN_WIDTH, SCREEN_HEIGHT};
+    renderer.set_palette(gb::ppu::SHADE_COLORS);
 
     //bool skip_rom_execution = false;
+    uint64_t last_save_flush = 0;
 
-    if (argc == 2 && std::filesystem::exists(argv[1]))
+    // --frames N presents N frames, prints how long that took and exits. for profiling the presentation, and
+    // for running without a gpu under mesa's llvmpipe (LIBGL_ALWAYS_SOFTWARE=1)
+    uint64_t exit_after_frames = 0;
+    const char* rom_path = nullptr;
+    std::unique_ptr<gb::video_capture> capture;
+    std::string_view audio_output = "device";
+    // --movie plays the buttons of a recorded run instead of the keyboard's, --record saves them on exit
+    std::optional<gb::input_movie> movie;
+    std::optional<std::filesystem::path> record_path;
+    // --run-ahead N shows every frame N frames early, see run_ahead.h
+    uint32_t run_ahead_frames = 0;
+    // --trace <file.json> records where the host's time goes, in builds with GB_TRACE, see host_trace.h
+    std::optional<std::filesystem::path> trace_path;
+    // the files named on the command line are opened right away, a missing or unreadable one ends here
+    try
     {
-        mem.load_rom(std::filesystem::absolute(argv[1]));
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+                exit_after_frames = std::strtoull(argv[++i], nullptr, 10);
+            else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            {
+                const bool nearest = std::strcmp(argv[++i], "nearest") == 0;
+                renderer.set_filter(nearest ? fb_filter::nearest : fb_filter::sharp_bilinear);
+            }
+            else if (std::strcmp(argv[i], "--scanlines") == 0 && i + 1 < argc)
+                renderer.set_scanlines(std::strtof(argv[++i], nullptr));
+            else if (std::strcmp(argv[i], "--lcd-grid") == 0 && i + 1 < argc)
+                renderer.set_lcd_grid(std::strtof(argv[++i], nullptr));
+            else if (std::strcmp(argv[i], "--fifo") == 0)
+                gb.ppu.set_renderer(ppu_renderer::fifo);
+            else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+                capture = std::make_unique<gb::video_capture>(argv[++i]);
+            else if (std::strcmp(argv[i], "--audio") == 0 && i + 1 < argc)
+                audio_output = argv[++i];
+            else if (std::strcmp(argv[i], "--movie") == 0 && i + 1 < argc)
+                movie.emplace(argv[++i]);
+            else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+                record_path = argv[++i];
+            else if (std::strcmp(argv[i], "--run-ahead") == 0 && i + 1 < argc)
+                run_ahead_frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+                trace_path = argv[++i];
+            else
+                rom_path = argv[i];
+        }
+
+        if (rom_path && std::filesystem::exists(rom_path))
+        {
+            gb.mem.load_rom(std::filesystem::absolute(rom_path));
+        }
+        else if (rom_path && !std::filesystem::exists(rom_path))
+        {
+            std::cout << "Usage: app.exe [--frames N] [--filter nearest|sharp] [--scanlines 0-1] [--lcd-grid 0-1] "
+                         "[--fifo] [--capture file] [--audio device|null|file.wav] [--movie file] [--record file] "
+                         "[--run-ahead N] [--trace file.json] <rom absolute path>" << std::endl;
+            return -1;
+        }
+        else
+        {
+            //skip_rom_execution = true;
+            std::cout << "Skipping rom loading" << std::endl;
+        }
     }
-    else if (argc == 2 && !std::filesystem::exists(argv[1]))
+    catch (const std::exception& e)
     {
-        std::cout << "Usage: app.exe <rom absolute path>" << std::endl;
+        std::cerr << e.what() << std::endl;
         return -1;
     }
-    else
+
+    // the emulation writes samples to the ring once a frame, the sink plays them from a thread of its own. the two
+    // run off different clocks, so the resampler is nudged every frame to keep the ring from running dry or over
+    gb::audio_ring audio{AUDIO_RING_SIZE};
+    std::unique_ptr<audio_sink> sink;
+    if (audio_output == "device")
+    {
+        sink = make_device_sink(audio, AUDIO_SAMPLE_RATE, AUDIO_TARGET_FILL);
+        if (!sink)
+            std::cout << "Playing audio to nowhere" << std::endl;
+    }
+    else if (audio_output.ends_with(".wav"))
     {
-        //skip_rom_execution = true;
-        std::cout << "Skipping rom loading" << std::endl;
+        sink = make_wav_sink(audio, AUDIO_SAMPLE_RATE, AUDIO_TARGET_FILL, audio_output);
     }
+    if (!sink)
+        sink = make_null_sink(audio, AUDIO_SAMPLE_RATE, AUDIO_TARGET_FILL);
+    gb.mem.get_apu().set_synthesis(sink->sample_rate(), gb.mem.get_clock());
+
+    // the emulation runs on a thread of its own and hands finished frames over, so presenting never waits on the
+    // emulation or the other way around, and the window only ever shows complete frames
+    auto frames = std::make_unique<gb::triple_buffer<gb::ppu::frame>>();
+    gb.ppu.set_frame_output(frames.get());
+    std::atomic<bool> running {true};
+
+    // the keys are read where the window lives, the buttons change only between frames, like in a movie
+    std::atomic<uint8_t> keys {0};
+    gb::input_movie recording;
+    gb::run_ahead ahead{run_ahead_frames};
 
-    while (!win.should_close())
+    if (trace_path && !gb::host_trace::ENABLED)
+        std::cout << "Not tracing, the build has no trace scopes (GB_TRACE)" << std::endl;
+    GB_TRACE_THREAD_NAME("present");
+    if (trace_path)
+        gb::host_trace::start();
+
+    std::thread emulation{[&]
     {
-        //if (!skip_rom_execution)
+        GB_TRACE_THREAD_NAME("emulation");
+        auto next_frame = std::chrono::steady_clock::now() + FRAME_DURATION;
+        uint64_t input_frame = 0;
+        while (running.load(std::memory_order_relaxed))
         {
-            try
-            {
-                const uint32_t cycles = cpu.execute(mem);
-                ppu.tick(cycles, mem);
-            }
-            catch (const std::exception& e)
+            const uint8_t buttons = movie ? movie->get_buttons(input_frame) : keys.load(std::memory_order_relaxed);
+            if (record_path)
+                recording.add_frame(buttons);
+            input_frame++;
+
+            //if (!skip_rom_execution)
             {
-                std::cerr << e.what() << '\n';
+                try
+                {
+                    ahead.run_frame(gb, buttons);
+
+                    if (gb.mem.get_clock() - last_save_flush >= SAVE_FLUSH_INTERVAL)
+                    {
+                        gb.mem.flush_save();
+                        last_save_flush = gb.mem.get_clock();
+                        if (run_ahead_frames)
+                            std::cout << ahead.stats() << std::endl;
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    std::cerr << e.what() << '\n';
+                }
             }
+
+            // with run-ahead, this is the frame shown
+            if (capture)
+                capture->add_frame(gb.ppu.get_shades());
+
+            gb::apu& apu = gb.mem.get_apu();
+            audio.write(apu.get_samples());
+            apu.clear_samples();
+            apu.set_rate_factor(audio.rate_factor(AUDIO_TARGET_FILL));
+            std::this_thread::sleep_until(next_frame);
+            next_frame += FRAME_DURATION;
         }
+    }};
 
-        renderer.render(ppu.get_framebuffer(), SCREEN_WIDTH, SCREEN_HEIGHT);
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration upload_time{};
+    uint64_t presented = 0;
+    uint64_t uploads = 0;
+
+    while (!win.should_close() && (exit_after_frames == 0 || presented < exit_after_frames))
+    {
+        if (frames->acquire())
+        {
+            const gb::ppu::frame& frame = frames->read_buffer();
+            const auto upload_start = std::chrono::steady_clock::now();
+            renderer.upload(frame.shades.data(), frame.changed);
+            upload_time += std::chrono::steady_clock::now() - upload_start;
+            uploads++;
+        }
+        renderer.render();
 
         win.swap_buffers();
         win.poll_events();
+        keys.store(read_buttons(win), std::memory_order_relaxed);
+        presented++;
+    }
+
+    running = false;
+    emulation.join();
+    gb.ppu.set_frame_output(nullptr);
+
+    if (trace_path && gb::host_trace::ENABLED)
+    {
+        gb::host_trace::stop();
+        std::ofstream trace{*trace_path};
+        gb::host_trace::write_json(trace);
+        if (gb::host_trace::dropped())
+            std::cout << gb::host_trace::dropped() << " trace events didn't fit and were dropped" << std::endl;
     }
 
+    if (record_path)
+        recording.save(*record_path);
+
+    if (exit_after_frames)
+    {
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+        const auto upload = std::chrono::duration<double, std::micro>(upload_time);
+        std::cout << "presented " << presented << " frames in " << elapsed.count() << " s, " << uploads
+                  << " uploads averaging " << (uploads ? upload.count() / uploads : 0.0) << " us, "
+                  << sink->underruns() << " audio underruns" << std::endl;
+    }
     return 0;
 }
@@ -0,0 +1,4 @@
+// miniaudio is a single header library, its implementation is compiled here and only here. it isn't held to the
+// warning flags of the rest of the app, see CMakeLists.txt
+#define MINIAUDIO_IMPLEMENTATION
+#include <miniaudio.h>
@@ -4,6 +4,8 @@
 #include <GLFW/glfw3.h>
 #include <string>
 
+#include "host_trace.h"
+
 // note this isn't in gb namespace. it doesn't depend on the game boy.
 class window
 {
@@ -20,6 +22,7 @@ public:
 
     void swap_buffers() const
     {
+        GB_TRACE_SCOPE("window::swap_buffers");
         glfwSwapBuffers(window_);
     }
 
@@ -28,6 +31,12 @@ public:
         glfwPollEvents();
     }
 
+    // key is a GLFW_KEY_*, as of the last poll_events
+    [[nodiscard]] bool is_key_down(int key) const
+    {
+        return glfwGetKey(window_, key) == GLFW_PRESS;
+    }
+
 private:
     GLFWwindow* window_ = nullptr;
 };
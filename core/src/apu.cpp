@@ -0,0 +1,528 @@
+#include "apu.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    constexpr uint16_t NR10_ADDR = 0xFF10;
+    constexpr uint16_t NR30_ADDR = 0xFF1A;
+    constexpr uint16_t NR43_ADDR = 0xFF22;
+    constexpr uint16_t NR50_ADDR = 0xFF24;
+    constexpr uint16_t NR51_ADDR = 0xFF25;
+    constexpr uint16_t NR52_ADDR = 0xFF26;
+    constexpr uint16_t WAVE_RAM_ADDR = 0xFF30;
+
+    // each channel has 5 registers from 0xFF10, NRx0-NRx4. channel 2 and 4 don't have an NRx0
+    constexpr size_t REGISTERS_PER_CHANNEL = 5;
+
+    // bits that read back as 1, 0xFF10-0xFF2F. NR52 is put together on read
+    constexpr std::array<uint8_t, 0x20> READ_MASKS = {
+        0x80, 0x3F, 0x00, 0xFF, 0xBF, // NR10-NR14
+        0xFF, 0x3F, 0x00, 0xFF, 0xBF, // NR20-NR24
+        0x7F, 0xFF, 0x9F, 0xFF, 0xBF, // NR30-NR34
+        0xFF, 0xFF, 0x00, 0x00, 0xBF, // NR40-NR44
+        0x00, 0x00, 0x70, // NR50-NR52
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF // unused
+    };
+
+    // which of the 8 steps of a square wave are high, for each duty cycle
+    constexpr std::array<uint8_t, 4> DUTY_STEPS = {0b00000001, 0b10000001, 0b10000111, 0b01111110};
+
+    // what the boot rom leaves in the registers, without the trigger of its chime
+    constexpr std::array<std::pair<uint16_t, uint8_t>, 20> BOOT_REGISTERS = {{
+        {0xFF10, 0x80}, {0xFF11, 0xBF}, {0xFF12, 0xF3}, {0xFF13, 0xFF}, {0xFF14, 0x3F},
+        {0xFF16, 0x3F}, {0xFF17, 0x00}, {0xFF18, 0xFF}, {0xFF19, 0x3F},
+        {0xFF1A, 0x7F}, {0xFF1B, 0xFF}, {0xFF1C, 0x9F}, {0xFF1D, 0xFF}, {0xFF1E, 0x3F},
+        {0xFF20, 0xFF}, {0xFF21, 0x00}, {0xFF22, 0x00}, {0xFF23, 0x3F},
+        {0xFF24, 0x77}, {0xFF25, 0xF3}
+    }};
+
+    // output level of a channel's dac for a 4 bit sample, -15 to 15
+    int32_t dac_output(uint8_t sample)
+    {
+        return sample * 2 - 15;
+    }
+}
+
+gb::apu::apu()
+{
+    state_.next_step = CYCLES_PER_STEP;
+}
+
+void gb::apu::skip_boot_rom(uint64_t clock)
+{
+    const uint64_t cycle = clock * 4;
+    catch_up(state_, cycle);
+
+    write_register(state_, NR52_ADDR, 0x80);
+    for (const auto& [address, value] : BOOT_REGISTERS)
+        write_register(state_, address, value);
+
+    // the chime has faded out, but channel 1 is still on
+    channel& ch = state_.channels[0];
+    ch.enabled = true;
+    ch.volume = 0;
+    ch.timer = timer_period(state_, 0);
+
+    if (sample_rate_)
+        restart_synthesis(cycle);
+}
+
+uint8_t gb::apu::read(uint16_t address, uint64_t clock) const
+{
+    catch_up(state_, clock * 4);
+
+    const size_t offset = address - REGISTERS_START;
+    if (address >= WAVE_RAM_ADDR)
+        return state_.registers[offset];
+
+    if (address == NR52_ADDR)
+    {
+        uint8_t value = (state_.powered ? 0x80 : 0x00) | READ_MASKS[offset];
+        for (int i = 0; i < 4; i++)
+            value |= state_.channels[i].enabled ? 1 << i : 0;
+        return value;
+    }
+
+    return state_.registers[offset] | READ_MASKS[offset];
+}
+
+void gb::apu::write(uint16_t address, uint8_t value, uint64_t clock)
+{
+    const uint64_t cycle = clock * 4;
+    catch_up(state_, cycle);
+    write_register(state_, address, value);
+
+    if (sample_rate_)
+    {
+        queue_.push_back({cycle, address, value});
+        if (queue_.size() >= MAX_QUEUED_WRITES)
+            synthesize(clock);
+    }
+}
+
+void gb::apu::set_synthesis(uint32_t sample_rate, uint64_t clock)
+{
+    sample_rate_ = sample_rate;
+    queue_.clear();
+    queue_.shrink_to_fit();
+    resampler_.reset();
+    if (sample_rate_)
+    {
+        resampler_.emplace(CYCLES_PER_SECOND / blep_buffer::CYCLES_PER_SAMPLE, sample_rate_);
+        catch_up(state_, clock * 4);
+        restart_synthesis(clock * 4);
+    }
+}
+
+void gb::apu::synthesize(uint64_t clock)
+{
+    if (!sample_rate_)
+        return;
+
+    for (const queued_write& write : queue_)
+    {
+        run(write.cycle);
+        write_register(synth_, write.address, write.value);
+        update_outputs();
+    }
+    queue_.clear();
+
+    run(clock * 4);
+}
+
+void gb::apu::save(state_writer& out) const
+{
+    out.write(state_);
+}
+
+void gb::apu::load(state_reader& in, uint64_t clock)
+{
+    in.read(state_);
+    if (sample_rate_)
+        restart_synthesis(clock * 4);
+}
+
+void gb::apu::write_register(state& s, uint16_t address, uint8_t value)
+{
+    const size_t offset = address - REGISTERS_START;
+
+    // wave ram works with the apu off
+    if (address >= WAVE_RAM_ADDR)
+    {
+        s.registers[offset] = value;
+        return;
+    }
+
+    if (address == NR52_ADDR)
+    {
+        const bool powered = value & 0x80;
+        if (s.powered && !powered)
+        {
+            // powering off clears every register but wave ram, which ignores writes until powered on again
+            std::fill_n(s.registers.begin(), NR52_ADDR - REGISTERS_START, 0);
+            s.channels = {};
+        }
+        else if (!s.powered && powered)
+        {
+            s.step = 0;
+        }
+        s.powered = powered;
+        return;
+    }
+
+    if (!s.powered)
+        return;
+
+    s.registers[offset] = value;
+    if (address >= NR50_ADDR)
+        return;
+
+    const int index = static_cast<int>(offset / REGISTERS_PER_CHANNEL);
+    channel& ch = s.channels[index];
+    switch (offset % REGISTERS_PER_CHANNEL)
+    {
+        case 0:
+            if (address == NR30_ADDR && !is_dac_enabled(s, index))
+                ch.enabled = false;
+            break;
+
+        case 1:
+            ch.length = index == 2 ? 256 - value : 64 - (value & 0x3F);
+            break;
+
+        case 2:
+            if (index != 2 && !is_dac_enabled(s, index))
+                ch.enabled = false;
+            break;
+
+        case 3:
+            ch.frequency = (ch.frequency & 0x700) | value;
+            break;
+
+        case 4:
+            ch.frequency = (ch.frequency & 0xFF) | ((value & 0x07) << 8);
+            if (value & 0x80)
+                trigger(s, index);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void gb::apu::trigger(state& s, int index)
+{
+    channel& ch = s.channels[index];
+    ch.enabled = is_dac_enabled(s, index);
+    if (ch.length == 0)
+        ch.length = index == 2 ? 256 : 64;
+
+    const uint8_t nrx2 = s.registers[index * REGISTERS_PER_CHANNEL + 2];
+    ch.volume = nrx2 >> 4;
+    ch.envelope_timer = nrx2 & 0x07;
+
+    ch.timer = timer_period(s, index);
+    ch.position = 0;
+    ch.lfsr = 0x7FFF;
+
+    if (index == 0)
+    {
+        const uint8_t nr10 = s.registers[NR10_ADDR - REGISTERS_START];
+        const uint8_t period = (nr10 >> 4) & 0x07;
+        ch.sweep_shadow = ch.frequency;
+        ch.sweep_timer = period ? period : 8;
+        ch.sweep_enabled = period || (nr10 & 0x07);
+        if ((nr10 & 0x07) && sweep_frequency(ch, nr10) > 2047)
+            ch.enabled = false;
+    }
+}
+
+void gb::apu::catch_up(state& s, uint64_t cycle)
+{
+    if (!s.powered)
+    {
+        // nothing to step, just move the schedule along
+        if (s.next_step <= cycle)
+            s.next_step += ((cycle - s.next_step) / CYCLES_PER_STEP + 1) * CYCLES_PER_STEP;
+        return;
+    }
+
+    while (s.next_step <= cycle)
+    {
+        step_frame_sequencer(s);
+        s.next_step += CYCLES_PER_STEP;
+    }
+}
+
+void gb::apu::step_frame_sequencer(state& s)
+{
+    // lengths on every other step
+    if (s.step % 2 == 0)
+    {
+        for (size_t i = 0; i < s.channels.size(); i++)
+        {
+            channel& ch = s.channels[i];
+            const bool length_enabled = s.registers[i * REGISTERS_PER_CHANNEL + 4] & 0x40;
+            if (length_enabled && ch.length > 0 && --ch.length == 0)
+                ch.enabled = false;
+        }
+    }
+
+    if (s.step == 2 || s.step == 6)
+        step_sweep(s);
+
+    // envelopes on the last step, the wave channel has none
+    if (s.step == 7)
+    {
+        for (int i : {0, 1, 3})
+        {
+            channel& ch = s.channels[i];
+            const uint8_t nrx2 = s.registers[i * REGISTERS_PER_CHANNEL + 2];
+            const uint8_t period = nrx2 & 0x07;
+            if (period == 0)
+                continue;
+            if (ch.envelope_timer > 1)
+            {
+                ch.envelope_timer--;
+                continue;
+            }
+
+            ch.envelope_timer = period;
+            if ((nrx2 & 0x08) && ch.volume < 15)
+                ch.volume++;
+            else if (!(nrx2 & 0x08) && ch.volume > 0)
+                ch.volume--;
+        }
+    }
+
+    s.step = (s.step + 1) & 0x07;
+}
+
+void gb::apu::step_sweep(state& s)
+{
+    channel& ch = s.channels[0];
+    if (ch.sweep_timer > 1)
+    {
+        ch.sweep_timer--;
+        return;
+    }
+
+    const uint8_t nr10 = s.registers[NR10_ADDR - REGISTERS_START];
+    const uint8_t period = (nr10 >> 4) & 0x07;
+    ch.sweep_timer = period ? period : 8;
+    if (!ch.sweep_enabled || period == 0)
+        return;
+
+    const int frequency = sweep_frequency(ch, nr10);
+    if (frequency > 2047)
+    {
+        ch.enabled = false;
+        return;
+    }
+
+    if (nr10 & 0x07)
+    {
+        ch.sweep_shadow = static_cast<uint16_t>(frequency);
+        ch.frequency = static_cast<uint16_t>(frequency);
+        // the next frequency is checked right away as well
+        if (sweep_frequency(ch, nr10) > 2047)
+            ch.enabled = false;
+    }
+}
+
+int gb::apu::sweep_frequency(channel& ch, uint8_t nr10)
+{
+    const int delta = ch.sweep_shadow >> (nr10 & 0x07);
+    return nr10 & 0x08 ? ch.sweep_shadow - delta : ch.sweep_shadow + delta;
+}
+
+bool gb::apu::is_dac_enabled(const state& s, int index)
+{
+    if (index == 2)
+        return s.registers[NR30_ADDR - REGISTERS_START] & 0x80;
+    return s.registers[index * REGISTERS_PER_CHANNEL + 2] & 0xF8;
+}
+
+uint32_t gb::apu::timer_period(const state& s, int index)
+{
+    const channel& ch = s.channels[index];
+    switch (index)
+    {
+        case 0:
+        case 1:
+            return (2048 - ch.frequency) * 4;
+        case 2:
+            return (2048 - ch.frequency) * 2;
+        default:
+        {
+            const uint8_t nr43 = s.registers[NR43_ADDR - REGISTERS_START];
+            const uint32_t divisor = (nr43 & 0x07) ? (nr43 & 0x07) * 16 : 8;
+            return divisor << (nr43 >> 4);
+        }
+    }
+}
+
+int32_t gb::apu::channel_output(const state& s, int index)
+{
+    const channel& ch = s.channels[index];
+    if (!ch.enabled)
+        return 0;
+
+    switch (index)
+    {
+        case 0:
+        case 1:
+        {
+            const uint8_t duty = s.registers[index * REGISTERS_PER_CHANNEL + 1] >> 6;
+            return dac_output((DUTY_STEPS[duty] >> ch.position) & 1 ? ch.volume : 0);
+        }
+        case 2:
+        {
+            const uint8_t samples = s.registers[WAVE_RAM_ADDR - REGISTERS_START + ch.position / 2];
+            const uint8_t sample = ch.position & 1 ? samples & 0x0F : samples >> 4;
+            constexpr std::array<uint8_t, 4> SHIFTS = {4, 0, 1, 2}; // mute, 100%, 50%, 25%
+            const uint8_t level = (s.registers[index * REGISTERS_PER_CHANNEL + 2] >> 5) & 0x03;
+            return dac_output(sample >> SHIFTS[level]);
+        }
+        default:
+            return dac_output(ch.lfsr & 1 ? 0 : ch.volume);
+    }
+}
+
+void gb::apu::restart_synthesis(uint64_t cycle)
+{
+    synth_ = state_;
+    synth_cycle_ = cycle;
+    queue_.clear();
+
+    blep_cycle_ = cycle;
+    blep_.clear();
+    levels_ = {};
+    gains_ = {};
+    dc_input_ = {};
+    dc_output_ = {};
+    resampler_->clear();
+    update_outputs();
+}
+
+void gb::apu::run(uint64_t cycle)
+{
+    // a frame sequencer step at most per pass, which is what the blep buffer has room for
+    while (true)
+    {
+        const uint64_t until = std::min(cycle, synth_.next_step);
+        if (until > synth_cycle_)
+        {
+            for (int i = 0; i < 4; i++)
+                run_channel(i, static_cast<uint32_t>(until - synth_cycle_));
+            synth_cycle_ = until;
+            flush();
+        }
+        if (synth_.next_step > cycle)
+            break;
+        catch_up(synth_, synth_.next_step);
+        update_outputs();
+    }
+}
+
+void gb::apu::run_channel(int index, uint32_t cycles)
+{
+    channel& ch = synth_.channels[index];
+    if (!ch.enabled)
+        return;
+
+    // writes and frame sequencer steps, which may change the period, only come between runs
+    const uint32_t period = timer_period(synth_, index);
+    if (ch.timer == 0)
+        ch.timer = period;
+
+    // the output only changes when the timer runs out
+    uint32_t elapsed = 0;
+    while (cycles - elapsed >= ch.timer)
+    {
+        elapsed += ch.timer;
+
+        if (index == 2)
+        {
+            ch.position = (ch.position + 1) & 0x1F;
+        }
+        else if (index == 3)
+        {
+            const uint16_t bit = (ch.lfsr ^ (ch.lfsr >> 1)) & 1;
+            ch.lfsr = (ch.lfsr >> 1) | (bit << 14);
+            if (synth_.registers[NR43_ADDR - REGISTERS_START] & 0x08)
+                ch.lfsr = (ch.lfsr & ~0x40) | (bit << 6);
+        }
+        else
+        {
+            ch.position = (ch.position + 1) & 0x07;
+        }
+
+        ch.timer = period;
+        set_level(index, synth_cycle_ + elapsed, channel_output(synth_, index));
+    }
+    ch.timer -= cycles - elapsed;
+}
+
+void gb::apu::update_outputs()
+{
+    // after a write or frame sequencer step any channel may sound different, and the panning and master volume
+    // apply to all of them. 4 channels at most 15 each, times 8 for the master volume, times 64 fits in 16 bits
+    const uint8_t nr50 = synth_.registers[NR50_ADDR - REGISTERS_START];
+    const uint8_t nr51 = synth_.registers[NR51_ADDR - REGISTERS_START];
+    const uint32_t offset = static_cast<uint32_t>(synth_cycle_ - blep_cycle_);
+    for (int i = 0; i < 4; i++)
+    {
+        const std::array<int32_t, 2> gains = {
+            nr51 & (0x10 << i) ? (((nr50 >> 4) & 0x07) + 1) * 64 : 0,
+            nr51 & (0x01 << i) ? ((nr50 & 0x07) + 1) * 64 : 0
+        };
+        const int32_t level = channel_output(synth_, i);
+        const int32_t left = level * gains[0] - levels_[i] * gains_[i][0];
+        const int32_t right = level * gains[1] - levels_[i] * gains_[i][1];
+        if (left != 0 || right != 0)
+            blep_.add_delta(offset, static_cast<float>(left), static_cast<float>(right));
+        levels_[i] = level;
+        gains_[i] = gains;
+    }
+}
+
+void gb::apu::set_level(int index, uint64_t cycle, int32_t level)
+{
+    // most timer steps of a square wave don't change its output
+    if (level == levels_[index])
+        return;
+
+    const int32_t delta = level - levels_[index];
+    blep_.add_delta(static_cast<uint32_t>(cycle - blep_cycle_), static_cast<float>(delta * gains_[index][0]),
+                    static_cast<float>(delta * gains_[index][1]));
+    levels_[index] = level;
+}
+
+void gb::apu::flush()
+{
+    // every sample before the one synthesis is in is final
+    const size_t count = (synth_cycle_ - blep_cycle_) / blep_buffer::CYCLES_PER_SAMPLE;
+    if (count == 0)
+        return;
+    blep_cycle_ += count * blep_buffer::CYCLES_PER_SAMPLE;
+
+    block_[0].resize(count);
+    block_[1].resize(count);
+    blep_.read(block_[0], block_[1]);
+
+    for (size_t side = 0; side < 2; side++)
+    {
+        // the corner is at about 8 Hz
+        for (float& sample : block_[side])
+        {
+            dc_output_[side] = sample - dc_input_[side] + 0.9996f * dc_output_[side];
+            dc_input_[side] = sample;
+            sample = dc_output_[side];
+        }
+    }
+
+    resampler_->process(block_[0], block_[1], samples_);
+}
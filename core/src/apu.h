@@ -0,0 +1,165 @@
+#pragma once
+
+#include "blep_buffer.h"
+#include "resampler.h"
+#include "save_state.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace gb
+{
+    class apu;
+}
+
+// the sound registers, 0xFF10-0xFF3F, and the four channels behind them.
+// the apu is never ticked. register writes are applied right away to the state the cpu can read back (lengths,
+// sweep and channel on flags, advanced lazily by the frame sequencer steps that fell in between), and while
+// synthesis is on they're also queued with their timestamp. synthesize() then replays the queue on a second copy of
+// the state, generating all samples up to each write in one tight loop per channel, once per frame or whenever the
+// caller wants audio. with synthesis off the queue and the second copy are never touched.
+class gb::apu
+{
+public:
+    static constexpr uint16_t REGISTERS_START = 0xFF10;
+    static constexpr uint16_t REGISTERS_END = 0xFF3F; // including wave ram from 0xFF30
+
+    // the apu counts clock cycles, memory_map::get_clock() counts machine cycles of 4 of them
+    static constexpr uint32_t CYCLES_PER_SECOND = 4194304;
+    static constexpr uint32_t CYCLES_PER_STEP = CYCLES_PER_SECOND / 512; // frame sequencer
+
+    // writes queued before synthesize() runs by itself
+    static constexpr size_t MAX_QUEUED_WRITES = 4096;
+
+    apu();
+
+    // a copy of the registers with synthesis off and none of its buffers, for memory_map::fork()
+    [[nodiscard]] apu fork() const
+    {
+        apu copy;
+        copy.state_ = state_;
+        return copy;
+    }
+
+    // the registers as the boot rom leaves them
+    void skip_boot_rom(uint64_t clock);
+
+    // clock is memory_map::get_clock() at the time of the access
+    [[nodiscard]] uint8_t read(uint16_t address, uint64_t clock) const;
+    void write(uint16_t address, uint8_t value, uint64_t clock);
+
+    /** starts generating stereo samples at sample_rate from clock on, 0 stops. headless runs leave it off, the
+     * registers behave the same either way
+     */
+    void set_synthesis(uint32_t sample_rate, uint64_t clock);
+
+    [[nodiscard]] bool is_synthesizing() const
+    {
+        return sample_rate_ != 0;
+    }
+
+    // generates the samples up to clock, replaying the writes queued since the last call. a no-op with synthesis off
+    void synthesize(uint64_t clock);
+
+    // scales the output sample rate by factor to keep a device fed, see resampler::set_rate_factor()
+    void set_rate_factor(double factor)
+    {
+        if (resampler_)
+            resampler_->set_rate_factor(factor);
+    }
+
+    // interleaved left/right samples generated so far
+    [[nodiscard]] std::span<const int16_t> get_samples() const
+    {
+        return samples_;
+    }
+
+    void clear_samples()
+    {
+        samples_.clear();
+    }
+
+    // the register state, see save_state.h. synthesis picks up from the loaded state
+    void save(state_writer& out) const;
+    void load(state_reader& in, uint64_t clock);
+
+private:
+    struct channel
+    {
+        // oscillator, only run by synthesis
+        uint32_t timer; // cycles until the next duty step, wave sample or lfsr shift
+        uint16_t lfsr;
+        uint8_t position; // duty step or wave sample
+
+        // clocked by the frame sequencer
+        bool enabled;
+        uint16_t length; // counts down to 0, which disables the channel if length is enabled
+        uint16_t frequency; // 11 bits, the sweep changes it on channel 1
+        uint16_t sweep_shadow;
+        uint8_t volume; // envelope, 0-15
+        uint8_t envelope_timer;
+        uint8_t sweep_timer;
+        bool sweep_enabled;
+        uint8_t reserved[2];
+    };
+
+    struct state
+    {
+        std::array<uint8_t, REGISTERS_END - REGISTERS_START + 1> registers; // as written
+        std::array<channel, 4> channels;
+        uint64_t next_step; // cycle of the next frame sequencer step
+        uint8_t step; // 0-7
+        bool powered;
+        uint8_t reserved[6];
+    };
+
+    // no padding, so save states stay byte exact
+    static_assert(std::has_unique_object_representations_v<state>);
+
+    struct queued_write
+    {
+        uint64_t cycle;
+        uint16_t address;
+        uint8_t value;
+    };
+
+    // what the cpu sees. reads catch it up to their time as well
+    mutable state state_ {};
+
+    // synthesis, a step behind state_
+    state synth_ {};
+    uint64_t synth_cycle_ {0};
+    std::vector<queued_write> queue_;
+    uint32_t sample_rate_ {0};
+    uint64_t blep_cycle_ {0}; // cycle of the oldest sample not read from the blep buffer yet
+    blep_buffer blep_ {CYCLES_PER_STEP + blep_buffer::CYCLES_PER_SAMPLE};
+    std::array<int32_t, 4> levels_ {}; // channel outputs, as in the blep buffer
+    std::array<std::array<int32_t, 2>, 4> gains_ {}; // each channel's panning and master volume on each side
+    std::array<std::vector<float>, 2> block_; // left and right, read from the blep buffer
+    std::array<float, 2> dc_input_ {}; // high pass, like the capacitors on the output
+    std::array<float, 2> dc_output_ {};
+    std::optional<resampler> resampler_;
+    std::vector<int16_t> samples_;
+
+    static void write_register(state& s, uint16_t address, uint8_t value);
+    static void trigger(state& s, int index);
+    static void catch_up(state& s, uint64_t cycle);
+    static void step_frame_sequencer(state& s);
+    static void step_sweep(state& s);
+    [[nodiscard]] static int sweep_frequency(channel& ch, uint8_t nr10);
+    [[nodiscard]] static bool is_dac_enabled(const state& s, int index);
+    [[nodiscard]] static uint32_t timer_period(const state& s, int index);
+
+    // synthesis
+    [[nodiscard]] static int32_t channel_output(const state& s, int index);
+    void restart_synthesis(uint64_t cycle);
+    void run(uint64_t cycle);
+    void run_channel(int index, uint32_t cycles);
+    void update_outputs();
+    void set_level(int index, uint64_t cycle, int32_t level);
+    void flush();
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gb
+{
+    class audio_ring;
+}
+
+// hands interleaved stereo samples from the emulation thread to an audio device's callback without either of them
+// waiting or locking. the writer only moves write_, the reader only moves read_, each publishes its side with a
+// release store that the other side picks up with an acquire load. samples always move in whole left/right pairs.
+// the emulation and the device run off different clocks, so the fill level drifts. rate_factor() turns it into a
+// small correction for the resampler that keeps it around a target, instead of the device running dry or the
+// ring filling up.
+class gb::audio_ring
+{
+public:
+    // the most the resampler is sped up or slowed down, well below an audible change in pitch
+    static constexpr double MAX_RATE_DEVIATION = 0.005;
+
+    // capacity in samples, rounded up to a power of 2
+    explicit audio_ring(size_t capacity) :
+        samples_(std::bit_ceil(std::max<size_t>(capacity, 2)))
+    {
+    }
+
+    /** writer only. appends as many samples as there is room for
+     * @returns how many were written, the rest are dropped
+     */
+    size_t write(std::span<const int16_t> samples)
+    {
+        const size_t write = write_.load(std::memory_order_relaxed);
+        const size_t free = capacity() - (write - read_.load(std::memory_order_acquire));
+        const size_t count = std::min(samples.size(), free) & ~size_t{1};
+        for (size_t i = 0; i < count; i++)
+            samples_[(write + i) & (capacity() - 1)] = samples[i];
+        write_.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    /** reader only. fills out with as many samples as there are
+     * @returns how many were read, the rest of out is left alone
+     */
+    size_t read(std::span<int16_t> out)
+    {
+        const size_t read = read_.load(std::memory_order_relaxed);
+        const size_t available = write_.load(std::memory_order_acquire) - read;
+        const size_t count = std::min(out.size(), available) & ~size_t{1};
+        for (size_t i = 0; i < count; i++)
+            out[i] = samples_[(read + i) & (capacity() - 1)];
+        read_.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    // either side. samples waiting to be read, already out of date on the other side
+    [[nodiscard]] size_t size() const
+    {
+        return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t capacity() const
+    {
+        return samples_.size();
+    }
+
+    /** a factor for resampler::set_rate_factor() that steers the fill level towards target samples: more samples
+     * per second when the ring is running low, fewer when it's filling up, in proportion to how far off it is
+     */
+    [[nodiscard]] double rate_factor(size_t target) const
+    {
+        const double error = (static_cast<double>(target) - static_cast<double>(size())) / static_cast<double>(target);
+        return 1.0 + MAX_RATE_DEVIATION * std::clamp(error, -1.0, 1.0);
+    }
+
+private:
+    std::vector<int16_t> samples_;
+
+    // free running counts, only masked to index samples_. kept on separate cache lines
+    alignas(64) std::atomic<size_t> write_ {0};
+    alignas(64) std::atomic<size_t> read_ {0};
+};
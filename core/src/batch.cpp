@@ -0,0 +1,222 @@
+#include "batch.h"
+
+#include "gameboy.h"
+#include "hash.h"
+#include "input_movie.h"
+#include "metrics.h"
+#include "work_pool.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+    using clock_type = std::chrono::steady_clock;
+
+    double seconds_since(clock_type::time_point start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    // what the jobs report while they run, see gb::run_batch
+    struct job_metrics
+    {
+        gb::metric_counter& cycles;
+        gb::metric_counter& frames;
+        gb::metric_counter& frames_not_drawn;
+        gb::metric_histogram& frame_time;
+
+        explicit job_metrics(gb::metrics_registry& registry) :
+            cycles(registry.counter("emulated_cycles")),
+            frames(registry.counter("frames")),
+            frames_not_drawn(registry.counter("frames_not_drawn")),
+            frame_time(registry.histogram("frame_time_us"))
+        {
+        }
+    };
+
+    gb::batch_result run_job(const gb::batch_job& job, const gb::rom_image& rom, ppu_render_policy render,
+                             uint32_t render_interval, job_metrics& metrics)
+    {
+        const auto start = clock_type::now();
+        gb::batch_result result{};
+
+        // a missing or broken movie throws, and fails only this job
+        const gb::input_movie movie = job.movie.empty() ? gb::input_movie{} : gb::input_movie{job.movie};
+
+        // the boot rom runs, like it does in the app
+        gb::gameboy gb{rom};
+        gb.ppu.set_render_policy(render, render_interval);
+        for (uint32_t frame = 0; frame < job.frames; frame++)
+        {
+            if (frame + 1 == job.frames)
+                gb.ppu.set_render_policy(ppu_render_policy::all);
+            gb.mem.set_buttons(movie.get_buttons(frame));
+
+            const auto frame_start = clock_type::now();
+            const bool drawn = gb.ppu.is_rendering();
+            const uint32_t cycles = gb.run_frame();
+            const auto frame_end = clock_type::now();
+            const auto frame_time = std::chrono::duration_cast<std::chrono::microseconds>(frame_end - frame_start);
+
+            result.cycles += cycles;
+            metrics.cycles.add(cycles);
+            metrics.frames.add();
+            metrics.frames_not_drawn.add(drawn ? 0 : 1);
+            metrics.frame_time.record(static_cast<uint64_t>(frame_time.count()));
+        }
+
+        result.ok = true;
+        result.frames = job.frames;
+        result.framebuffer_hash = gb.ppu.get_frame_hash();
+        std::vector<uint8_t> state(gb.save_state_size());
+        gb.save_state(state);
+        result.state_hash = gb::hash_bytes(state.data(), state.size());
+        result.af = gb.cpu.AF.full;
+        result.bc = gb.cpu.BC.full;
+        result.de = gb.cpu.DE.full;
+        result.hl = gb.cpu.HL.full;
+        result.sp = gb.cpu.SP.full;
+        result.pc = gb.cpu.PC.full;
+        result.seconds = seconds_since(start);
+        return result;
+    }
+}
+
+std::vector<gb::batch_job> gb::load_manifest(const std::filesystem::path& manifest_path)
+{
+    std::ifstream file{manifest_path};
+    if (!file)
+        throw std::runtime_error("Failed to open batch manifest: " + manifest_path.string());
+
+    const std::filesystem::path base = manifest_path.parent_path();
+    std::vector<batch_job> jobs;
+    std::string line;
+    for (size_t line_number = 1; std::getline(file, line); line_number++)
+    {
+        std::istringstream fields{line};
+        std::string rom;
+        if (!(fields >> std::quoted(rom)) || rom.starts_with('#'))
+            continue;
+
+        std::string movie;
+        int64_t frames = 0;
+        if (!(fields >> std::quoted(movie) >> frames) || frames < 0 || frames > UINT32_MAX)
+        {
+            throw std::runtime_error("Invalid job in " + manifest_path.string() + " line " +
+                                     std::to_string(line_number) + ", expected <rom> <movie or -> <frames>");
+        }
+
+        batch_job job{};
+        job.rom = base / rom;
+        if (movie != "-")
+            job.movie = base / movie;
+        job.frames = static_cast<uint32_t>(frames);
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+gb::batch_summary gb::run_batch(const std::vector<batch_job>& jobs, size_t thread_count, ppu_render_policy render,
+                                uint32_t render_interval, metrics_registry* metrics)
+{
+    const auto start = clock_type::now();
+    batch_summary summary{};
+    summary.results.resize(jobs.size());
+
+    // every rom is read once up front, the jobs only hold a reference to the shared image
+    std::map<std::filesystem::path, rom_image> roms;
+    std::map<std::filesystem::path, std::string> rom_errors;
+    for (const batch_job& job : jobs)
+    {
+        if (roms.contains(job.rom) || rom_errors.contains(job.rom))
+            continue;
+        try
+        {
+            roms.emplace(job.rom, cartridge::load_image(job.rom));
+        }
+        catch (const std::exception& e)
+        {
+            rom_errors.emplace(job.rom, e.what());
+        }
+    }
+
+    // without a registry to report to, the metrics go nowhere
+    metrics_registry unreported;
+    metrics_registry& registry = metrics ? *metrics : unreported;
+    job_metrics per_job{registry};
+    metric_counter& jobs_done = registry.counter("jobs_done");
+    metric_counter& jobs_failed = registry.counter("jobs_failed");
+
+    {
+        work_pool pool{thread_count};
+        summary.threads = pool.thread_count();
+
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            if (const auto error = rom_errors.find(jobs[i].rom); error != rom_errors.end())
+            {
+                summary.results[i].error = error->second;
+                jobs_failed.add();
+                continue;
+            }
+
+            pool.submit([&, i]
+            {
+                try
+                {
+                    summary.results[i] = run_job(jobs[i], roms.at(jobs[i].rom), render, render_interval,
+                                                 per_job);
+                    jobs_done.add();
+                }
+                catch (const std::exception& e)
+                {
+                    summary.results[i] = batch_result{};
+                    summary.results[i].error = e.what();
+                    jobs_failed.add();
+                }
+            });
+        }
+
+        pool.wait();
+        summary.steals = pool.steal_count();
+    }
+
+    for (const batch_result& result : summary.results)
+        summary.frames += result.frames;
+    summary.seconds = seconds_since(start);
+    return summary;
+}
+
+void gb::write_batch_csv(std::ostream& os, const std::vector<batch_job>& jobs, const batch_summary& summary)
+{
+    os << "job,rom,status,frames,cycles,framebuffer_hash,state_hash,af,bc,de,hl,sp,pc,ms\n";
+    for (size_t i = 0; i < summary.results.size(); i++)
+    {
+        const batch_result& r = summary.results[i];
+        os << i << ',' << std::quoted(jobs[i].rom.string()) << ',';
+        if (!r.ok)
+        {
+            os << std::quoted("error: " + r.error) << ",,,,,,,,,,,\n";
+            continue;
+        }
+
+        const auto flags = os.flags();
+        const char fill = os.fill();
+        const auto precision = os.precision();
+        os << "ok," << std::dec << r.frames << ',' << r.cycles << ',' << std::hex << std::setfill('0')
+           << std::setw(16) << r.framebuffer_hash << ',' << std::setw(16) << r.state_hash;
+        for (const uint16_t reg : {r.af, r.bc, r.de, r.hl, r.sp, r.pc})
+            os << ',' << std::setw(4) << reg;
+        os.flags(flags);
+        os.fill(fill);
+        os << ',' << std::fixed << std::setprecision(2) << r.seconds * 1000.0 << '\n';
+        os.flags(flags);
+        os.precision(precision);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "hash.h"
+#include "ppu.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace gb
+{
+    class metrics_registry;
+
+    struct batch_job
+    {
+        std::filesystem::path rom;
+        std::filesystem::path movie; // input movie to play back, empty for none
+        uint32_t frames;
+    };
+
+    struct batch_result
+    {
+        bool ok;
+        std::string error; // why the job didn't run, if !ok
+
+        uint64_t frames;
+        uint64_t cycles; // machine cycles
+        uint64_t framebuffer_hash; // ppu::get_frame_hash
+        uint64_t state_hash; // hash_bytes of the whole save state, held buttons included
+        uint16_t af, bc, de, hl, sp, pc; // final registers
+        double seconds;
+    };
+
+    struct batch_summary
+    {
+        std::vector<batch_result> results; // in job order
+        size_t threads;
+        uint64_t steals; // jobs a worker took from another worker's queue
+        uint64_t frames; // over all jobs
+        double seconds; // wall time
+
+        [[nodiscard]] double instances_per_second() const
+        {
+            return seconds > 0 ? static_cast<double>(results.size()) / seconds : 0.0;
+        }
+
+        [[nodiscard]] double frames_per_second() const
+        {
+            return seconds > 0 ? static_cast<double>(frames) / seconds : 0.0;
+        }
+    };
+
+    /** reads a batch manifest. one job per line: `<rom> <movie> <frames>`, where movie is `-` for none.
+     * paths may be quoted and are relative to the manifest. blank lines and lines starting with # are skipped.
+     * throws std::runtime_error if the file can't be read or a line doesn't parse
+     */
+    std::vector<batch_job> load_manifest(const std::filesystem::path& manifest_path);
+
+    /** runs one emulator per job on a work_pool, 0 threads meaning one per hardware thread.
+     * every rom is read once and shared read-only between the jobs using it. a failing job is reported in its
+     * result and doesn't affect the others.
+     * jobs draw frames as render and render_interval say (see ppu::set_render_policy), only the last frame of a
+     * job is always drawn, for its framebuffer hash. lines with the background off keep what the last frame drawn
+     * had there, so a job that turns it off can hash differently under a policy that skips frames.
+     * while they run, the jobs count emulated_cycles, frames, frames_not_drawn, jobs_done and jobs_failed into
+     * metrics and record how long every frame took into frame_time_us, if metrics isn't nullptr (see metrics.h)
+     */
+    batch_summary run_batch(const std::vector<batch_job>& jobs, size_t thread_count = 0,
+                            ppu_render_policy render = ppu_render_policy::all, uint32_t render_interval = 1,
+                            metrics_registry* metrics = nullptr);
+
+    // one csv line per job, with a header
+    void write_batch_csv(std::ostream& os, const std::vector<batch_job>& jobs, const batch_summary& summary);
+}
@@ -0,0 +1,186 @@
+#include "battery_ram.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(GB_LINUX) || defined(GB_OSX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GB_HAS_MMAP
+#endif
+
+gb::battery_ram::battery_ram(size_t size, uint8_t fill) :
+    heap_(size, fill),
+    data_(heap_.data()),
+    size_(size)
+{
+}
+
+gb::battery_ram::battery_ram(const battery_ram& other)
+{
+    *this = other;
+}
+
+gb::battery_ram& gb::battery_ram::operator=(const battery_ram& other)
+{
+    if (this == &other)
+        return *this;
+
+    release(false);
+    heap_.assign(other.data_, other.data_ + other.total_size());
+    data_ = heap_.data();
+    size_ = other.size_;
+    footer_size_ = other.footer_size_;
+    return *this;
+}
+
+gb::battery_ram::~battery_ram()
+{
+    release(false);
+}
+
+size_t gb::battery_ram::attach(const std::filesystem::path& path, size_t footer_size, bool allow_map)
+{
+    release(true);
+
+    footer_size_ = footer_size;
+    heap_.resize(total_size(), 0);
+    data_ = heap_.data();
+
+    size_t loaded = 0;
+    if (allow_map && try_map(path, loaded))
+        return loaded;
+
+    // fallback: keep the ram on the heap and only write back what changed
+    std::ifstream save_file(path, std::ios::binary);
+    if (save_file)
+    {
+        save_file.read(reinterpret_cast<char*>(data_), static_cast<std::streamsize>(total_size()));
+        loaded = save_file.gcount();
+    }
+
+    path_ = path;
+    track_dirty_ = true;
+    dirty_.assign((total_size() / PAGE_SIZE + 1 + 63) / 64, 0);
+
+    // whatever the file didn't contain still has to be written once
+    for (size_t offset = loaded; offset < total_size(); offset += PAGE_SIZE)
+        mark_dirty(offset);
+    if (loaded < total_size())
+        mark_dirty(total_size() - 1);
+
+    return loaded;
+}
+
+void gb::battery_ram::flush()
+{
+    if (!is_attached())
+        return;
+
+#ifdef GB_HAS_MMAP
+    if (mapped_)
+    {
+        msync(data_, total_size(), MS_ASYNC);
+        return;
+    }
+#endif
+
+    const bool any_dirty = std::any_of(dirty_.begin(), dirty_.end(), [](uint64_t bits) { return bits != 0; });
+    if (!any_dirty)
+        return;
+
+    // open for update without truncating, creating the file first if needed
+    std::fstream save_file(path_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!save_file)
+    {
+        std::ofstream{path_, std::ios::binary};
+        save_file.open(path_, std::ios::binary | std::ios::in | std::ios::out);
+    }
+    if (!save_file)
+    {
+        std::cerr << "Error writing save file: " << path_ << std::endl;
+        return;
+    }
+
+    // write runs of consecutive dirty pages with a single call each
+    const size_t num_pages = (total_size() + PAGE_SIZE - 1) / PAGE_SIZE;
+    size_t page = 0;
+    while (page < num_pages)
+    {
+        if (!(dirty_[page / 64] & (1ull << (page % 64))))
+        {
+            page++;
+            continue;
+        }
+
+        const size_t first = page;
+        while (page < num_pages && (dirty_[page / 64] & (1ull << (page % 64))))
+            page++;
+
+        const size_t begin = first * PAGE_SIZE;
+        const size_t end = std::min(page * PAGE_SIZE, total_size());
+        save_file.seekp(static_cast<std::streamoff>(begin));
+        save_file.write(reinterpret_cast<const char*>(data_ + begin), static_cast<std::streamsize>(end - begin));
+    }
+
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+}
+
+bool gb::battery_ram::try_map([[maybe_unused]] const std::filesystem::path& path, [[maybe_unused]] size_t& loaded)
+{
+#ifdef GB_HAS_MMAP
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) < total_size() &&
+                                ftruncate(fd, static_cast<off_t>(total_size())) != 0))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, total_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (mapping == MAP_FAILED)
+        return false;
+
+    // seed whatever the file didn't contain yet with the current contents
+    loaded = std::min(static_cast<size_t>(st.st_size), total_size());
+    std::memcpy(static_cast<uint8_t*>(mapping) + loaded, data_ + loaded, total_size() - loaded);
+
+    heap_.clear();
+    heap_.shrink_to_fit();
+    data_ = static_cast<uint8_t*>(mapping);
+    path_ = path;
+    mapped_ = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void gb::battery_ram::release([[maybe_unused]] bool keep_contents)
+{
+    flush();
+
+#ifdef GB_HAS_MMAP
+    if (mapped_)
+    {
+        if (keep_contents)
+            heap_.assign(data_, data_ + total_size());
+        munmap(data_, total_size());
+        data_ = heap_.data();
+        mapped_ = false;
+    }
+#endif
+
+    path_.clear();
+    track_dirty_ = false;
+    dirty_.clear();
+}
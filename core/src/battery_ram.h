@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace gb
+{
+    class battery_ram;
+}
+
+// cartridge ram that can be backed by a .sav file. the cartridge keeps the live ram in banks of its own and
+// writes it through to this while attached.
+// where possible the ram is the file itself, mapped with mmap(MAP_SHARED), so the os writes back only the pages
+// the game touched. otherwise the ram lives on the heap and flush() rewrites only the dirty 256 byte pages.
+// the file may hold a footer after the ram (e.g. the mbc3 rtc), which is part of the same buffer.
+class gb::battery_ram
+{
+public:
+    // granularity of dirty tracking when the ram isn't mapped
+    static constexpr size_t PAGE_SIZE = 0x100;
+
+    battery_ram() = default;
+    battery_ram(size_t size, uint8_t fill);
+
+    // copies hold the same contents, but are never attached to the save file
+    battery_ram(const battery_ram& other);
+    battery_ram& operator=(const battery_ram& other);
+    ~battery_ram();
+
+    /** backs the ram and footer with a save file. an existing file is loaded, a new one is created from the
+     * current contents. data() changes, so pointers into the ram have to be re-resolved afterwards.
+     * without allow_map the ram stays on the heap even where the file could be mapped.
+     * @returns the number of bytes loaded from an existing save file, 0 if there was none
+     */
+    size_t attach(const std::filesystem::path& path, size_t footer_size, bool allow_map = true);
+
+    // writes dirty pages back to the save file. a no-op for detached ram
+    void flush();
+
+    [[nodiscard]] uint8_t* data()
+    {
+        return data_;
+    }
+
+    [[nodiscard]] const uint8_t* data() const
+    {
+        return data_;
+    }
+
+    // size of the ram, excluding the footer
+    [[nodiscard]] size_t size() const
+    {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] uint8_t* footer()
+    {
+        return data_ + size_;
+    }
+
+    [[nodiscard]] size_t footer_size() const
+    {
+        return footer_size_;
+    }
+
+    [[nodiscard]] bool is_attached() const
+    {
+        return !path_.empty();
+    }
+
+    [[nodiscard]] bool is_mapped() const
+    {
+        return mapped_;
+    }
+
+    // offset is relative to data(), and may point into the footer
+    void mark_dirty(size_t offset)
+    {
+        if (track_dirty_)
+        {
+            const size_t page = offset / PAGE_SIZE;
+            dirty_[page / 64] |= 1ull << (page % 64);
+        }
+    }
+
+    void mark_dirty_range(size_t offset, size_t size)
+    {
+        const size_t end = offset + size;
+        for (size_t at = offset; at < end; at += PAGE_SIZE)
+            mark_dirty(at);
+        if (size > 0)
+            mark_dirty(end - 1);
+    }
+
+    void mark_footer_dirty()
+    {
+        mark_dirty_range(size_, footer_size_);
+    }
+
+private:
+    std::vector<uint8_t> heap_;
+    uint8_t* data_ {nullptr};
+    size_t size_ {0};
+    size_t footer_size_ {0};
+
+    std::filesystem::path path_;
+    bool mapped_ {false};
+    bool track_dirty_ {false};
+    std::vector<uint64_t> dirty_;
+
+    [[nodiscard]] size_t total_size() const
+    {
+        return size_ + footer_size_;
+    }
+
+    bool try_map(const std::filesystem::path& path, size_t& loaded);
+    // flushes and detaches from the save file
+    void release(bool keep_contents);
+};
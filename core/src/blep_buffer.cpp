@@ -0,0 +1,73 @@
+#include "blep_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+const gb::blep_buffer::kernel_table gb::blep_buffer::KERNEL = make_kernel();
+
+gb::blep_buffer::blep_buffer(uint32_t max_cycles) :
+    deltas_((max_cycles / CYCLES_PER_SAMPLE + KERNEL_WIDTH + 1) * 2, 0.0f)
+{
+}
+
+void gb::blep_buffer::read(std::span<float> left, std::span<float> right)
+{
+    std::array<float, 2> levels = levels_;
+    for (size_t i = 0; i < left.size(); i++)
+    {
+        levels[0] += deltas_[i * 2];
+        levels[1] += deltas_[i * 2 + 1];
+        left[i] = levels[0];
+        right[i] = levels[1];
+    }
+    levels_ = levels;
+
+    // the impulses of later steps still reaching into the next samples move to the front
+    const auto size = static_cast<std::ptrdiff_t>(left.size() * 2);
+    std::copy(deltas_.begin() + size, deltas_.end(), deltas_.begin());
+    std::fill(deltas_.end() - size, deltas_.end(), 0.0f);
+}
+
+void gb::blep_buffer::clear()
+{
+    std::fill(deltas_.begin(), deltas_.end(), 0.0f);
+    levels_ = {};
+}
+
+gb::blep_buffer::kernel_table gb::blep_buffer::make_kernel()
+{
+    // cut off at 28% of the intermediate rate, about 37 kHz. the blackman window stops everything that would fold
+    // back below 24 kHz, the resampler takes care of the rest
+    constexpr double CUTOFF = 0.28;
+    constexpr double CENTER = KERNEL_WIDTH / 2.0 - 1.0;
+
+    kernel_table table{};
+    for (size_t phase = 0; phase < CYCLES_PER_SAMPLE; phase++)
+    {
+        const double offset = static_cast<double>(phase) / CYCLES_PER_SAMPLE;
+        double sum = 0.0;
+        std::array<double, KERNEL_WIDTH> taps{};
+        for (size_t i = 0; i < KERNEL_WIDTH; i++)
+        {
+            const double x = static_cast<double>(i) - CENTER - offset;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * std::numbers::pi * CUTOFF * x) /
+                                                 (2.0 * std::numbers::pi * CUTOFF * x);
+            // blackman over the kernel's span, centered on the step
+            const double w = (x + KERNEL_WIDTH / 2.0) / KERNEL_WIDTH;
+            const double window = w <= 0.0 || w >= 1.0 ? 0.0
+                                  : 0.42 - 0.5 * std::cos(2.0 * std::numbers::pi * w) +
+                                    0.08 * std::cos(4.0 * std::numbers::pi * w);
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // every step ends up exactly its size
+        for (size_t i = 0; i < KERNEL_WIDTH; i++)
+        {
+            table[phase][i * 2] = static_cast<float>(taps[i] / sum);
+            table[phase][i * 2 + 1] = table[phase][i * 2];
+        }
+    }
+    return table;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gb
+{
+    class blep_buffer;
+}
+
+// turns a waveform given as the times and sizes of its steps into samples, band-limited so the steps don't alias.
+// instead of sampling the waveform, every step adds a band-limited impulse (a windowed sinc) to a buffer of
+// differences, at the sub-sample position of the step, and reading sums the differences up. the cost is per step,
+// not per cycle, so a square wave costs the same at any clock rate.
+// samples come out at an intermediate rate of one per CYCLES_PER_SAMPLE apu cycles, for the resampler to take
+// down to the output rate. left and right are interleaved, so a step on both sides is one pass over the kernel.
+class gb::blep_buffer
+{
+public:
+    static constexpr uint32_t CYCLES_PER_SAMPLE = 32; // 131072 Hz from the apu's 4194304 Hz
+    static constexpr size_t KERNEL_WIDTH = 16; // in samples, the latency as well
+
+    // steps can be added up to max_cycles past the oldest unread sample
+    explicit blep_buffer(uint32_t max_cycles);
+
+    // adds a step of left and right at cycle, counted from the oldest unread sample
+    void add_delta(uint32_t cycle, float left, float right)
+    {
+        const float* kernel = KERNEL[cycle % CYCLES_PER_SAMPLE].data();
+        float* out = &deltas_[cycle / CYCLES_PER_SAMPLE * 2];
+        for (size_t i = 0; i < KERNEL_WIDTH * 2; i += 2)
+        {
+            out[i] += kernel[i] * left;
+            out[i + 1] += kernel[i + 1] * right;
+        }
+    }
+
+    /** sums up the first left.size() samples into left and right, which are the same size, and drops them. steps
+     * added later can't change them, so this may read up to the sample containing the latest step's cycle, but not
+     * that one
+     */
+    void read(std::span<float> left, std::span<float> right);
+
+    // back to silence
+    void clear();
+
+private:
+    using kernel_table = std::array<std::array<float, KERNEL_WIDTH * 2>, CYCLES_PER_SAMPLE>;
+
+    // the band-limited impulse at every sub-sample position, every tap twice to line up with left and right
+    static const kernel_table KERNEL;
+
+    static kernel_table make_kernel();
+
+    std::vector<float> deltas_;
+    std::array<float, 2> levels_ {}; // the sums of everything read so far
+};
@@ -0,0 +1,544 @@
+#include "cartridge.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+gb::cartridge::cartridge()
+{
+    // shared by every cartridge that hasn't loaded a rom
+    static const rom_image empty_rom = std::make_shared<const std::vector<uint8_t>>(2 * BANK_SIZE_ROM, 0);
+    rom_ = empty_rom;
+    update_banks();
+}
+
+gb::cartridge::cartridge(const std::filesystem::path& rom_path) :
+    cartridge(load_image(rom_path))
+{
+}
+
+gb::cartridge::cartridge(rom_image rom) :
+    rom_(std::move(rom))
+{
+    parse_header();
+    update_banks();
+}
+
+gb::cartridge::cartridge(const cartridge& other)
+{
+    *this = other;
+}
+
+gb::cartridge::cartridge(cartridge& parent, fork_tag) :
+    ram_banks_(parent.ram_banks_),
+    ram_size_(parent.ram_size_)
+{
+    copy_registers(parent);
+    parent.owned_banks_ = 0;
+    update_banks();
+}
+
+gb::cartridge& gb::cartridge::operator=(const cartridge& other)
+{
+    if (this == &other)
+        return *this;
+
+    ram_banks_.clear();
+    for (const auto& bank : other.ram_banks_)
+        ram_banks_.push_back(std::make_shared<ram_bank_data>(*bank));
+    owned_banks_ = static_cast<uint16_t>((1u << ram_banks_.size()) - 1);
+    ram_size_ = other.ram_size_;
+    save_ = battery_ram{};
+    copy_registers(other);
+
+    update_banks();
+    return *this;
+}
+
+gb::cartridge gb::cartridge::fork()
+{
+    return cartridge{*this, fork_tag{}};
+}
+
+void gb::cartridge::copy_registers(const cartridge& other)
+{
+    rom_ = other.rom_;
+    mbc_ = other.mbc_;
+    has_battery_ = other.has_battery_;
+    has_rtc_ = other.has_rtc_;
+    rom_bank_ = other.rom_bank_;
+    ram_bank_ = other.ram_bank_;
+    banking_mode_ = other.banking_mode_;
+    ram_enabled_ = other.ram_enabled_;
+    rtc_base_seconds_ = other.rtc_base_seconds_;
+    rtc_base_clock_ = other.rtc_base_clock_;
+    rtc_halted_ = other.rtc_halted_;
+    rtc_carry_ = other.rtc_carry_;
+    rtc_latch_prev_ = other.rtc_latch_prev_;
+    rtc_latched_ = other.rtc_latched_;
+}
+
+gb::rom_image gb::cartridge::load_image(const std::filesystem::path& rom_path)
+{
+    std::ifstream rom_file(rom_path, std::ios::binary);
+    if (!rom_file)
+    {
+        throw std::runtime_error("Error loading ROM!");
+    }
+
+    // Get file size
+    rom_file.seekg(0, std::ios::end);
+    const size_t rom_size = rom_file.tellg();
+    rom_file.seekg(0);
+
+    // the bank masks rely on a power of two bank count, and bank 1 always has to exist
+    const size_t num_banks = std::max<size_t>(2, std::bit_ceil((rom_size + BANK_SIZE_ROM - 1) / BANK_SIZE_ROM));
+    std::vector<uint8_t> rom(num_banks * BANK_SIZE_ROM, 0xFF);
+    rom_file.read(reinterpret_cast<char*>(rom.data()), static_cast<std::streamsize>(rom_size));
+
+    return std::make_shared<const std::vector<uint8_t>>(std::move(rom));
+}
+
+void gb::cartridge::write_control(uint16_t address, uint8_t value, uint64_t clock)
+{
+    switch (mbc_)
+    {
+        case mbc_type::none:
+            return;
+
+        case mbc_type::mbc1:
+            if (address <= 0x1FFF)
+                ram_enabled_ = (value & 0x0F) == 0x0A;
+            else if (address <= 0x3FFF)
+                rom_bank_ = (value & 0x1F) == 0 ? 1 : (value & 0x1F); // Bank 0 is not allowed here
+            else if (address <= 0x5FFF)
+                ram_bank_ = value & 0x03; // RAM bank, or bits 5-6 of the ROM bank
+            else
+                banking_mode_ = value & 0x01;
+            break;
+
+        case mbc_type::mbc2:
+            if (address > 0x3FFF)
+                return;
+            // bit 8 of the address selects between ram enable and rom bank
+            if (address & 0x100)
+                rom_bank_ = (value & 0x0F) == 0 ? 1 : (value & 0x0F);
+            else
+                ram_enabled_ = (value & 0x0F) == 0x0A;
+            break;
+
+        case mbc_type::mbc3:
+            if (address <= 0x1FFF)
+                ram_enabled_ = (value & 0x0F) == 0x0A;
+            else if (address <= 0x3FFF)
+                rom_bank_ = (value & 0x7F) == 0 ? 1 : (value & 0x7F);
+            else if (address <= 0x5FFF)
+                ram_bank_ = value; // 0x00-0x03 select a RAM bank, 0x08-0x0C an RTC register
+            else
+            {
+                // writing 0 then 1 latches the current time into the rtc registers
+                if (has_rtc_ && rtc_latch_prev_ == 0x00 && value == 0x01)
+                    rtc_latch(clock);
+                rtc_latch_prev_ = value;
+            }
+            break;
+
+        case mbc_type::mbc5:
+            if (address <= 0x1FFF)
+                ram_enabled_ = (value & 0x0F) == 0x0A;
+            else if (address <= 0x2FFF)
+                rom_bank_ = (rom_bank_ & 0x100) | value;
+            else if (address <= 0x3FFF)
+                rom_bank_ = (rom_bank_ & 0xFF) | ((value & 0x01) << 8);
+            else if (address <= 0x5FFF)
+                ram_bank_ = value & 0x0F;
+            break;
+    }
+
+    update_banks();
+}
+
+void gb::cartridge::write_ram(uint16_t offset, uint8_t value, uint64_t clock)
+{
+    if (eram_write_ != nullptr)
+    {
+        // mbc2 ram is only 4 bits wide, the upper half always reads back as 1s
+        if (mbc_ == mbc_type::mbc2)
+            value |= 0xF0;
+
+        // the copy-on-write fault: a bank still shared with a fork is copied before the first write to it
+        const auto bank_bit = static_cast<uint16_t>(1u << eram_bank_);
+        if (!(owned_banks_ & bank_bit))
+        {
+            ram_banks_[eram_bank_] = std::make_shared<ram_bank_data>(*ram_banks_[eram_bank_]);
+            owned_banks_ |= bank_bit;
+            update_banks();
+        }
+        eram_write_[offset & eram_mask_] = value;
+
+        if (save_.is_attached())
+        {
+            const size_t save_offset = eram_bank_ * BANK_SIZE_RAM + (offset & eram_mask_);
+            save_.data()[save_offset] = value;
+            save_.mark_dirty(save_offset);
+        }
+    }
+    else if (has_rtc_ && ram_enabled_ && ram_bank_ >= RTC_S && ram_bank_ <= RTC_DH)
+    {
+        rtc_write(ram_bank_, value, clock);
+    }
+}
+
+void gb::cartridge::attach_save(const std::filesystem::path& sav_path, uint64_t clock)
+{
+    if (!has_battery_ || (ram_size_ == 0 && !has_rtc_))
+        return;
+
+    // a new save file is created from the current contents, an existing one replaces them
+    save_ = battery_ram{ram_size_, 0};
+    for (size_t i = 0; i < ram_banks_.size(); i++)
+        std::copy_n(ram_banks_[i]->data(), std::min(ram_size_, BANK_SIZE_RAM), save_.data() + i * BANK_SIZE_RAM);
+
+    const size_t loaded = save_.attach(sav_path, has_rtc_ ? RTC_FOOTER_SIZE : 0);
+    for (size_t i = 0; i < ram_banks_.size(); i++)
+    {
+        ram_banks_[i] = std::make_shared<ram_bank_data>();
+        std::copy_n(save_.data() + i * BANK_SIZE_RAM, std::min(ram_size_, BANK_SIZE_RAM), ram_banks_[i]->data());
+    }
+    owned_banks_ = static_cast<uint16_t>((1u << ram_banks_.size()) - 1);
+    if (has_rtc_ && loaded >= ram_size_ + RTC_FOOTER_SIZE)
+        rtc_load_footer(clock);
+
+    update_banks();
+}
+
+void gb::cartridge::flush_save(uint64_t clock)
+{
+    if (!save_.is_attached())
+        return;
+
+    if (has_rtc_)
+        rtc_store_footer(clock);
+    save_.flush();
+}
+
+void gb::cartridge::save(state_writer& out) const
+{
+    out.write(rom_bank_);
+    out.write(ram_bank_);
+    out.write(banking_mode_);
+    out.write(ram_enabled_);
+    out.write(rtc_base_seconds_);
+    out.write(rtc_base_clock_);
+    out.write(rtc_halted_);
+    out.write(rtc_carry_);
+    out.write(rtc_latch_prev_);
+    out.write(rtc_latched_);
+    for (const auto& bank : ram_banks_)
+        out.write_bytes(bank->data(), std::min(ram_size_, BANK_SIZE_RAM));
+}
+
+void gb::cartridge::load(state_reader& in)
+{
+    in.read(rom_bank_);
+    in.read(ram_bank_);
+    in.read(banking_mode_);
+    in.read(ram_enabled_);
+    in.read(rtc_base_seconds_);
+    in.read(rtc_base_clock_);
+    in.read(rtc_halted_);
+    in.read(rtc_carry_);
+    in.read(rtc_latch_prev_);
+    in.read(rtc_latched_);
+    for (auto& bank : ram_banks_)
+    {
+        // overwritten completely, so a shared bank isn't worth copying first
+        bank = std::make_shared<ram_bank_data>();
+        in.read_bytes(bank->data(), std::min(ram_size_, BANK_SIZE_RAM));
+    }
+    owned_banks_ = static_cast<uint16_t>((1u << ram_banks_.size()) - 1);
+
+    if (save_.is_attached())
+    {
+        for (size_t i = 0; i < ram_banks_.size(); i++)
+            std::copy_n(ram_banks_[i]->data(), std::min(ram_size_, BANK_SIZE_RAM), save_.data() + i * BANK_SIZE_RAM);
+        save_.mark_dirty_range(0, ram_size_);
+    }
+
+    update_banks();
+}
+
+void gb::cartridge::parse_header()
+{
+    const uint8_t cart_type = (*rom_)[HEADER_TYPE_ADDR];
+    switch (cart_type)
+    {
+        case 0x00: // ROM ONLY
+        case 0x08: // ROM+RAM
+            mbc_ = mbc_type::none;
+            break;
+        case 0x09: // ROM+RAM+BATTERY
+            mbc_ = mbc_type::none;
+            has_battery_ = true;
+            break;
+        case 0x01: // MBC1
+        case 0x02: // MBC1+RAM
+            mbc_ = mbc_type::mbc1;
+            break;
+        case 0x03: // MBC1+RAM+BATTERY
+            mbc_ = mbc_type::mbc1;
+            has_battery_ = true;
+            break;
+        case 0x05: // MBC2
+            mbc_ = mbc_type::mbc2;
+            break;
+        case 0x06: // MBC2+BATTERY
+            mbc_ = mbc_type::mbc2;
+            has_battery_ = true;
+            break;
+        case 0x0F: // MBC3+TIMER+BATTERY
+        case 0x10: // MBC3+TIMER+RAM+BATTERY
+            mbc_ = mbc_type::mbc3;
+            has_battery_ = true;
+            has_rtc_ = true;
+            break;
+        case 0x11: // MBC3
+        case 0x12: // MBC3+RAM
+            mbc_ = mbc_type::mbc3;
+            break;
+        case 0x13: // MBC3+RAM+BATTERY
+            mbc_ = mbc_type::mbc3;
+            has_battery_ = true;
+            break;
+        case 0x19: // MBC5
+        case 0x1A: // MBC5+RAM
+        case 0x1C: // MBC5+RUMBLE
+        case 0x1D: // MBC5+RUMBLE+RAM
+            mbc_ = mbc_type::mbc5;
+            break;
+        case 0x1B: // MBC5+RAM+BATTERY
+        case 0x1E: // MBC5+RUMBLE+RAM+BATTERY
+            mbc_ = mbc_type::mbc5;
+            has_battery_ = true;
+            break;
+        default:
+            std::cerr << "Unsupported cartridge type: 0x" << std::hex << (int)cart_type << std::endl;
+            mbc_ = mbc_type::none;
+    }
+
+    // rom-only cartridges have no register to enable their ram
+    ram_enabled_ = mbc_ == mbc_type::none;
+
+    if (mbc_ == mbc_type::mbc2)
+    {
+        allocate_ram(MBC2_RAM_SIZE, 0xF0);
+        return;
+    }
+
+    const uint8_t ram_size = (*rom_)[HEADER_RAM_SIZE_ADDR];
+    switch (ram_size)
+    {
+        case 0x00:
+            break; // No RAM
+        case 0x01:
+            allocate_ram(0x800, 0);
+            break; // 2KB
+        case 0x02:
+            allocate_ram(BANK_SIZE_RAM, 0);
+            break; // 8KB
+        case 0x03:
+            allocate_ram(4 * BANK_SIZE_RAM, 0);
+            break; // 32KB
+        case 0x04:
+            allocate_ram(16 * BANK_SIZE_RAM, 0);
+            break; // 128KB
+        case 0x05:
+            allocate_ram(8 * BANK_SIZE_RAM, 0);
+            break; // 64KB
+        default:
+            std::cerr << "Unsupported RAM size: 0x" << std::hex << (int)ram_size << std::endl;
+    }
+}
+
+void gb::cartridge::allocate_ram(size_t size, uint8_t fill)
+{
+    // ram sizes are 2 KB, or a power of two number of 8 KB banks
+    ram_size_ = size;
+    ram_banks_.resize(std::max<size_t>(1, size / BANK_SIZE_RAM));
+    for (auto& bank : ram_banks_)
+    {
+        bank = std::make_shared<ram_bank_data>();
+        bank->fill(fill);
+    }
+    owned_banks_ = static_cast<uint16_t>((1u << ram_banks_.size()) - 1);
+}
+
+void gb::cartridge::update_banks()
+{
+    // the rom image always holds a power of two number of banks
+    const size_t rom_mask = rom_bank_count() - 1;
+    size_t bank0 = 0;
+    size_t bankx = rom_bank_;
+    size_t ram_bank = ram_bank_;
+
+    switch (mbc_)
+    {
+        case mbc_type::none:
+            bankx = 1;
+            ram_bank = 0;
+            break;
+        case mbc_type::mbc1:
+            // the secondary register supplies rom bits 5-6, and in mode 1 also banks 0x0000-0x3FFF and ram
+            bankx = (ram_bank_ << 5) | rom_bank_;
+            if (banking_mode_)
+                bank0 = ram_bank_ << 5;
+            else
+                ram_bank = 0;
+            break;
+        default:
+            break;
+    }
+
+    rom0_ = rom_->data() + (bank0 & rom_mask) * BANK_SIZE_ROM;
+    romx_ = rom_->data() + (bankx & rom_mask) * BANK_SIZE_ROM;
+
+    eram_read_ = &OPEN_BUS;
+    eram_write_ = nullptr;
+    eram_mask_ = 0;
+
+    if (!ram_enabled_)
+        return;
+
+    if (mbc_ == mbc_type::mbc3 && ram_bank_ >= RTC_S)
+    {
+        // rtc registers are mirrored over the whole window, writes go through rtc_write
+        if (has_rtc_ && ram_bank_ <= RTC_DH)
+            eram_read_ = &rtc_latched_[ram_bank_ - RTC_S];
+        return;
+    }
+
+    if (ram_banks_.empty())
+        return;
+
+    // the bank count is a power of two, ram smaller than a bank is mirrored
+    eram_bank_ = ram_bank & (ram_banks_.size() - 1);
+    eram_write_ = ram_banks_[eram_bank_]->data();
+    eram_read_ = eram_write_;
+    eram_mask_ = static_cast<uint16_t>(std::min(ram_size_, BANK_SIZE_RAM) - 1);
+}
+
+uint64_t gb::cartridge::rtc_seconds(uint64_t clock) const
+{
+    if (rtc_halted_)
+        return rtc_base_seconds_;
+    return rtc_base_seconds_ + (clock - rtc_base_clock_) / RTC_CYCLES_PER_SECOND;
+}
+
+std::array<uint8_t, 5> gb::cartridge::rtc_registers(uint64_t clock) const
+{
+    const uint64_t seconds = rtc_seconds(clock);
+    const uint64_t days = seconds / 86400;
+
+    // the day counter is 9 bits, the carry bit sticks until the game clears it
+    const bool carry = rtc_carry_ || days > 0x1FF;
+
+    return {
+        static_cast<uint8_t>(seconds % 60),
+        static_cast<uint8_t>((seconds / 60) % 60),
+        static_cast<uint8_t>((seconds / 3600) % 24),
+        static_cast<uint8_t>(days & 0xFF),
+        static_cast<uint8_t>(((days >> 8) & 0x01) | (rtc_halted_ ? 0x40 : 0x00) | (carry ? 0x80 : 0x00))
+    };
+}
+
+void gb::cartridge::rtc_latch(uint64_t clock)
+{
+    rtc_latched_ = rtc_registers(clock);
+    rtc_carry_ = rtc_latched_[4] & 0x80;
+}
+
+void gb::cartridge::rtc_write(uint8_t reg, uint8_t value, uint64_t clock)
+{
+    const uint64_t now = rtc_seconds(clock);
+    uint64_t seconds = now % 60;
+    uint64_t minutes = (now / 60) % 60;
+    uint64_t hours = (now / 3600) % 24;
+    uint64_t days = now / 86400;
+    if (days > 0x1FF)
+        rtc_carry_ = true;
+    days &= 0x1FF;
+
+    switch (reg)
+    {
+        case RTC_S:
+            seconds = value & 0x3F;
+            break;
+        case RTC_M:
+            minutes = value & 0x3F;
+            break;
+        case RTC_H:
+            hours = value & 0x1F;
+            break;
+        case RTC_DL:
+            days = (days & 0x100) | value;
+            break;
+        case RTC_DH:
+            days = (days & 0xFF) | ((value & 0x01) << 8);
+            rtc_halted_ = value & 0x40;
+            rtc_carry_ = value & 0x80;
+            break;
+        default:
+            return;
+    }
+
+    // rebase, which also restarts the sub-second counter like the real chip does on writes
+    rtc_base_seconds_ = seconds + minutes * 60 + hours * 3600 + days * 86400;
+    rtc_base_clock_ = clock;
+    rtc_latch(clock);
+}
+
+void gb::cartridge::rtc_store_footer(uint64_t clock)
+{
+    const std::array<uint8_t, 5> current = rtc_registers(clock);
+    const int64_t timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // little endian, regardless of the host
+    uint8_t* footer = save_.footer();
+    std::fill_n(footer, RTC_FOOTER_SIZE, 0);
+    for (size_t i = 0; i < 5; i++)
+    {
+        footer[i * 4] = current[i];
+        footer[20 + i * 4] = rtc_latched_[i];
+    }
+    for (size_t i = 0; i < 8; i++)
+        footer[40 + i] = static_cast<uint8_t>(static_cast<uint64_t>(timestamp) >> (i * 8));
+
+    save_.mark_footer_dirty();
+}
+
+void gb::cartridge::rtc_load_footer(uint64_t clock)
+{
+    const uint8_t* footer = save_.footer();
+    for (size_t i = 0; i < 5; i++)
+        rtc_latched_[i] = footer[20 + i * 4];
+
+    uint64_t timestamp = 0;
+    for (size_t i = 0; i < 8; i++)
+        timestamp |= static_cast<uint64_t>(footer[40 + i]) << (i * 8);
+
+    const uint64_t days = footer[12] | ((footer[16] & 0x01) << 8);
+    rtc_halted_ = footer[16] & 0x40;
+    rtc_carry_ = footer[16] & 0x80;
+    rtc_base_seconds_ = footer[0] + footer[4] * 60 + footer[8] * 3600 + days * 86400;
+    rtc_base_clock_ = clock;
+
+    // the clock kept running while the emulator was off
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!rtc_halted_ && timestamp != 0 && now > static_cast<int64_t>(timestamp))
+        rtc_base_seconds_ += now - static_cast<int64_t>(timestamp);
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "battery_ram.h"
+#include "save_state.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace gb
+{
+    class cartridge;
+
+    // memory bank controller, selected from the cartridge type byte of the header (0x147)
+    enum class mbc_type : uint8_t
+    {
+        none, // 32 KB rom, optionally 8 KB ram
+        mbc1,
+        mbc2,
+        mbc3,
+        mbc5
+    };
+
+    // rom images are immutable once loaded, so any number of cartridges can share one
+    using rom_image = std::shared_ptr<const std::vector<uint8_t>>;
+}
+
+// owns the rom image, external ram and the mbc registers of a cartridge.
+// every bank register write recomputes the pointers backing the 0x0000-0x7FFF and 0xA000-0xBFFF windows,
+// so reads through the memory map never do any bank arithmetic.
+class gb::cartridge
+{
+public:
+    // cartridge header locations
+    static constexpr uint16_t HEADER_TYPE_ADDR = 0x147;
+    static constexpr uint16_t HEADER_ROM_SIZE_ADDR = 0x148;
+    static constexpr uint16_t HEADER_RAM_SIZE_ADDR = 0x149;
+
+    // the mbc3 rtc counts emulated time, in machine cycles (1 mc = 4 clock cycles)
+    static constexpr uint64_t RTC_CYCLES_PER_SECOND = 1048576;
+
+    static constexpr size_t BANK_SIZE_ROM = 0x4000;
+
+    // empty 32 KB rom-only cartridge, used until a rom is loaded
+    cartridge();
+    explicit cartridge(const std::filesystem::path& rom_path);
+    explicit cartridge(rom_image rom);
+
+    // the bank windows point into the owning cartridge, so copies have to re-resolve them.
+    // copies own all of their ram and are never attached to the save file, fork() is the cheap alternative
+    cartridge(const cartridge& other);
+    cartridge& operator=(const cartridge& other);
+    ~cartridge() = default;
+
+    /** copy-on-write copy, see memory_map::fork. the ram banks are shared between the two cartridges until either
+     * of them writes to a bank, the fork is never attached to the save file.
+     * not const: this cartridge loses write access to its banks as well, so its next write to one copies it.
+     */
+    cartridge fork();
+
+    // reads a rom file and pads it to a power of two number of 16 KB banks
+    static rom_image load_image(const std::filesystem::path& rom_path);
+
+    // 0x0000-0x3FFF, offset from 0x0000
+    [[nodiscard]] uint8_t read_rom0(uint16_t offset) const
+    {
+        return rom0_[offset];
+    }
+
+    // 0x4000-0x7FFF, offset from 0x4000
+    [[nodiscard]] uint8_t read_romx(uint16_t offset) const
+    {
+        return romx_[offset];
+    }
+
+    // 0xA000-0xBFFF, offset from 0xA000. the mask handles mirrored and disabled ram
+    [[nodiscard]] uint8_t read_ram(uint16_t offset) const
+    {
+        return eram_read_[offset & eram_mask_];
+    }
+
+    // the currently mapped rom banks, for callers that read them through their own page tables.
+    // they move on writes to the mbc registers
+    [[nodiscard]] const uint8_t* rom0_window() const
+    {
+        return rom0_;
+    }
+
+    [[nodiscard]] const uint8_t* romx_window() const
+    {
+        return romx_;
+    }
+
+    // writes to 0x0000-0x7FFF. clock is the emulated machine cycle count, used by the mbc3 rtc
+    void write_control(uint16_t address, uint8_t value, uint64_t clock);
+
+    // writes to 0xA000-0xBFFF, offset from 0xA000
+    void write_ram(uint16_t offset, uint8_t value, uint64_t clock);
+
+    /** backs battery-buffered ram (and the rtc) with a .sav file, loading it if it exists.
+     * the rtc is stored in the common 48 byte footer format and catches up with the real time spent while off.
+     * does nothing for cartridges without a battery.
+     */
+    void attach_save(const std::filesystem::path& sav_path, uint64_t clock);
+
+    // writes back whatever changed since the last flush. cheap enough to call on a timer
+    void flush_save(uint64_t clock);
+
+    // mbc registers, rtc and ram contents, see save_state.h. the rom itself is not part of the state
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+
+    [[nodiscard]] mbc_type type() const
+    {
+        return mbc_;
+    }
+
+    [[nodiscard]] bool has_battery() const
+    {
+        return has_battery_;
+    }
+
+    [[nodiscard]] bool has_rtc() const
+    {
+        return has_rtc_;
+    }
+
+    [[nodiscard]] size_t rom_bank_count() const
+    {
+        return rom_->size() / BANK_SIZE_ROM;
+    }
+
+    [[nodiscard]] size_t ram_size() const
+    {
+        return ram_size_;
+    }
+
+    // # of ram banks this cartridge hasn't written to since it was forked, or forked from, and still shares
+    [[nodiscard]] size_t shared_ram_bank_count() const
+    {
+        return ram_banks_.size() - static_cast<size_t>(std::popcount(owned_banks_));
+    }
+
+    [[nodiscard]] bool is_save_attached() const
+    {
+        return save_.is_attached();
+    }
+
+    [[nodiscard]] const rom_image& rom() const
+    {
+        return rom_;
+    }
+
+    // global checksum from the cartridge header (0x14E-0x14F)
+    [[nodiscard]] uint16_t rom_checksum() const
+    {
+        return static_cast<uint16_t>(((*rom_)[0x14E] << 8) | (*rom_)[0x14F]);
+    }
+
+private:
+    static constexpr size_t BANK_SIZE_RAM = 0x2000;
+    static constexpr size_t MBC2_RAM_SIZE = 0x200; // 512 half-bytes, mirrored over the whole eram window
+
+    // mbc3 rtc register select values (written to 0x4000-0x5FFF)
+    static constexpr uint8_t RTC_S = 0x08;
+    static constexpr uint8_t RTC_M = 0x09;
+    static constexpr uint8_t RTC_H = 0x0A;
+    static constexpr uint8_t RTC_DL = 0x0B;
+    static constexpr uint8_t RTC_DH = 0x0C;
+
+    // returned for disabled or missing ram
+    static constexpr uint8_t OPEN_BUS = 0xFF;
+
+    // 5 current and 5 latched registers as 32 bit values, followed by a 64 bit unix timestamp
+    static constexpr size_t RTC_FOOTER_SIZE = 48;
+
+    using ram_bank_data = std::array<uint8_t, BANK_SIZE_RAM>;
+
+    struct fork_tag
+    {
+    };
+
+    rom_image rom_;
+
+    // external ram in 8 KB banks, smaller ram sits at the start of its only bank. banks are shared between forks.
+    // a bank is only written in place while its bit in owned_banks_ is set, forking clears them on both sides
+    std::vector<std::shared_ptr<ram_bank_data>> ram_banks_;
+    uint16_t owned_banks_ {0};
+    size_t ram_size_ {0};
+
+    // the .sav file. ram writes go through to it while it is attached, which forks and copies never are
+    battery_ram save_;
+
+    mbc_type mbc_ {mbc_type::none};
+    bool has_battery_ {false};
+    bool has_rtc_ {false};
+
+    // mbc registers. for mbc1, ram_bank_ holds the 2 bit secondary register shared with the upper rom bits
+    uint16_t rom_bank_ {1};
+    uint8_t ram_bank_ {0};
+    bool banking_mode_ {false};
+    bool ram_enabled_ {false};
+
+    // resolved windows, only updated on bank register writes
+    const uint8_t* rom0_ {nullptr};
+    const uint8_t* romx_ {nullptr};
+    const uint8_t* eram_read_ {&OPEN_BUS};
+    uint8_t* eram_write_ {nullptr};
+    uint16_t eram_mask_ {0};
+    size_t eram_bank_ {0}; // index of the mapped bank into ram_banks_
+
+    // the rtc is never ticked. it stores the time at base_clock_ and derives the current time from the
+    // emulated clock whenever it is latched or written
+    uint64_t rtc_base_seconds_ {0};
+    uint64_t rtc_base_clock_ {0};
+    bool rtc_halted_ {false};
+    bool rtc_carry_ {false};
+    uint8_t rtc_latch_prev_ {0xFF};
+    std::array<uint8_t, 5> rtc_latched_ {};
+
+    cartridge(cartridge& parent, fork_tag);
+
+    void parse_header();
+    void allocate_ram(size_t size, uint8_t fill);
+    void copy_registers(const cartridge& other);
+    void update_banks();
+
+    [[nodiscard]] uint64_t rtc_seconds(uint64_t clock) const;
+    [[nodiscard]] std::array<uint8_t, 5> rtc_registers(uint64_t clock) const;
+    void rtc_latch(uint64_t clock);
+    void rtc_write(uint8_t reg, uint8_t value, uint64_t clock);
+    void rtc_store_footer(uint64_t clock);
+    void rtc_load_footer(uint64_t clock);
+};
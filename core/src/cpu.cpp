@@ -1,5 +1,6 @@
 #include "cpu.h"
 
+#include "host_trace.h"
 #include "../resources/dmg_opcodes.h"
 
 #include <filesystem>
@@ -7,6 +8,11 @@
 
 uint32_t gb::cpu::execute(memory_map& mem)
 {
+    GB_TRACE_TOTAL(trace_total::cpu_execute);
+#ifdef GB_PROFILE
+    // looked up before the instruction runs, it may map another bank over itself
+    profile_counter* location = profiler_ ? &profiler_->locate(mem, PC.full) : nullptr;
+#endif
     const uint8_t opcode = mem.read(PC.full++);
     uint32_t cycles = 0; // instruction functions handle all the cycle info, no work needs to be done here
 
@@ -21,6 +27,12 @@ uint32_t gb::cpu::execute(memory_map& mem)
     else
         std::cerr << "Unknown opcode: 0x" << std::hex << (opcode) << std::endl;
 
+#ifdef GB_PROFILE
+    if (location)
+        profiler_->record(*location, opcode, cycles);
+#endif
+
+    mem.advance_clock(cycles);
     return cycles;
 }
 
@@ -35,6 +47,26 @@ void gb::cpu::power_up_sequence()
     HL.full = 0x014D;
 }
 
+void gb::cpu::save(state_writer& out) const
+{
+    out.write(AF);
+    out.write(BC);
+    out.write(DE);
+    out.write(HL);
+    out.write(SP);
+    out.write(PC);
+}
+
+void gb::cpu::load(state_reader& in)
+{
+    in.read(AF);
+    in.read(BC);
+    in.read(DE);
+    in.read(HL);
+    in.read(SP);
+    in.read(PC);
+}
+
 void gb::cpu::init_instruction_table()
 {
     std::fill_n(instruction_table, 256, &cpu::invalid_opcode);
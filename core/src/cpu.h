@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 #include <cstdint>
 
 #include "memory_map.h"
+#include "profiler.h"
+#include "save_state.h"
 
 namespace gb
 {
@@ -46,6 +50,31 @@ struct gb::cpu
         power_up_sequence();
     }
 
+    // copies only take the registers, register16s/register8s have to keep pointing at their own
+    cpu(const cpu& other)
+        :
+        AF(other.AF),
+        BC(other.BC),
+        DE(other.DE),
+        HL(other.HL),
+        SP(other.SP),
+        PC(other.PC),
+        instruction_table{}
+    {
+        std::copy(std::begin(other.instruction_table), std::end(other.instruction_table), instruction_table);
+    }
+
+    cpu& operator=(const cpu& other)
+    {
+        AF = other.AF;
+        BC = other.BC;
+        DE = other.DE;
+        HL = other.HL;
+        SP = other.SP;
+        PC = other.PC;
+        return *this;
+    }
+
     Register16 AF; // Accumulator and flags. bit 7 (0x80) = z, 6 (0x40) = n, 5 (0x20) = h, 4 (0x10) = c
     Register16 BC;
     Register16 DE;
@@ -95,8 +124,25 @@ struct gb::cpu
     // returns the # of machine cycles (1 mc = 4 clock cycles)
     uint32_t execute(memory_map& mem);
 
+    // counts every instruction executed from here on into p, nullptr stops. only in GB_PROFILE builds, otherwise
+    // this does nothing (see profiler.h). copies of the cpu don't profile
+#ifdef GB_PROFILE
+    void set_profiler(profiler* p)
+    {
+        profiler_ = p;
+    }
+#else
+    void set_profiler(profiler*)
+    {
+    }
+#endif
+
     void power_up_sequence();
 
+    // registers only, the instruction table is rebuilt by the constructor. see save_state.h
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+
     void init_instruction_table();
 
     [[nodiscard]] bool get_flag(flag_types flag) const
@@ -220,4 +266,9 @@ struct gb::cpu
     uint32_t or_a_n(memory_map& mem);
     template <r8 reg>
     uint32_t xor_a_r8(memory_map&);
+
+#ifdef GB_PROFILE
+private:
+    profiler* profiler_ = nullptr;
+#endif
 };
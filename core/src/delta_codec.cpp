@@ -0,0 +1,125 @@
+#include "delta_codec.h"
+
+#include <cstring>
+
+namespace
+{
+    // a literal run only ends at this many zero bytes, shorter gaps cost more as tokens than as literals
+    constexpr size_t MIN_ZERO_RUN = 4;
+
+    uint8_t delta_at(std::span<const uint8_t> data, std::span<const uint8_t> reference, size_t i)
+    {
+        return reference.empty() ? data[i] : data[i] ^ reference[i];
+    }
+
+    // skips zero delta bytes, a word at a time
+    size_t zero_run(std::span<const uint8_t> data, std::span<const uint8_t> reference, size_t pos)
+    {
+        const size_t size = data.size();
+        size_t i = pos;
+        while (i + 8 <= size)
+        {
+            uint64_t a = 0;
+            uint64_t b = 0;
+            std::memcpy(&a, data.data() + i, 8);
+            if (!reference.empty())
+                std::memcpy(&b, reference.data() + i, 8);
+            if ((a ^ b) != 0)
+                break;
+            i += 8;
+        }
+        while (i < size && delta_at(data, reference, i) == 0)
+            i++;
+        return i - pos;
+    }
+
+    size_t literal_run(std::span<const uint8_t> data, std::span<const uint8_t> reference, size_t pos)
+    {
+        const size_t size = data.size();
+        size_t i = pos;
+        size_t zeros = 0;
+        while (i < size)
+        {
+            zeros = delta_at(data, reference, i) == 0 ? zeros + 1 : 0;
+            i++;
+            if (zeros == MIN_ZERO_RUN)
+                return i - pos - zeros;
+        }
+        return i - pos - zeros;
+    }
+
+    bool write_varint(std::span<uint8_t> out, size_t& o, size_t value)
+    {
+        do
+        {
+            if (o >= out.size())
+                return false;
+            out[o++] = static_cast<uint8_t>((value & 0x7F) | (value > 0x7F ? 0x80 : 0x00));
+            value >>= 7;
+        } while (value != 0);
+        return true;
+    }
+
+    bool read_varint(std::span<const uint8_t> in, size_t& i, size_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (i >= in.size())
+                return false;
+            const uint8_t byte = in[i++];
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+size_t gb::delta_codec::encode(std::span<const uint8_t> data, std::span<const uint8_t> reference,
+                               std::span<uint8_t> out)
+{
+    if (!reference.empty() && reference.size() != data.size())
+        return 0;
+
+    size_t pos = 0;
+    size_t o = 0;
+    while (pos < data.size())
+    {
+        const size_t zeros = zero_run(data, reference, pos);
+        pos += zeros;
+        const size_t literals = literal_run(data, reference, pos);
+
+        if (!write_varint(out, o, zeros) || !write_varint(out, o, literals) || o + literals > out.size())
+            return 0;
+
+        for (size_t i = 0; i < literals; i++)
+            out[o + i] = delta_at(data, reference, pos + i);
+        o += literals;
+        pos += literals;
+    }
+    return o;
+}
+
+bool gb::delta_codec::decode(std::span<const uint8_t> in, std::span<uint8_t> inout)
+{
+    size_t i = 0;
+    size_t pos = 0;
+    while (i < in.size())
+    {
+        size_t zeros = 0;
+        size_t literals = 0;
+        if (!read_varint(in, i, zeros) || !read_varint(in, i, literals))
+            return false;
+
+        pos += zeros;
+        if (pos + literals > inout.size() || i + literals > in.size())
+            return false;
+
+        for (size_t l = 0; l < literals; l++)
+            inout[pos + l] ^= in[i + l];
+        i += literals;
+        pos += literals;
+    }
+    return pos == inout.size();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// xor delta + zero run length coding for snapshots of fixed layout data (save states, frames).
+// consecutive snapshots mostly differ in a few places, so their xor is mostly zeros and collapses to a handful of
+// (zero run, literal run) tokens. encoding against no reference stores the data itself, which works the same way.
+namespace gb::delta_codec
+{
+    // upper bound of the encoded size of `size` bytes, for sizing output buffers up front
+    [[nodiscard]] constexpr size_t max_encoded_size(size_t size)
+    {
+        // every token covers at least 5 bytes (4 zeros + 1 literal) and costs at most 2 varints
+        return size + (size / 5 + 1) * 2 * 5 + 16;
+    }
+
+    /** encodes `data` xor `reference`. reference may be empty, otherwise it has to be the same size as data.
+     * @returns # of bytes written, 0 if out is too small
+     */
+    size_t encode(std::span<const uint8_t> data, std::span<const uint8_t> reference, std::span<uint8_t> out);
+
+    /** xors the decoded delta onto `inout`. decoding onto the reference yields the data,
+     * decoding something encoded without reference needs a zeroed buffer.
+     * @returns false if the input is malformed or doesn't match the buffer size
+     */
+    bool decode(std::span<const uint8_t> in, std::span<uint8_t> inout);
+}
@@ -0,0 +1,31 @@
+#include "gameboy.h"
+
+#include "host_trace.h"
+
+#include <algorithm>
+
+uint32_t gb::gameboy::run_frame()
+{
+    GB_TRACE_SCOPE("gameboy::run_frame");
+    const uint64_t start_frame = ppu.get_frame_count();
+    uint32_t cycles = 0;
+    uint32_t budget = 0;
+
+    while (ppu.get_frame_count() == start_frame && budget < gb::ppu::CYCLES_FRAME)
+    {
+        const uint32_t instruction_cycles = cpu.execute(mem);
+        ppu.tick(instruction_cycles, mem);
+        cycles += instruction_cycles;
+        // unimplemented opcodes report 0 cycles and don't advance the ppu, so bound the loop by instructions too
+        budget += std::max<uint32_t>(instruction_cycles, 1);
+    }
+
+    end_frame();
+    return cycles;
+}
+
+void gb::gameboy::end_frame()
+{
+    mem.get_apu().synthesize(mem.get_clock());
+    GB_TRACE_FLUSH_TOTALS();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "cpu.h"
+#include "memory_map.h"
+#include "ppu.h"
+
+namespace gb
+{
+    class gameboy;
+}
+
+// bundles the components of one emulated console and drives them a frame at a time.
+// headless runners, rewind and anything else that thinks in frames go through this.
+class gb::gameboy
+{
+public:
+    gameboy() = default;
+    explicit gameboy(rom_image rom)
+    {
+        mem.load_rom(std::move(rom));
+    }
+
+    // copying means a full copy of every component, fork() is what's meant to be used
+    gameboy(const gameboy&) = delete;
+    gameboy& operator=(const gameboy&) = delete;
+
+    // a copy of the console that shares memory pages with this one until either writes them.
+    // see memory_map::fork, this console loses write access to its shared pages as well
+    gameboy fork()
+    {
+        return gameboy{*this, fork_tag{}};
+    }
+
+    /** runs until the ppu finishes a frame, then synthesizes its audio if the apu has synthesis on
+     * @returns # of machine cycles executed
+     */
+    uint32_t run_frame();
+
+    /** what has to happen once a frame's instructions ran: synthesizes the queued audio writes (a no-op unless
+     * someone asked for audio) and writes the frame's trace totals (see host_trace.h). run_frame calls it,
+     * anything stepping the cpu and ppu by itself has to as well, and has to go through cpu::execute for its
+     * instructions to be traced and profiled
+     */
+    void end_frame();
+
+    [[nodiscard]] uint64_t get_frame_count() const
+    {
+        return ppu.get_frame_count();
+    }
+
+    size_t save_state(std::span<uint8_t> out, uint16_t flags = 0) const
+    {
+        return gb::save_state(cpu, mem, ppu, out, flags);
+    }
+
+    bool load_state(std::span<const uint8_t> in)
+    {
+        return gb::load_state(cpu, mem, ppu, in);
+    }
+
+    [[nodiscard]] size_t save_state_size(uint16_t flags = 0) const
+    {
+        return gb::save_state_size(cpu, mem, ppu, flags);
+    }
+
+    gb::cpu cpu{};
+    gb::memory_map mem{};
+    gb::ppu ppu{};
+
+private:
+    struct fork_tag
+    {
+    };
+
+    gameboy(gameboy& parent, fork_tag)
+        : cpu(parent.cpu),
+          mem(parent.mem.fork()),
+          ppu(parent.ppu)
+    {
+    }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gb
+{
+    // 64 bit fnv-1a, stable across platforms of the same endianness
+    inline uint64_t hash_bytes(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = 0xCBF29CE484222325;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3;
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,178 @@
+#include "host_trace.h"
+
+#include <array>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct trace_event
+    {
+        const char* name;
+        uint64_t start; // trace clock
+        uint64_t value; // the duration of complete events, the summed time of counters, in trace clock ticks
+        char phase; // 'X' complete, 'C' counter
+    };
+
+    struct thread_buffer
+    {
+        uint32_t tid;
+        std::string name;
+        std::vector<trace_event> events;
+        std::array<uint64_t, static_cast<size_t>(gb::trace_total::count)> totals {};
+        uint64_t dropped = 0;
+    };
+
+    constexpr const char* TOTAL_NAMES[] = {"cpu::execute", "ppu::tick"};
+    static_assert(std::size(TOTAL_NAMES) == static_cast<size_t>(gb::trace_total::count));
+
+    // buffers are never freed, threads keep pointers to theirs and the trace outlives them
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<thread_buffer>> registry;
+    thread_local thread_buffer* local_buffer = nullptr;
+
+    // the clocks when recording started, to convert trace clock ticks to time on export
+    uint64_t origin_ticks = 0;
+    std::chrono::steady_clock::time_point origin_time;
+
+    thread_buffer& get_local_buffer()
+    {
+        if (!local_buffer)
+        {
+            const std::scoped_lock lock{registry_mutex};
+            auto buffer = std::make_unique<thread_buffer>();
+            buffer->tid = static_cast<uint32_t>(registry.size() + 1);
+            buffer->name = "thread " + std::to_string(buffer->tid);
+            buffer->events.reserve(4096);
+            local_buffer = buffer.get();
+            registry.push_back(std::move(buffer));
+        }
+        return *local_buffer;
+    }
+
+    void push_event(thread_buffer& buffer, const trace_event& event)
+    {
+        if (buffer.events.size() >= gb::host_trace::MAX_EVENTS_PER_THREAD)
+        {
+            buffer.dropped++;
+            return;
+        }
+        buffer.events.push_back(event);
+    }
+
+    void write_string(std::ostream& out, const std::string& s)
+    {
+        out << '"';
+        for (const char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            if (static_cast<unsigned char>(c) >= 0x20)
+                out << c;
+        }
+        out << '"';
+    }
+}
+
+void gb::host_trace::start()
+{
+    origin_ticks = read_trace_clock();
+    origin_time = std::chrono::steady_clock::now();
+    recording_.store(true, std::memory_order_relaxed);
+}
+
+void gb::host_trace::stop()
+{
+    recording_.store(false, std::memory_order_relaxed);
+}
+
+void gb::host_trace::set_thread_name(std::string name)
+{
+    get_local_buffer().name = std::move(name);
+}
+
+void gb::host_trace::add_event(const char* name, uint64_t start, uint64_t end)
+{
+    push_event(get_local_buffer(), {name, start, end - start, 'X'});
+}
+
+void gb::host_trace::add_total(trace_total total, uint64_t ticks)
+{
+    get_local_buffer().totals[static_cast<size_t>(total)] += ticks;
+}
+
+void gb::host_trace::flush_totals()
+{
+    if (!is_recording())
+        return;
+
+    thread_buffer& buffer = get_local_buffer();
+    const uint64_t now = read_trace_clock();
+    for (size_t i = 0; i < buffer.totals.size(); i++)
+    {
+        push_event(buffer, {TOTAL_NAMES[i], now, buffer.totals[i], 'C'});
+        buffer.totals[i] = 0;
+    }
+}
+
+void gb::host_trace::write_json(std::ostream& out)
+{
+    // the time stamp counter's rate, from how far it and the steady clock went since recording started
+    const uint64_t ticks = read_trace_clock() - origin_ticks;
+    const auto elapsed = std::chrono::steady_clock::now() - origin_time;
+    const double us = std::chrono::duration<double, std::micro>(elapsed).count();
+    const double ticks_per_us = us > 0.0 && ticks > 0 ? static_cast<double>(ticks) / us : 1.0;
+
+    const std::scoped_lock lock{registry_mutex};
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3); // microseconds, to the nanosecond
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : registry)
+    {
+        out << (first ? "\n" : ",\n") << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->tid
+            << R"(,"args":{"name":)";
+        write_string(out, buffer->name);
+        out << "}}";
+        first = false;
+
+        for (const trace_event& event : buffer->events)
+        {
+            const double ts = static_cast<double>(static_cast<int64_t>(event.start - origin_ticks)) / ticks_per_us;
+            const double value = static_cast<double>(event.value) / ticks_per_us;
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":"
+                << buffer->tid << ",\"ts\":" << ts;
+            if (event.phase == 'X')
+                out << ",\"dur\":" << value << '}';
+            else
+                out << ",\"id\":" << buffer->tid << ",\"args\":{\"us\":" << value << "}}";
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void gb::host_trace::clear()
+{
+    const std::scoped_lock lock{registry_mutex};
+    for (const auto& buffer : registry)
+    {
+        buffer->events.clear();
+        buffer->totals = {};
+        buffer->dropped = 0;
+    }
+}
+
+uint64_t gb::host_trace::dropped()
+{
+    const std::scoped_lock lock{registry_mutex};
+    uint64_t dropped = 0;
+    for (const auto& buffer : registry)
+        dropped += buffer->dropped;
+    return dropped;
+}
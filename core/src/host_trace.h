@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define GB_HAS_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GB_HAS_RDTSC
+#endif
+
+namespace gb
+{
+    class host_trace;
+    class trace_scope;
+    class trace_total_scope;
+
+    // hot paths that run too often to trace every call. their time is summed per thread and written as one
+    // counter event per frame, see host_trace::flush_totals
+    enum class trace_total : uint8_t
+    {
+        cpu_execute,
+        ppu_tick,
+        count
+    };
+
+    // the host's time stamp counter where there is one, nanoseconds otherwise. converted to time on export
+    inline uint64_t read_trace_clock()
+    {
+#ifdef GB_HAS_RDTSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+}
+
+// where the host's time goes: scoped timers on the hot paths of the emulation and the presentation, recorded into
+// one buffer per thread and exported as chrome trace event json (chrome://tracing, perfetto). tells whether a
+// workload is bound by the cpu core, the ppu or presenting without attaching a profiler.
+// the call sites are the GB_TRACE_* macros below, they only exist in builds with GB_TRACE (cmake -DGB_TRACE=ON).
+// with it, a scope costs two reads of the time stamp counter while recording and one relaxed load while not
+class gb::host_trace
+{
+public:
+#ifdef GB_TRACE
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    // events past this many per thread are dropped, and counted
+    static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    // starts recording, on every thread
+    static void start();
+    static void stop();
+
+    [[nodiscard]] static bool is_recording()
+    {
+        return recording_.load(std::memory_order_relaxed);
+    }
+
+    // names the calling thread in the trace
+    static void set_thread_name(std::string name);
+
+    /** writes the calling thread's totals (see trace_total) as counter events, in microseconds since the last
+     * flush, and resets them. the emulation calls this once a frame
+     */
+    static void flush_totals();
+
+    /** writes the recorded events as chrome trace event json. call it once recording stopped and the traced
+     * threads are idle or gone, the buffers aren't locked against their threads
+     */
+    static void write_json(std::ostream& out);
+
+    // throws the recorded events away
+    static void clear();
+
+    // # of events that didn't fit into their thread's buffer
+    [[nodiscard]] static uint64_t dropped();
+
+    // called by the scopes
+    static void add_event(const char* name, uint64_t start, uint64_t end);
+    static void add_total(trace_total total, uint64_t ticks);
+
+private:
+    static inline std::atomic<bool> recording_ {false};
+};
+
+// records the time from construction to destruction as one complete event, if recording
+class gb::trace_scope
+{
+public:
+    // name has to outlive the trace, a string literal
+    explicit trace_scope(const char* name) :
+        name_(name),
+        start_(host_trace::is_recording() ? read_trace_clock() : 0)
+    {
+    }
+
+    ~trace_scope()
+    {
+        if (start_)
+            host_trace::add_event(name_, start_, read_trace_clock());
+    }
+
+    trace_scope(const trace_scope&) = delete;
+    trace_scope& operator=(const trace_scope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// adds the time from construction to destruction to a per thread total, if recording
+class gb::trace_total_scope
+{
+public:
+    explicit trace_total_scope(trace_total total) :
+        total_(total),
+        start_(host_trace::is_recording() ? read_trace_clock() : 0)
+    {
+    }
+
+    ~trace_total_scope()
+    {
+        if (start_)
+            host_trace::add_total(total_, read_trace_clock() - start_);
+    }
+
+    trace_total_scope(const trace_total_scope&) = delete;
+    trace_total_scope& operator=(const trace_total_scope&) = delete;
+
+private:
+    trace_total total_;
+    uint64_t start_;
+};
+
+#define GB_TRACE_CONCAT_(a, b) a##b
+#define GB_TRACE_CONCAT(a, b) GB_TRACE_CONCAT_(a, b)
+
+#ifdef GB_TRACE
+#define GB_TRACE_SCOPE(name) const gb::trace_scope GB_TRACE_CONCAT(trace_scope_, __LINE__){name}
+#define GB_TRACE_TOTAL(total) const gb::trace_total_scope GB_TRACE_CONCAT(trace_total_, __LINE__){total}
+#define GB_TRACE_FLUSH_TOTALS() gb::host_trace::flush_totals()
+#define GB_TRACE_THREAD_NAME(name) gb::host_trace::set_thread_name(name)
+#else
+#define GB_TRACE_SCOPE(name) ((void)0)
+#define GB_TRACE_TOTAL(total) ((void)0)
+#define GB_TRACE_FLUSH_TOTALS() ((void)0)
+#define GB_TRACE_THREAD_NAME(name) ((void)0)
+#endif
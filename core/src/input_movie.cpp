@@ -0,0 +1,53 @@
+#include "input_movie.h"
+
+#include <fstream>
+#include <stdexcept>
+
+gb::input_movie::input_movie(const std::filesystem::path& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    input_movie_header header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != INPUT_MOVIE_MAGIC)
+        throw std::runtime_error("Not an input movie: " + path.string());
+    if (header.version != INPUT_MOVIE_VERSION && header.version != 1)
+        throw std::runtime_error("Unsupported input movie version: " + path.string());
+
+    // the count comes from the file, so it's checked against the file's size before anything is allocated for it
+    const bool hashed = header.version > 1 && (header.flags & INPUT_MOVIE_HASHES);
+    const std::streamoff start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const auto remaining = static_cast<uint64_t>(file.tellg() - start);
+    file.seekg(start);
+    if (remaining < uint64_t{header.frame_count} * (1 + (hashed ? sizeof(uint64_t) : 0)))
+        throw std::runtime_error("Input movie is truncated: " + path.string());
+
+    frames_.resize(header.frame_count);
+    if (!file.read(reinterpret_cast<char*>(frames_.data()), static_cast<std::streamsize>(frames_.size())))
+        throw std::runtime_error("Input movie is truncated: " + path.string());
+
+    if (hashed)
+    {
+        hashes_.resize(header.frame_count);
+        if (!file.read(reinterpret_cast<char*>(hashes_.data()),
+                       static_cast<std::streamsize>(hashes_.size() * sizeof(uint64_t))))
+            throw std::runtime_error("Input movie is truncated: " + path.string());
+    }
+}
+
+void gb::input_movie::save(const std::filesystem::path& path) const
+{
+    input_movie_header header{};
+    header.magic = INPUT_MOVIE_MAGIC;
+    header.version = INPUT_MOVIE_VERSION;
+    header.flags = has_hashes() ? INPUT_MOVIE_HASHES : 0;
+    header.frame_count = static_cast<uint32_t>(frames_.size());
+
+    std::ofstream file{path, std::ios::binary};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(frames_.data()), static_cast<std::streamsize>(frames_.size()));
+    if (has_hashes())
+        file.write(reinterpret_cast<const char*>(hashes_.data()),
+                   static_cast<std::streamsize>(hashes_.size() * sizeof(uint64_t)));
+    if (!file)
+        throw std::runtime_error("Failed to write input movie: " + path.string());
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace gb
+{
+    class input_movie;
+
+    static constexpr uint32_t INPUT_MOVIE_MAGIC = 0x564D4247; // "GBMV"
+    static constexpr uint16_t INPUT_MOVIE_VERSION = 2; // 1 is read as well, it had no flags
+
+    // input_movie_header::flags
+    static constexpr uint16_t INPUT_MOVIE_HASHES = 0x0001;
+
+    // file layout: this header, then one byte per frame, the joypad buttons held during that frame (see joypad.h).
+    // with INPUT_MOVIE_HASHES, a 64 bit state hash per frame follows (see replay.h). all values in host byte order
+    struct input_movie_header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t flags;
+        uint32_t frame_count;
+    };
+}
+
+// the buttons held in every frame of a run, for replaying it exactly. playing back is an index into an array, so a
+// movie costs nothing measurable on top of the emulation, headless or not.
+// a movie can carry the hash of the console's state after every frame as well, to tell where a replay went
+// differently than the run it was recorded from
+class gb::input_movie
+{
+public:
+    input_movie() = default;
+
+    // throws std::runtime_error if the file can't be read or isn't a movie
+    explicit input_movie(const std::filesystem::path& path);
+
+    // throws std::runtime_error if the file can't be written
+    void save(const std::filesystem::path& path) const;
+
+    // the buttons of frame, nothing held past the end of the movie
+    [[nodiscard]] uint8_t get_buttons(uint64_t frame) const
+    {
+        return frame < frames_.size() ? frames_[frame] : 0;
+    }
+
+    void add_frame(uint8_t buttons)
+    {
+        frames_.push_back(buttons);
+    }
+
+    [[nodiscard]] uint64_t frame_count() const
+    {
+        return frames_.size();
+    }
+
+    // whether there's a state hash for every frame
+    [[nodiscard]] bool has_hashes() const
+    {
+        return !frames_.empty() && hashes_.size() == frames_.size();
+    }
+
+    [[nodiscard]] uint64_t get_hash(uint64_t frame) const
+    {
+        return hashes_[frame];
+    }
+
+    // one per frame, in order
+    void set_hashes(std::vector<uint64_t> hashes)
+    {
+        hashes_ = std::move(hashes);
+    }
+
+private:
+    std::vector<uint8_t> frames_;
+    std::vector<uint64_t> hashes_;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "save_state.h"
+
+#include <cstdint>
+
+namespace gb
+{
+    class joypad;
+}
+
+// the joypad register, 0xFF00. the 8 buttons sit on a matrix of 2 rows and 4 lines: writing 0 to bit 4 selects
+// the directions, 0 to bit 5 the buttons, and the low 4 bits read back 0 for every pressed button on a selected
+// row. a line going from 1 to 0, by a press or by selecting a row with something held, requests the joypad
+// interrupt. the buttons are whatever the frontend or a movie last set, the emulated program only sees them
+// through the matrix.
+class gb::joypad
+{
+public:
+    static constexpr uint16_t ADDRESS = 0xFF00;
+
+    // button bits, the directions are the low nibble in the order of their lines, the buttons the high nibble
+    static constexpr uint8_t RIGHT = 0x01;
+    static constexpr uint8_t LEFT = 0x02;
+    static constexpr uint8_t UP = 0x04;
+    static constexpr uint8_t DOWN = 0x08;
+    static constexpr uint8_t A = 0x10;
+    static constexpr uint8_t B = 0x20;
+    static constexpr uint8_t SELECT = 0x40;
+    static constexpr uint8_t START = 0x80;
+
+    [[nodiscard]] uint8_t read() const
+    {
+        return 0xC0 | select_ | lines();
+    }
+
+    /** only the select bits are writable
+     * @returns whether a line went low, which requests the joypad interrupt
+     */
+    bool write(uint8_t value)
+    {
+        const uint8_t before = lines();
+        select_ = value & 0x30;
+        return (before & ~lines()) != 0;
+    }
+
+    /** sets the pressed buttons, as a mask of the bits above
+     * @returns whether a line went low, which requests the joypad interrupt
+     */
+    bool set_buttons(uint8_t buttons)
+    {
+        const uint8_t before = lines();
+        buttons_ = buttons;
+        return (before & ~lines()) != 0;
+    }
+
+    [[nodiscard]] uint8_t get_buttons() const
+    {
+        return buttons_;
+    }
+
+    // see save_state.h
+    void save(state_writer& out) const
+    {
+        out.write(select_);
+        out.write(buttons_);
+    }
+
+    void load(state_reader& in)
+    {
+        in.read(select_);
+        in.read(buttons_);
+    }
+
+private:
+    // the 4 lines, 0 where a pressed button is on a selected row
+    [[nodiscard]] uint8_t lines() const
+    {
+        uint8_t pressed = 0;
+        if (!(select_ & 0x10))
+            pressed |= buttons_ & 0x0F;
+        if (!(select_ & 0x20))
+            pressed |= buttons_ >> 4;
+        return ~pressed & 0x0F;
+    }
+
+    uint8_t select_ {0x30}; // nothing selected
+    uint8_t buttons_ {0};
+};
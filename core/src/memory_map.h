@@ -1,12 +1,16 @@
 #pragma once
 #include "../resources/dmg_boot.h"
+#include "apu.h"
+#include "cartridge.h"
+#include "joypad.h"
+#include "save_state.h"
 
 #include <cstdint>
 #include <array>
-#include <vector>
+#include <bit>
 #include <filesystem>
-#include <fstream>
-#include <iostream>
+#include <memory>
+#include <span>
 
 // Memory sizes
 #define ROM_BANK_SIZE (0x4000)    // 16 KB per bank
@@ -17,6 +21,18 @@
 #define IO_SIZE       (0x80)      // 128 bytes    (0xFF00-0xFF7F)
 #define HRAM_SIZE     (0x7F)      // 127 bytes    (0xFF80-0xFFFE)
 
+// Paging
+#define MEM_PAGE_SIZE  (0x1000)   // 4 KB, the granularity of the page tables and of copy-on-write between forks
+#define MEM_PAGE_SHIFT 12
+#define MEM_PAGE_MASK  (MEM_PAGE_SIZE - 1)
+#define MEM_PAGE_COUNT (0x10)     // covers the whole address space
+#define RAM_PAGE_COUNT 4          // 2 vram pages followed by 2 wram pages
+#define VRAM_PAGE_COUNT 2
+
+// Video write tracking
+#define VRAM_BLOCK_SIZE  (0x40)   // granularity of vram dirty tracking
+#define VRAM_BLOCK_COUNT (VRAM_SIZE / VRAM_BLOCK_SIZE)
+
 // Memory regions
 #define ROM_BANK0_START 0x0000    // Fixed bank
 #define ROM_BANK0_END   0x3FFF
@@ -40,6 +56,14 @@
 
 // special registers
 #define BOOT_ROM_DISABLE_REGISTER 0xFF50
+#define IF_REG                    0xFF0F
+
+// interrupt bits in IF and IE
+#define INTERRUPT_VBLANK 0x01
+#define INTERRUPT_STAT   0x02
+#define INTERRUPT_TIMER  0x04
+#define INTERRUPT_SERIAL 0x08
+#define INTERRUPT_JOYPAD 0x10
 
 namespace gb
 {
@@ -50,28 +74,98 @@ class gb::memory_map
 {
 public:
     memory_map()
-        : rom_bank0(std::array<uint8_t, ROM_BANK_SIZE>{}),
-          vram(std::array<uint8_t, VRAM_SIZE>{}),
-          wram(std::array<uint8_t, WRAM_SIZE>{}),
-          oam(std::array<uint8_t, OAM_SIZE>{}),
+        : oam(std::array<uint8_t, OAM_SIZE>{}),
           io(std::array<uint8_t, IO_SIZE>{}),
           hram(std::array<uint8_t, HRAM_SIZE>{}),
           ie_register(0),
-          current_rom_bank(1), // Bank 0 is fixed, so we start with bank 1
-          current_ram_bank(0),
-          ram_enabled(false),
           boot_rom_enabled(true)
     {
-        rom_bank0.fill(0);
-        vram.fill(0);
-        wram.fill(0);
+        for (auto& ram_page : ram_pages)
+        {
+            ram_page = std::make_shared<page>();
+            ram_page->fill(0);
+        }
         oam.fill(0);
         io.fill(0xFF);
         hram.fill(0);
+        update_page_tables();
+    }
+
+    ~memory_map()
+    {
+        cart.flush_save(clock);
+    }
+
+    // copies own all of their memory, fork() is the cheap alternative
+    memory_map(const memory_map& other)
+        : cart(other.cart),
+          audio(other.audio),
+          pad(other.pad),
+          oam(other.oam),
+          io(other.io),
+          hram(other.hram),
+          ie_register(other.ie_register),
+          clock(other.clock),
+          boot_rom_enabled(other.boot_rom_enabled)
+    {
+        for (size_t i = 0; i < RAM_PAGE_COUNT; i++)
+        {
+            ram_pages[i] = std::make_shared<page>(*other.ram_pages[i]);
+        }
+        update_page_tables();
+    }
+
+    memory_map& operator=(const memory_map& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        cart = other.cart;
+        audio = other.audio;
+        pad = other.pad;
+        for (size_t i = 0; i < RAM_PAGE_COUNT; i++)
+        {
+            ram_pages[i] = std::make_shared<page>(*other.ram_pages[i]);
+        }
+        owned_pages = ALL_RAM_PAGES;
+        oam = other.oam;
+        io = other.io;
+        hram = other.hram;
+        ie_register = other.ie_register;
+        clock = other.clock;
+        boot_rom_enabled = other.boot_rom_enabled;
+        written_pages = ALL_RAM_PAGES;
+        update_page_tables();
+        mark_video_dirty();
+        return *this;
+    }
+
+    /** copy-on-write copy, for exploring many futures of one state. vram and wram pages, and the cartridge's ram
+     * banks (see cartridge::fork), are shared between the two maps until either of them writes to one, the rom is
+     * always shared. oam, io and hram are small enough to copy. the fork never writes back to the save file, and
+     * its apu has synthesis off (see apu::fork), whatever the fork plays isn't meant to be heard.
+     * not const: this map loses write access to its pages as well, so its next write to one copies it.
+     */
+    memory_map fork()
+    {
+        return memory_map{*this, fork_tag{}};
+    }
+
+    // # of vram/wram pages this map hasn't written to since it was forked, or forked from, and still shares
+    [[nodiscard]] size_t shared_page_count() const
+    {
+        return RAM_PAGE_COUNT - static_cast<size_t>(std::popcount(owned_pages));
     }
 
     [[nodiscard]] uint8_t read(uint16_t address) const
     {
+        // rom and ram without side effects is read straight from the page tables
+        if (const uint8_t* page_data = read_pages[address >> MEM_PAGE_SHIFT])
+        {
+            return page_data[address & MEM_PAGE_MASK];
+        }
+
         // Boot ROM handling (first 256 bytes)
         if (boot_rom_enabled && address < 0x100)
         {
@@ -80,31 +174,23 @@ public:
 
         if (address <= ROM_BANK0_END)
         {
-            return rom_bank0[address];
+            return cart.read_rom0(address);
         }
         else if (address <= ROM_BANKN_END)
         {
-            return rom_banks[current_rom_bank][address - ROM_BANKN_START];
+            return cart.read_romx(address - ROM_BANKN_START);
         }
         else if (address >= VRAM_START && address <= VRAM_END)
         {
-            return vram[address - VRAM_START];
+            return (*ram_pages[ram_page_index(address)])[address & MEM_PAGE_MASK];
         }
         else if (address >= ERAM_START && address <= ERAM_END)
         {
-            if (ram_enabled && !ram_banks.empty())
-            {
-                return ram_banks[current_ram_bank][address - ERAM_START];
-            }
-            return 0xFF;
+            return cart.read_ram(address - ERAM_START);
         }
-        else if (address >= WRAM_START && address <= WRAM_END)
+        else if (address >= WRAM_START && address <= ECHO_END)
         {
-            return wram[address - WRAM_START];
-        }
-        else if (address >= ECHO_START && address <= ECHO_END)
-        {
-            return wram[address - ECHO_START];
+            return (*ram_pages[ram_page_index(address)])[address & MEM_PAGE_MASK];
         }
         else if (address >= OAM_START && address <= OAM_END)
         {
@@ -112,6 +198,14 @@ public:
         }
         else if (address >= IO_START && address <= IO_END)
         {
+            if (address >= apu::REGISTERS_START && address <= apu::REGISTERS_END)
+            {
+                return audio.read(address, clock);
+            }
+            if (address == joypad::ADDRESS)
+            {
+                return pad.read();
+            }
             return io[address - IO_START];
         }
         else if (address >= HRAM_START && address <= HRAM_END)
@@ -127,32 +221,39 @@ public:
 
     void write(uint16_t address, uint8_t value)
     {
-        if (address <= ROM_BANKN_END)
+        // pages this map owns alone are written straight through the page tables
+        if (uint8_t* page_data = write_pages[address >> MEM_PAGE_SHIFT])
         {
-            handle_banking(address, value);
+            page_data[address & MEM_PAGE_MASK] = value;
+            return;
         }
-        else if (address >= VRAM_START && address <= VRAM_END)
+
+        if (address <= ROM_BANKN_END)
         {
-            vram[address - VRAM_START] = value;
+            cart.write_control(address, value, clock);
+            update_page_tables(); // the rom bank may have changed
         }
-        else if (address >= ERAM_START && address <= ERAM_END)
+        else if (address >= VRAM_START && address <= VRAM_END)
         {
-            if (ram_enabled && !ram_banks.empty())
+            writable_page(ram_page_index(address))[address & MEM_PAGE_MASK] = value;
+            if (video_tracking)
             {
-                ram_banks[current_ram_bank][address - ERAM_START] = value;
+                const size_t block = (address - VRAM_START) / VRAM_BLOCK_SIZE;
+                vram_dirty[block / 64] |= uint64_t{1} << (block % 64);
             }
         }
-        else if (address >= WRAM_START && address <= WRAM_END)
+        else if (address >= ERAM_START && address <= ERAM_END)
         {
-            wram[address - WRAM_START] = value;
+            cart.write_ram(address - ERAM_START, value, clock);
         }
-        else if (address >= ECHO_START && address <= ECHO_END)
+        else if (address >= WRAM_START && address <= ECHO_END)
         {
-            wram[address - ECHO_START] = value;
+            writable_page(ram_page_index(address))[address & MEM_PAGE_MASK] = value;
         }
         else if (address >= OAM_START && address <= OAM_END)
         {
             oam[address - OAM_START] = value;
+            oam_dirty = true;
         }
         else if (address >= IO_START && address <= IO_END)
         {
@@ -161,6 +262,20 @@ public:
                 if (value == 0x01)
                 {
                     boot_rom_enabled = false;
+                    update_page_tables();
+                }
+                return;
+            }
+            if (address >= apu::REGISTERS_START && address <= apu::REGISTERS_END)
+            {
+                audio.write(address, value, clock);
+                return;
+            }
+            if (address == joypad::ADDRESS)
+            {
+                if (pad.write(value))
+                {
+                    request_interrupt(INTERRUPT_JOYPAD);
                 }
                 return;
             }
@@ -176,126 +291,350 @@ public:
         }
     }
 
+    // battery-backed cartridges keep their ram in a .sav file next to the rom
     void load_rom(const std::filesystem::path& rom_path)
     {
-        std::ifstream rom_file(rom_path, std::ios::binary);
-        if (!rom_file)
+        cart = cartridge{rom_path};
+        update_page_tables();
+        if (cart.has_battery())
+        {
+            attach_save(std::filesystem::path{rom_path}.replace_extension(".sav"));
+        }
+    }
+
+    // loads an already read rom image, which can be shared between any number of memory maps
+    void load_rom(rom_image rom)
+    {
+        cart = cartridge{std::move(rom)};
+        update_page_tables();
+    }
+
+    void attach_save(const std::filesystem::path& sav_path)
+    {
+        cart.attach_save(sav_path, clock);
+    }
+
+    // only writes back what changed, call it periodically and the rest is handled on destruction
+    void flush_save()
+    {
+        cart.flush_save(clock);
+    }
+
+    [[nodiscard]] const cartridge& get_cartridge() const
+    {
+        return cart;
+    }
+
+    // whether the boot rom still covers 0x0000-0x00FF
+    [[nodiscard]] bool is_boot_rom_mapped() const
+    {
+        return boot_rom_enabled;
+    }
+
+    // sound registers are read and written through the map, synthesis is driven from here
+    [[nodiscard]] apu& get_apu()
+    {
+        return audio;
+    }
+
+    [[nodiscard]] const apu& get_apu() const
+    {
+        return audio;
+    }
+
+    // the buttons held from now on, see joypad.h. a press the program is looking for requests the joypad interrupt
+    void set_buttons(uint8_t buttons)
+    {
+        if (pad.set_buttons(buttons))
+        {
+            request_interrupt(INTERRUPT_JOYPAD);
+        }
+    }
+
+    [[nodiscard]] const joypad& get_joypad() const
+    {
+        return pad;
+    }
+
+    // sets an interrupt's bit in IF, one of INTERRUPT_*
+    void request_interrupt(uint8_t interrupt)
+    {
+        io[IF_REG - IO_START] |= interrupt;
+    }
+
+    // the emulated machine cycle count. components that depend on elapsed time (e.g. the mbc3 rtc) compute
+    // their state from it lazily instead of being ticked
+    void advance_clock(uint32_t cycles)
+    {
+        clock += cycles;
+    }
+
+    [[nodiscard]] uint64_t get_clock() const
+    {
+        return clock;
+    }
+
+    // all ram regions, io registers and the cartridge state, see save_state.h
+    void save(state_writer& out) const
+    {
+        // vram then wram, the same layout as before they were paged
+        for (const auto& ram_page : ram_pages)
         {
-            throw std::runtime_error("Error loading ROM!");
+            out.write(*ram_page);
         }
+        out.write(oam);
+        out.write(io);
+        out.write(hram);
+        out.write(ie_register);
+        out.write(clock);
+        out.write(boot_rom_enabled);
+        cart.save(out);
+        audio.save(out);
+        pad.save(out);
+    }
 
-        // Get file size
-        rom_file.seekg(0, std::ios::end);
-        const size_t rom_size = rom_file.tellg();
-        rom_file.seekg(0);
+    void load(state_reader& in)
+    {
+        for (size_t i = 0; i < RAM_PAGE_COUNT; i++)
+        {
+            writable_page(i);
+            in.read(*ram_pages[i]);
+        }
+        in.read(oam);
+        in.read(io);
+        in.read(hram);
+        in.read(ie_register);
+        in.read(clock);
+        in.read(boot_rom_enabled);
+        cart.load(in);
+        audio.load(in, clock);
+        pad.load(in);
+        update_page_tables();
+        mark_video_dirty();
+    }
 
-        // Read first bank (16KB)
-        rom_file.read(reinterpret_cast<char*>(rom_bank0.data()), ROM_BANK_SIZE);
+    /** tracks writes to vram (in VRAM_BLOCK_SIZE blocks) and oam, for a renderer that keeps its own copy of them.
+     * vram writes take the slow path while enabled. enabling marks everything dirty, so the first take_*() hands
+     * out the whole contents. copies and forks start with tracking disabled.
+     */
+    void set_video_tracking(bool enabled)
+    {
+        video_tracking = enabled;
+        mark_video_dirty();
+        update_page_tables();
+    }
 
-        // Calculate number of additional banks needed
-        const size_t remaining_size = rom_size - ROM_BANK_SIZE;
-        const size_t num_banks = (remaining_size + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE;
-        rom_banks.resize(num_banks, std::array<uint8_t, ROM_BANK_SIZE>{});
+    /** tracks which ram pages (see get_ram_page) are written to, for hashing only what changed. a page takes the
+     * slow path for its first write after every take_written_pages() and is written straight through after that.
+     * enabling marks every page written. copies and forks start with tracking disabled.
+     */
+    void set_page_tracking(bool enabled)
+    {
+        page_tracking = enabled;
+        written_pages = ALL_RAM_PAGES;
+        update_page_tables();
+    }
 
-        // Read remaining banks
-        for (size_t i = 0; i < num_banks && rom_file; ++i)
+    // the ram pages written since the last call, a bit per page, and clears it
+    [[nodiscard]] uint8_t take_written_pages()
+    {
+        const uint8_t written = written_pages;
+        written_pages = 0;
+        if (page_tracking && written)
         {
-            rom_file.read(reinterpret_cast<char*>(rom_banks[i].data()), ROM_BANK_SIZE);
+            update_page_tables();
         }
+        return written;
+    }
+
+    // 2 pages of vram, then 2 of wram
+    [[nodiscard]] std::span<const uint8_t, MEM_PAGE_SIZE> get_ram_page(size_t index) const
+    {
+        return *ram_pages[index];
+    }
 
-        // Setup RAM banks based on cartridge type
-        setup_ram_banks();
+    [[nodiscard]] std::span<const uint8_t> get_io() const
+    {
+        return io;
+    }
+
+    [[nodiscard]] std::span<const uint8_t> get_hram() const
+    {
+        return hram;
+    }
+
+    // the vram blocks written since the last call, as a bitmask, and clears it
+    [[nodiscard]] std::array<uint64_t, VRAM_BLOCK_COUNT / 64> take_vram_dirty()
+    {
+        const auto dirty = vram_dirty;
+        vram_dirty.fill(0);
+        return dirty;
+    }
+
+    // whether oam was written since the last call, and clears it
+    [[nodiscard]] bool take_oam_dirty()
+    {
+        const bool dirty = oam_dirty;
+        oam_dirty = false;
+        return dirty;
+    }
+
+    // vram is stored in two pages, 0x8000-0x8FFF and 0x9000-0x9FFF
+    [[nodiscard]] const uint8_t* get_vram_page(size_t index) const
+    {
+        return ram_pages[index]->data();
+    }
+
+    [[nodiscard]] const uint8_t* get_oam() const
+    {
+        return oam.data();
     }
 
     // optionally for debugging/testing
     void skip_boot_rom()
     {
+        audio.skip_boot_rom(clock);
         boot_rom_enabled = false;
+        update_page_tables();
     }
 
 private:
-    // ROM banks
-    std::array<uint8_t, ROM_BANK_SIZE> rom_bank0; // Fixed bank 0
-    std::vector<std::array<uint8_t, ROM_BANK_SIZE>> rom_banks; // Switchable banks
-
-    // RAM regions
-    std::vector<std::array<uint8_t, RAM_BANK_SIZE>> ram_banks; // External RAM banks
-    std::array<uint8_t, VRAM_SIZE> vram;
-    std::array<uint8_t, WRAM_SIZE> wram;
-    std::array<uint8_t, OAM_SIZE> oam;
-    std::array<uint8_t, IO_SIZE> io;
-    std::array<uint8_t, HRAM_SIZE> hram;
-    uint8_t ie_register;
+    using page = std::array<uint8_t, MEM_PAGE_SIZE>;
 
-    // Banking control
-    uint8_t current_rom_bank;
-    uint8_t current_ram_bank;
-    bool ram_enabled;
-    bool boot_rom_enabled;
+    struct fork_tag
+    {
+    };
 
-    // Boot ROM (typically 256 bytes)
-    static constexpr std::array<uint8_t, 0x100> boot_rom = dmg_boot;
+    memory_map(memory_map& parent, fork_tag)
+        : cart(parent.cart.fork()),
+          audio(parent.audio.fork()),
+          pad(parent.pad),
+          ram_pages(parent.ram_pages),
+          oam(parent.oam),
+          io(parent.io),
+          hram(parent.hram),
+          ie_register(parent.ie_register),
+          clock(parent.clock),
+          boot_rom_enabled(parent.boot_rom_enabled),
+          owned_pages(0)
+    {
+        parent.owned_pages = 0;
+        update_page_tables();
+        parent.update_page_tables();
+    }
 
-    void handle_banking(uint16_t address, uint8_t value)
+    // index into ram_pages for 0x8000-0x9FFF and 0xC000-0xFDFF
+    static size_t ram_page_index(uint16_t address)
     {
-        // Basic MBC1 implementation
-        if (address <= 0x1FFF)
+        if (address <= VRAM_END)
         {
-            // RAM Enable
-            ram_enabled = ((value & 0x0F) == 0x0A);
+            return (address - VRAM_START) >> MEM_PAGE_SHIFT;
         }
-        else if (address <= 0x3FFF)
+        if (address >= ECHO_START)
         {
-            // ROM Bank Number (low 5 bits)
-            value &= 0x1F;
-            if (value == 0)
-                value = 1; // Bank 0 is not allowed here
-            current_rom_bank = (current_rom_bank & 0x60) | value;
+            address -= ECHO_START - WRAM_START;
         }
-        else if (address <= 0x5FFF)
+        return (VRAM_SIZE >> MEM_PAGE_SHIFT) + ((address - WRAM_START) >> MEM_PAGE_SHIFT);
+    }
+
+    // the copy-on-write fault: a page this map doesn't own is copied before the first write to it. that is the
+    // case even when every other map sharing it has copied it already, the owner bits don't depend on them
+    uint8_t* writable_page(size_t index)
+    {
+        written_pages |= 1 << index;
+        if (!(owned_pages & (1 << index)))
         {
-            // RAM Bank Number or Upper Bits of ROM Bank Number
-            current_ram_bank = value & 0x03;
+            ram_pages[index] = std::make_shared<page>(*ram_pages[index]);
+            owned_pages |= 1 << index;
         }
+
+        if (write_pages[ram_page_slots[index]] == nullptr && is_directly_writable(index))
+        {
+            update_page_tables();
+        }
+        return ram_pages[index]->data();
+    }
+
+    // whether writes to a page can skip the slow path
+    [[nodiscard]] bool is_directly_writable(size_t index) const
+    {
+        return (owned_pages & (1 << index)) && !(video_tracking && index < VRAM_PAGE_COUNT) &&
+               !(page_tracking && !(written_pages & (1 << index)));
+    }
+
+    void mark_video_dirty()
+    {
+        vram_dirty.fill(~uint64_t{0});
+        oam_dirty = true;
     }
 
-    void setup_ram_banks()
+    // points the page tables at the current rom banks and ram pages. anything else stays on the slow path:
+    // the boot rom overlay, mbc registers, eram, the oam/io/hram page, writes to pages that are shared and
+    // tracked vram writes
+    void update_page_tables()
     {
-        // Read cartridge type and RAM size from ROM header
-        uint8_t ram_size = rom_bank0[0x149];
+        read_pages.fill(nullptr);
+        write_pages.fill(nullptr);
 
-        size_t num_ram_banks = 0;
-        switch (ram_size)
+        constexpr size_t pages_per_bank = ROM_BANK_SIZE / MEM_PAGE_SIZE;
+        for (size_t i = 0; i < pages_per_bank; i++)
         {
-            case 0x00:
-                num_ram_banks = 0;
-                break; // No RAM
-            case 0x01:
-                num_ram_banks = 1;
-                break; // 2KB
-            case 0x02:
-                num_ram_banks = 1;
-                break; // 8KB
-            case 0x03:
-                num_ram_banks = 4;
-                break; // 32KB
-            case 0x04:
-                num_ram_banks = 16;
-                break; // 128KB
-            case 0x05:
-                num_ram_banks = 8;
-                break; // 64KB
-            default:
-                std::cerr << "Unsupported RAM size: 0x" << std::hex << (int)ram_size << std::endl;
+            read_pages[(ROM_BANK0_START >> MEM_PAGE_SHIFT) + i] = cart.rom0_window() + i * MEM_PAGE_SIZE;
+            read_pages[(ROM_BANKN_START >> MEM_PAGE_SHIFT) + i] = cart.romx_window() + i * MEM_PAGE_SIZE;
+        }
+        if (boot_rom_enabled)
+        {
+            read_pages[0] = nullptr;
         }
 
-        if (num_ram_banks > 0)
+        for (size_t i = 0; i < RAM_PAGE_COUNT; i++)
         {
-            ram_banks.resize(num_ram_banks, std::array<uint8_t, RAM_BANK_SIZE>{});
-            for (auto& bank : ram_banks)
-            {
-                bank.fill(0);
-            }
+            read_pages[ram_page_slots[i]] = ram_pages[i]->data();
+            write_pages[ram_page_slots[i]] = is_directly_writable(i) ? ram_pages[i]->data() : nullptr;
         }
+
+        // echo ram only gets a full page for 0xE000-0xEFFF, the rest shares its page with oam and io
+        read_pages[ECHO_START >> MEM_PAGE_SHIFT] = read_pages[WRAM_START >> MEM_PAGE_SHIFT];
+        write_pages[ECHO_START >> MEM_PAGE_SHIFT] = write_pages[WRAM_START >> MEM_PAGE_SHIFT];
     }
+
+    // where each of ram_pages sits in the page tables
+    static constexpr std::array<size_t, RAM_PAGE_COUNT> ram_page_slots = {
+        VRAM_START >> MEM_PAGE_SHIFT, (VRAM_START >> MEM_PAGE_SHIFT) + 1,
+        WRAM_START >> MEM_PAGE_SHIFT, (WRAM_START >> MEM_PAGE_SHIFT) + 1};
+
+    // ROM, external RAM and the MBC
+    cartridge cart;
+    apu audio;
+    joypad pad;
+
+    // RAM regions. vram and wram live in refcounted pages, shared between forks until written
+    std::array<std::shared_ptr<page>, RAM_PAGE_COUNT> ram_pages;
+    std::array<uint8_t, OAM_SIZE> oam;
+    std::array<uint8_t, IO_SIZE> io;
+    std::array<uint8_t, HRAM_SIZE> hram;
+    uint8_t ie_register;
+
+    uint64_t clock {0};
+    bool boot_rom_enabled;
+
+    // see set_video_tracking
+    bool video_tracking {false};
+    std::array<uint64_t, VRAM_BLOCK_COUNT / 64> vram_dirty {};
+    bool oam_dirty {false};
+
+    // see set_page_tracking
+    static constexpr uint8_t ALL_RAM_PAGES = (1 << RAM_PAGE_COUNT) - 1;
+    bool page_tracking {false};
+    uint8_t written_pages {ALL_RAM_PAGES};
+
+    // a bit per ram page this map may write in place. forking clears them on both sides
+    uint8_t owned_pages {ALL_RAM_PAGES};
+
+    // indexed by address >> MEM_PAGE_SHIFT, null means the access takes the slow path
+    std::array<const uint8_t*, MEM_PAGE_COUNT> read_pages {};
+    std::array<uint8_t*, MEM_PAGE_COUNT> write_pages {};
+
+    // Boot ROM (typically 256 bytes)
+    static constexpr std::array<uint8_t, 0x100> boot_rom = dmg_boot;
 };
@@ -0,0 +1,146 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+
+size_t gb::metric_histogram::bucket_index(uint64_t value)
+{
+    if (value < 16)
+        return static_cast<size_t>(value);
+    // 8 buckets per power of two, picked by the 3 bits below the highest one
+    const int msb = std::bit_width(value) - 1;
+    const auto sub = static_cast<size_t>((value >> (msb - 3)) & 7);
+    return 16 + static_cast<size_t>(msb - 4) * 8 + sub;
+}
+
+uint64_t gb::metric_histogram::bucket_limit(size_t index)
+{
+    if (index < 16)
+        return index;
+    const size_t msb = (index - 16) / 8 + 4;
+    const uint64_t sub = (index - 16) % 8;
+    const uint64_t width = uint64_t{1} << (msb - 3);
+    return (8 + sub) * width + (width - 1);
+}
+
+uint64_t gb::metric_histogram::percentile(double p) const
+{
+    const uint64_t count = this->count();
+    if (count == 0)
+        return 0;
+
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucket_limit(i), max_.load(std::memory_order_relaxed));
+    }
+    // values recorded while counting
+    return max_.load(std::memory_order_relaxed);
+}
+
+gb::histogram_summary gb::metric_histogram::summary() const
+{
+    histogram_summary s{};
+    s.count = count();
+    s.mean = s.count ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / static_cast<double>(s.count) : 0.0;
+    s.p50 = percentile(0.50);
+    s.p90 = percentile(0.90);
+    s.p99 = percentile(0.99);
+    s.max = max_.load(std::memory_order_relaxed);
+    return s;
+}
+
+gb::metric_counter& gb::metrics_registry::counter(const std::string& name)
+{
+    const std::scoped_lock lock{mutex_};
+    auto& metric = counters_[name];
+    if (!metric)
+        metric = std::make_unique<metric_counter>();
+    return *metric;
+}
+
+gb::metric_histogram& gb::metrics_registry::histogram(const std::string& name)
+{
+    const std::scoped_lock lock{mutex_};
+    auto& metric = histograms_[name];
+    if (!metric)
+        metric = std::make_unique<metric_histogram>();
+    return *metric;
+}
+
+gb::metrics_snapshot gb::metrics_registry::snapshot() const
+{
+    const std::scoped_lock lock{mutex_};
+    metrics_snapshot snapshot;
+    for (const auto& [name, counter] : counters_)
+        snapshot.counters.emplace_back(name, counter->value());
+    for (const auto& [name, histogram] : histograms_)
+        snapshot.histograms.emplace_back(name, histogram->summary());
+    return snapshot;
+}
+
+gb::metrics_reporter::metrics_reporter(const metrics_registry& registry, std::ostream& out,
+                                       std::chrono::milliseconds interval) :
+    registry_(registry),
+    out_(out),
+    interval_(interval),
+    start_(clock_type::now()),
+    last_time_(start_)
+{
+    thread_ = std::thread{[this]
+    {
+        std::unique_lock lock{mutex_};
+        while (!wake_.wait_for(lock, interval_, [this] { return stopping_; }))
+        {
+            lock.unlock();
+            report();
+            lock.lock();
+        }
+    }};
+}
+
+gb::metrics_reporter::~metrics_reporter()
+{
+    {
+        const std::scoped_lock lock{mutex_};
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    report();
+}
+
+void gb::metrics_reporter::report()
+{
+    const metrics_snapshot snapshot = registry_.snapshot();
+
+    const std::scoped_lock lock{report_mutex_};
+    const auto now = clock_type::now();
+    const double since_last = std::chrono::duration<double>(now - last_time_).count();
+    last_time_ = now;
+
+    const std::ios_base::fmtflags flags = out_.flags();
+    const std::streamsize precision = out_.precision();
+    out_ << std::fixed << std::setprecision(3) << "{\"seconds\":"
+         << std::chrono::duration<double>(now - start_).count();
+    for (const auto& [name, total] : snapshot.counters)
+    {
+        uint64_t& last = last_totals_[name];
+        const double rate = since_last > 0.0 ? static_cast<double>(total - last) / since_last : 0.0;
+        last = total;
+        out_ << ",\"" << name << "\":" << total << ",\"" << name << "_per_second\":" << rate;
+    }
+    for (const auto& [name, s] : snapshot.histograms)
+    {
+        out_ << ",\"" << name << "\":{\"count\":" << s.count << ",\"mean\":" << s.mean << ",\"p50\":" << s.p50
+             << ",\"p90\":" << s.p90 << ",\"p99\":" << s.p99 << ",\"max\":" << s.max << '}';
+    }
+    out_ << '}' << std::endl;
+    out_.flags(flags);
+    out_.precision(precision);
+}
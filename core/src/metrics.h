@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gb
+{
+    class metric_counter;
+    class metric_histogram;
+    class metrics_registry;
+    class metrics_reporter;
+
+    struct histogram_summary
+    {
+        uint64_t count;
+        double mean;
+        uint64_t p50, p90, p99; // upper bounds of the buckets the percentiles fall into
+        uint64_t max;
+    };
+
+    // the values of every metric at one point in time
+    struct metrics_snapshot
+    {
+        std::vector<std::pair<std::string, uint64_t>> counters; // by name
+        std::vector<std::pair<std::string, histogram_summary>> histograms;
+    };
+}
+
+// a total that only goes up. adding is one relaxed atomic addition, from any thread
+class gb::metric_counter
+{
+public:
+    void add(uint64_t n = 1)
+    {
+        value_.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_ {0};
+};
+
+// distribution of a value, in buckets an 8th of a power of two wide: exact below 16, within 12.5% from there.
+// recording is a few relaxed atomic operations and takes no lock, from any thread
+class gb::metric_histogram
+{
+public:
+    static constexpr size_t BUCKET_COUNT = 62 * 8;
+
+    void record(uint64_t value)
+    {
+        buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    [[nodiscard]] uint64_t count() const
+    {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    // the upper bound of the bucket the pth (0-1) percentile falls into, 0 if nothing was recorded
+    [[nodiscard]] uint64_t percentile(double p) const;
+
+    [[nodiscard]] histogram_summary summary() const;
+
+    static size_t bucket_index(uint64_t value);
+
+    // the largest value in a bucket
+    static uint64_t bucket_limit(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_ {};
+    std::atomic<uint64_t> count_ {0};
+    std::atomic<uint64_t> sum_ {0};
+    std::atomic<uint64_t> max_ {0};
+};
+
+// named counters and histograms, for watching long runs: how fast the emulation goes, how long frames take.
+// looking a metric up takes a lock, so callers look theirs up once and keep the reference, which stays valid for
+// as long as the registry lives. updating the metric takes no lock
+class gb::metrics_registry
+{
+public:
+    metrics_registry() = default;
+    metrics_registry(const metrics_registry&) = delete;
+    metrics_registry& operator=(const metrics_registry&) = delete;
+
+    // the counter called name, created on first use
+    metric_counter& counter(const std::string& name);
+
+    metric_histogram& histogram(const std::string& name);
+
+    [[nodiscard]] metrics_snapshot snapshot() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<metric_counter>> counters_;
+    std::map<std::string, std::unique_ptr<metric_histogram>> histograms_;
+};
+
+// writes a registry's metrics as one json object per line, every interval from a thread of its own and once more
+// when destroyed: "seconds" since the reporter started, every counter's total and its rate since the last line as
+// "<name>_per_second", and every histogram's count, mean, p50, p90, p99 and max
+class gb::metrics_reporter
+{
+public:
+    metrics_reporter(const metrics_registry& registry, std::ostream& out, std::chrono::milliseconds interval);
+    ~metrics_reporter();
+
+    metrics_reporter(const metrics_reporter&) = delete;
+    metrics_reporter& operator=(const metrics_reporter&) = delete;
+
+    // one line now, also what the thread does every interval
+    void report();
+
+private:
+    using clock_type = std::chrono::steady_clock;
+
+    const metrics_registry& registry_;
+    std::ostream& out_;
+    const std::chrono::milliseconds interval_;
+    const clock_type::time_point start_;
+
+    // the previous line's totals and time, for the rates
+    std::mutex report_mutex_;
+    std::map<std::string, uint64_t> last_totals_;
+    clock_type::time_point last_time_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
@@ -1,15 +1,211 @@
 #include "ppu.h"
 
+#include "hash.h"
+#include "host_trace.h"
+#include "ppu_thread.h"
+
+#include <algorithm>
+#include <cstring>
+
 // this is a class similar to a renderer in a game engine. it doesn't actually manage the "os window"
 gb::ppu::ppu()
 {
 
 }
 
+gb::ppu::~ppu() = default;
+
+gb::ppu::ppu(const ppu& other) :
+    cyclecounter_(other.cyclecounter_),
+    currentline_(other.currentline_),
+    mode_(other.mode_),
+    frame_count_(other.frame_count_),
+    lcd_off_cycles_(other.lcd_off_cycles_),
+    renderer_(other.renderer_),
+    fifo_(other.fifo_),
+    window_line_(other.window_line_),
+    window_y_reached_(other.window_y_reached_),
+    drawing_cycles_(other.drawing_cycles_),
+    render_policy_(other.render_policy_),
+    render_interval_(other.render_interval_),
+    rendering_(other.rendering_)
+{
+    other.finish_rendering();
+    screen_ = other.screen_;
+}
+
+gb::ppu& gb::ppu::operator=(const ppu& other)
+{
+    if (this == &other)
+        return *this;
+
+    other.finish_rendering();
+    finish_rendering();
+    cyclecounter_ = other.cyclecounter_;
+    currentline_ = other.currentline_;
+    mode_ = other.mode_;
+    frame_count_ = other.frame_count_;
+    lcd_off_cycles_ = other.lcd_off_cycles_;
+    renderer_ = other.renderer_;
+    fifo_ = other.fifo_;
+    window_line_ = other.window_line_;
+    window_y_reached_ = other.window_y_reached_;
+    drawing_cycles_ = other.drawing_cycles_;
+    render_policy_ = other.render_policy_;
+    render_interval_ = other.render_interval_;
+    rendering_ = other.rendering_;
+    screen_ = other.screen_;
+    screen_.mark_all_changed();
+    return *this;
+}
+
+void gb::ppu::set_threaded(bool threaded, memory_map& mem)
+{
+    if (threaded == is_threaded())
+        return;
+
+    // the thread finishes whatever was submitted before it goes away
+    thread_.reset();
+    if (threaded)
+        thread_ = std::make_unique<ppu_thread>(screen_);
+    mem.set_video_tracking(threaded);
+}
+
+void gb::ppu::set_renderer(ppu_renderer renderer)
+{
+    // lines the thread still has queued would land on top of the fifo's
+    finish_rendering();
+    renderer_ = renderer;
+}
+
+std::span<const uint8_t> gb::ppu::get_shades() const
+{
+    return screen_.shades;
+}
+
+void gb::ppu::get_framebuffer(std::span<uint32_t, FRAMEBUFFER_SIZE> out) const
+{
+    expand_shades(screen_.shades, out.data());
+}
+
+uint64_t gb::ppu::get_frame_hash()
+{
+    finish_rendering();
+    for (size_t line = 0; line < SCREEN_HEIGHT; line++)
+    {
+        if (screen_.unhashed[line / 64] & (uint64_t{1} << (line % 64)))
+            screen_.line_hashes[line] = hash_bytes(&screen_.shades[line * PACKED_LINE_SIZE], PACKED_LINE_SIZE);
+    }
+    screen_.unhashed.fill(0);
+    return hash_bytes(screen_.line_hashes.data(), sizeof(screen_.line_hashes));
+}
+
+void gb::ppu::set_frame_output(triple_buffer<frame>* output)
+{
+    finish_rendering();
+    output_ = output;
+    // whoever reads the new output starts out with nothing
+    screen_.mark_all_changed();
+}
+
+void gb::ppu::set_render_policy(ppu_render_policy policy, uint32_t interval)
+{
+    render_policy_ = policy;
+    render_interval_ = std::max<uint32_t>(interval, 1);
+    update_rendering();
+}
+
+void gb::ppu::update_rendering()
+{
+    switch (render_policy_)
+    {
+    case ppu_render_policy::all:
+        rendering_ = true;
+        break;
+    case ppu_render_policy::every_nth:
+        rendering_ = (frame_count_ + 1) % render_interval_ == 0;
+        break;
+    case ppu_render_policy::none:
+        rendering_ = false;
+        break;
+    }
+}
+
+void gb::ppu::present(const ppu& ahead)
+{
+    ahead.finish_rendering();
+    finish_rendering();
+    // ahead started out with this screen, so what it marked changed is relative to the last frame shown
+    screen_ = ahead.screen_;
+    if (output_)
+        screen_.publish(*output_);
+}
+
+void gb::ppu::finish_rendering() const
+{
+    if (thread_)
+        thread_->finish();
+}
+
+void gb::ppu::save(state_writer& out, uint16_t flags) const
+{
+    out.write(cyclecounter_);
+    out.write(currentline_);
+    out.write(mode_);
+    out.write(frame_count_);
+    out.write(lcd_off_cycles_);
+    out.write(fifo_);
+    out.write(window_line_);
+    out.write(window_y_reached_);
+    out.write(drawing_cycles_);
+    if (flags & STATE_FRAMEBUFFER)
+    {
+        finish_rendering();
+        out.write(screen_.shades);
+    }
+}
+
+void gb::ppu::load(state_reader& in, uint16_t flags)
+{
+    in.read(cyclecounter_);
+    in.read(currentline_);
+    in.read(mode_);
+    in.read(frame_count_);
+    in.read(lcd_off_cycles_);
+    in.read(fifo_);
+    in.read(window_line_);
+    in.read(window_y_reached_);
+    in.read(drawing_cycles_);
+    if (flags & STATE_FRAMEBUFFER)
+    {
+        // lines still queued would land on top of the restored framebuffer
+        finish_rendering();
+        in.read(screen_.shades);
+        screen_.mark_all_changed();
+    }
+}
+
 void gb::ppu::tick(uint32_t cycles, memory_map& mem)
 {
+    GB_TRACE_TOTAL(trace_total::ppu_tick);
     if (!is_lcd_enabled(mem.read(LCDC_ADDR)))
+    {
+        // nothing is drawn with the lcd off, but frames keep their pace for whoever drives the emulator
+        lcd_off_cycles_ += cycles;
+        if (lcd_off_cycles_ >= CYCLES_FRAME)
+        {
+            lcd_off_cycles_ -= CYCLES_FRAME;
+            frame_count_++;
+            update_rendering();
+        }
         return;
+    }
+
+    if (renderer_ == ppu_renderer::fifo)
+    {
+        tick_fifo(cycles, mem);
+        return;
+    }
 
     cyclecounter_ += cycles;
 
@@ -25,11 +221,16 @@ void gb::ppu::tick(uint32_t cycles, memory_map& mem)
 
         if (currentline_ < 144)
         {
-            render_scanline(mem);
+            if (rendering_)
+                render_scanline(mem);
         }
         else if (currentline_ == 144)
         {
             mode_ = ppu_mode::VBlank;
+            frame_count_++;
+            if (output_ && rendering_)
+                publish_frame();
+            update_rendering();
             //mem.request_interrupt(0x01); // Request VBlank interrupt
         }
     }
@@ -37,27 +238,149 @@ void gb::ppu::tick(uint32_t cycles, memory_map& mem)
     update_mode(mem);
 }
 
+void gb::ppu::publish_frame()
+{
+    if (thread_)
+    {
+        thread_->publish(*output_);
+        return;
+    }
+
+    screen_.publish(*output_);
+}
+
 void gb::ppu::render_scanline(memory_map& mem)
 {
-    const uint8_t lcdc = mem.read(LCDC_ADDR);
-
-    if (is_bg_enabled(lcdc))
-        render_background(mem, currentline_);
-    if (is_window_enabled(lcdc))
-        render_window(mem, currentline_);
-    if (is_sprites_enabled(lcdc))
-        render_sprites(mem, currentline_);
+    GB_TRACE_SCOPE("ppu::render_scanline");
+    const scanline_registers regs = read_registers(mem);
+
+    if (thread_)
+    {
+        thread_->submit(currentline_, regs, mem);
+        return;
+    }
+
+    const video_memory video{{mem.get_vram_page(0), mem.get_vram_page(1)}, mem.get_oam()};
+    render_line(regs, video, currentline_, screen_);
+}
+
+void gb::ppu::render_line(const scanline_registers& regs, const video_memory& video, int scanline, screen& out)
+{
+    // drawn a byte per pixel and packed once at the end
+    uint8_t line[SCREEN_WIDTH];
+    const uint8_t* packed = &out.shades[scanline * PACKED_LINE_SIZE];
+
+    // without the background, whatever the line had before shows through
+    if (is_bg_enabled(regs.lcdc))
+        render_background(regs, video, scanline, line);
+    else
+        unpack_line(packed, line);
+    if (is_window_enabled(regs.lcdc))
+        render_window(regs, video, scanline, line);
+    if (is_sprites_enabled(regs.lcdc))
+        render_sprites(regs, video, scanline, line);
+
+    out.store_line(scanline, line);
+}
+
+void gb::ppu::screen::store_line(int scanline, const uint8_t* pixels)
+{
+    uint8_t packed[PACKED_LINE_SIZE];
+    for (size_t i = 0; i < PACKED_LINE_SIZE; i++)
+    {
+        const uint8_t* four = pixels + i * 4;
+        packed[i] = four[0] | (four[1] << 2) | (four[2] << 4) | (four[3] << 6);
+    }
+
+    uint8_t* line = &shades[scanline * PACKED_LINE_SIZE];
+    if (std::memcmp(line, packed, PACKED_LINE_SIZE) == 0)
+        return;
+
+    std::memcpy(line, packed, PACKED_LINE_SIZE);
+    const uint64_t bit = uint64_t{1} << (scanline % 64);
+    changed[scanline / 64] |= bit;
+    unhashed[scanline / 64] |= bit;
 }
 
-void gb::ppu::render_background(memory_map& mem, int scanline)
+void gb::ppu::screen::publish(triple_buffer<frame>& output)
 {
-    const uint8_t lcdc = mem.read(LCDC_ADDR);
-    const uint8_t scx = mem.read(SCX_ADDR);
-    const uint8_t scy = mem.read(SCY_ADDR);
+    // the reader never got the previous frame, so it still needs that frame's lines as well. if it picks the
+    // previous frame up right after this check, it just gets a few lines more than it needed
+    if (output.has_unread())
+    {
+        for (size_t i = 0; i < changed.size(); i++)
+            changed[i] |= published[i];
+    }
+
+    frame& out = output.write_buffer();
+    out.shades = shades;
+    out.changed = changed;
+    output.publish();
+
+    published = changed;
+    changed.fill(0);
+}
+
+void gb::ppu::screen::mark_all_changed()
+{
+    changed = ALL_LINES;
+    published = ALL_LINES;
+    unhashed = ALL_LINES;
+}
+
+void gb::ppu::unpack_line(const uint8_t* packed, uint8_t* line)
+{
+    for (size_t i = 0; i < PACKED_LINE_SIZE; i++)
+    {
+        for (int pixel = 0; pixel < 4; pixel++)
+            line[i * 4 + pixel] = (packed[i] >> (pixel * 2)) & 0x03;
+    }
+}
+
+namespace
+{
+    // the colors of the 4 pixels in every possible packed byte
+    constexpr auto SHADE_LUT = []
+    {
+        std::array<std::array<uint32_t, 4>, 256> lut{};
+        for (size_t byte = 0; byte < lut.size(); byte++)
+        {
+            for (size_t pixel = 0; pixel < 4; pixel++)
+                lut[byte][pixel] = gb::ppu::SHADE_COLORS[(byte >> (pixel * 2)) & 0x03];
+        }
+        return lut;
+    }();
+}
+
+void gb::ppu::expand_shades(std::span<const uint8_t> shades, uint32_t* colors)
+{
+    for (size_t i = 0; i < shades.size(); i++)
+        std::memcpy(colors + i * 4, SHADE_LUT[shades[i]].data(), sizeof(SHADE_LUT[0]));
+}
+
+gb::scanline_registers gb::ppu::read_registers(const memory_map& mem)
+{
+    scanline_registers regs{};
+    regs.lcdc = mem.read(LCDC_ADDR);
+    regs.scx = mem.read(SCX_ADDR);
+    regs.scy = mem.read(SCY_ADDR);
+    regs.wx = mem.read(WX_ADDR);
+    regs.wy = mem.read(WY_ADDR);
+    regs.bgp = mem.read(BGP_ADDR);
+    regs.obp0 = mem.read(OBP0_ADDR);
+    regs.obp1 = mem.read(OBP1_ADDR);
+    return regs;
+}
+
+void gb::ppu::render_background(const scanline_registers& regs, const video_memory& video, int scanline, uint8_t* pixels)
+{
+    const uint8_t lcdc = regs.lcdc;
+    const uint8_t scx = regs.scx;
+    const uint8_t scy = regs.scy;
     const uint16_t tile_map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
     const uint16_t tile_data = (lcdc & 0x10) ? 0x8000 : 0x8800;
     const bool signed_addressing = !(lcdc & 0x10);
-    const uint8_t bg_palette = mem.read(BGP_ADDR);
+    const uint8_t bg_palette = regs.bgp;
 
     const uint8_t y = (scanline + scy) & 255;
     const uint8_t tile_row = y / 8;
@@ -68,34 +391,34 @@ void gb::ppu::render_background(memory_map& mem, int scanline)
         const uint8_t tile_col = mapped_x / 8;
         const uint16_t tile_addr = tile_map + tile_row * 32 + tile_col;
 
-        uint8_t tile_id = mem.read(tile_addr);
+        uint8_t tile_id = video.read_vram(tile_addr);
         if (signed_addressing)
             tile_id = static_cast<int8_t>(tile_id) + 128;
 
         const uint16_t tile_location = tile_data + tile_id * 16;
         const uint8_t line = (y % 8) * 2;
-        const uint8_t byte1 = mem.read(tile_location + line);
-        const uint8_t byte2 = mem.read(tile_location + line + 1);
+        const uint8_t byte1 = video.read_vram(tile_location + line);
+        const uint8_t byte2 = video.read_vram(tile_location + line + 1);
 
         const int bit_num = 7 - (mapped_x % 8);
         const uint8_t color_id = ((byte1 >> bit_num) & 1) | (((byte2 >> bit_num) & 1) << 1);
 
-        framebuffer_[scanline * SCREEN_WIDTH + x] = get_color(color_id, bg_palette);
+        pixels[x] = get_shade(color_id, bg_palette);
     }
 }
 
-void gb::ppu::render_window(memory_map& mem, int scanline)
+void gb::ppu::render_window(const scanline_registers& regs, const video_memory& video, int scanline, uint8_t* pixels)
 {
-    const uint8_t wy = mem.read(WY_ADDR);
+    const uint8_t wy = regs.wy;
     if (scanline < wy)
         return;
 
-    const uint8_t wx = mem.read(WX_ADDR);
-    const uint8_t lcdc = mem.read(LCDC_ADDR);
+    const uint8_t wx = regs.wx;
+    const uint8_t lcdc = regs.lcdc;
     const uint16_t tile_map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
     const uint16_t tile_data = (lcdc & 0x10) ? 0x8000 : 0x8800;
     const bool signed_addressing = !(lcdc & 0x10);
-    const uint8_t bg_palette = mem.read(BGP_ADDR);
+    const uint8_t bg_palette = regs.bgp;
 
     const uint8_t window_line = (uint8_t)(scanline - wy);
     const uint8_t tile_row = window_line / 8;
@@ -108,27 +431,27 @@ void gb::ppu::render_window(memory_map& mem, int scanline)
         const uint8_t tile_col = (uint8_t)(x / 8);
         const uint16_t tile_addr = tile_map + tile_row * 32 + tile_col;
 
-        uint8_t tile_id = mem.read(tile_addr);
+        uint8_t tile_id = video.read_vram(tile_addr);
         if (signed_addressing)
             tile_id = static_cast<int8_t>(tile_id) + 128;
 
         const uint16_t tile_location = tile_data + tile_id * 16;
         const uint8_t line = (window_line % 8) * 2;
-        const uint8_t byte1 = mem.read(tile_location + line);
-        const uint8_t byte2 = mem.read(tile_location + line + 1);
+        const uint8_t byte1 = video.read_vram(tile_location + line);
+        const uint8_t byte2 = video.read_vram(tile_location + line + 1);
 
         const int bit_num = 7 - (x % 8);
         const uint8_t color_id = ((byte1 >> bit_num) & 1) | (((byte2 >> bit_num) & 1) << 1);
 
         const int screen_x = x + wx - 7;
         if (screen_x >= 0 && screen_x < SCREEN_WIDTH)
-            framebuffer_[scanline * SCREEN_WIDTH + screen_x] = get_color(color_id, bg_palette);
+            pixels[screen_x] = get_shade(color_id, bg_palette);
     }
 }
 
-void gb::ppu::render_sprites(memory_map& mem, int scanline)
+void gb::ppu::render_sprites(const scanline_registers& regs, const video_memory& video, int scanline, uint8_t* pixels)
 {
-    const uint8_t lcdc = mem.read(LCDC_ADDR);
+    const uint8_t lcdc = regs.lcdc;
     const bool tall_sprites = lcdc & 0x04;
     const int sprite_height = tall_sprites ? 16 : 8;
 
@@ -144,10 +467,10 @@ void gb::ppu::render_sprites(memory_map& mem, int scanline)
     for (uint8_t i = 0; i < 40; i++)
     {
         const uint16_t sprite_addr = 0xFE00 + i * 4;
-        sprites[i].y = mem.read(sprite_addr) - 16;
-        sprites[i].x = mem.read(sprite_addr + 1) - 8;
-        sprites[i].tile = mem.read(sprite_addr + 2);
-        sprites[i].attributes = mem.read(sprite_addr + 3);
+        sprites[i].y = video.read_oam(sprite_addr) - 16;
+        sprites[i].x = video.read_oam(sprite_addr + 1) - 8;
+        sprites[i].tile = video.read_oam(sprite_addr + 2);
+        sprites[i].attributes = video.read_oam(sprite_addr + 3);
     }
 
     int sprites_on_line = 0;
@@ -163,15 +486,15 @@ void gb::ppu::render_sprites(memory_map& mem, int scanline)
 
         const bool flip_y = sprite.attributes & 0x40;
         const bool flip_x = sprite.attributes & 0x20;
-        const uint8_t palette = sprite.attributes & 0x10 ? mem.read(OBP1_ADDR) : mem.read(OBP0_ADDR);
+        const uint8_t palette = sprite.attributes & 0x10 ? regs.obp1 : regs.obp0;
 
         uint8_t line = (uint8_t)scanline - sprite.y;
         if (flip_y)
             line = (uint8_t)sprite_height - 1 - line;
 
         const uint16_t tile_addr = 0x8000 + sprite.tile * 16 + (line * 2);
-        const uint8_t byte1 = mem.read(tile_addr);
-        const uint8_t byte2 = mem.read(tile_addr + 1);
+        const uint8_t byte1 = video.read_vram(tile_addr);
+        const uint8_t byte2 = video.read_vram(tile_addr + 1);
 
         for (int x = 0; x < 8; x++)
         {
@@ -184,7 +507,7 @@ void gb::ppu::render_sprites(memory_map& mem, int scanline)
             if (color_id == 0) // Transparent pixel
                 continue;
 
-            framebuffer_[scanline * SCREEN_WIDTH + sprite.x + x] = get_color(color_id, palette);
+            pixels[sprite.x + x] = get_shade(color_id, palette);
         }
     }
 }
@@ -239,21 +562,7 @@ void gb::ppu::update_mode(memory_map& mem)
     mem.write(STAT_ADDR, stat);
 }
 
-uint32_t gb::ppu::get_color(uint8_t color_id, uint8_t palette) const
+uint8_t gb::ppu::get_shade(uint8_t color_id, uint8_t palette)
 {
-    const uint8_t shade = (palette >> (color_id * 2)) & 0x03;
-
-    switch (shade)
-    {
-        case 0:
-            return 0xFFFFFFFF; // White
-        case 1:
-            return 0xFFAAAAAA; // Light gray
-        case 2:
-            return 0xFF555555; // Dark gray
-        case 3:
-            return 0xFF000000; // Black
-        default:
-            return 0xFFFFFFFF;
-    }
+    return (palette >> (color_id * 2)) & 0x03;
 }
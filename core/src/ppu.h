@@ -1,10 +1,49 @@
 #pragma once
 
 #include "memory_map.h"
+#include "save_state.h"
+#include "triple_buffer.h"
+
+#include <array>
+#include <memory>
+#include <span>
+#include <type_traits>
 
 namespace gb
 {
     class ppu;
+    class ppu_thread;
+
+    // the registers a scanline is rendered from, as they were at the start of the line
+    struct scanline_registers
+    {
+        uint8_t lcdc;
+        uint8_t scx;
+        uint8_t scy;
+        uint8_t wx;
+        uint8_t wy;
+        uint8_t bgp;
+        uint8_t obp0;
+        uint8_t obp1;
+    };
+
+    // the parts of memory a scanline is rendered from, either the live memory_map or a renderer's own copy
+    struct video_memory
+    {
+        std::array<const uint8_t*, VRAM_PAGE_COUNT> vram; // 0x8000-0x8FFF, 0x9000-0x9FFF
+        const uint8_t* oam;
+
+        [[nodiscard]] uint8_t read_vram(uint16_t address) const
+        {
+            const uint16_t offset = address - VRAM_START;
+            return vram[offset >> MEM_PAGE_SHIFT][offset & MEM_PAGE_MASK];
+        }
+
+        [[nodiscard]] uint8_t read_oam(uint16_t address) const
+        {
+            return oam[address - OAM_START];
+        }
+    };
 }
 
 enum class ppu_mode
@@ -15,20 +54,25 @@ enum class ppu_mode
     Drawing // Pixel transfer
 };
 
-class gb::ppu
+enum class ppu_renderer
 {
-public:
-    ppu();
-    ~ppu() = default;
+    scanline, // draws each line at once from the registers at its start, fast
+    fifo // draws a dot at a time through the pixel fifos like the hardware, for mid-line effects and timing
+};
 
-    void tick(uint32_t cycles, memory_map& mem);
+enum class ppu_render_policy
+{
+    all, // every frame is drawn, the default
+    every_nth, // one frame in every interval is drawn, for fast-forwarding
+    none // nothing is drawn, for headless runs that only care about what the program does
+};
 
-    [[nodiscard]] const uint32_t* get_framebuffer() const
-    {
-        return framebuffer_;
-    }
+class gb::ppu
+{
+public:
+    // a bit per line, line 0 in the lowest bit of the first word
+    using line_mask = std::array<uint64_t, 3>;
 
-private:
     static constexpr int SCREEN_WIDTH = 160;
     static constexpr int SCREEN_HEIGHT = 144;
     static constexpr uint32_t CYCLES_OAM = 80;
@@ -36,6 +80,151 @@ private:
     static constexpr uint32_t CYCLES_HBLANK = 204;
     static constexpr uint32_t CYCLES_LINE = 456;
     static constexpr uint8_t TOTAL_LINES = 154;
+    static constexpr uint32_t CYCLES_FRAME = CYCLES_LINE * TOTAL_LINES;
+    static constexpr size_t FRAMEBUFFER_SIZE = SCREEN_WIDTH * SCREEN_HEIGHT; // in pixels
+    static constexpr size_t PACKED_LINE_SIZE = SCREEN_WIDTH / 4; // in bytes
+    static constexpr size_t PACKED_FRAME_SIZE = PACKED_LINE_SIZE * SCREEN_HEIGHT;
+
+    // white, light gray, dark gray, black
+    static constexpr std::array<uint32_t, 4> SHADE_COLORS = {0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000};
+
+    static_assert(SCREEN_HEIGHT > 128 && SCREEN_HEIGHT <= 64 * std::tuple_size_v<line_mask>);
+
+    // a published frame
+    struct frame
+    {
+        std::array<uint8_t, PACKED_FRAME_SIZE> shades; // like get_shades
+        // lines that differ from the frame the reader picked up before this one. frames the reader skipped are
+        // accounted for, so uploading only these lines keeps a copy of the screen up to date
+        line_mask changed;
+    };
+
+    static constexpr line_mask ALL_LINES = {~0ull, ~0ull, (1ull << (SCREEN_HEIGHT - 128)) - 1};
+
+    struct screen
+    {
+        std::array<uint8_t, PACKED_FRAME_SIZE> shades {};
+        line_mask changed {ALL_LINES}; // since the last publish
+        line_mask published {ALL_LINES}; // changed of the last published frame
+        line_mask unhashed {ALL_LINES}; // lines whose line_hashes entry is out of date
+        std::array<uint64_t, SCREEN_HEIGHT> line_hashes {};
+
+        // packs a line of one shade per pixel into shades, marking it if it's different from what was there
+        void store_line(int scanline, const uint8_t* pixels);
+
+        void publish(triple_buffer<frame>& output);
+
+        void mark_all_changed();
+    };
+
+    ppu();
+    ~ppu();
+
+    /** copies render inline, whatever the original does. a copy keeps the original's changed lines, so a fork's
+     * screen can be presented (see present). assigning marks every line changed instead, the screen it replaces
+     * has nothing to do with the new one
+     */
+    ppu(const ppu& other);
+    ppu& operator=(const ppu& other);
+
+    void tick(uint32_t cycles, memory_map& mem);
+
+    /** switches how lines are drawn, takes effect from the next cycle. the scanline renderer is the default.
+     * the fifo renderer reads registers and memory while it draws, so it always draws inline, even when threaded
+     */
+    void set_renderer(ppu_renderer renderer);
+
+    [[nodiscard]] ppu_renderer get_renderer() const
+    {
+        return renderer_;
+    }
+
+    /** which frames are drawn, from the next line on. every_nth draws the frames whose number (see
+     * get_frame_count, once the frame is done) is a multiple of interval. frames that aren't drawn aren't published
+     * and the screen keeps whatever was drawn last. LY, STAT and frame timing stay exactly the same: the scanline
+     * renderer just skips drawing lines, the fifo renderer still steps through every dot of mode 3, whose length
+     * depends on what's drawn, and only skips storing the pixels
+     */
+    void set_render_policy(ppu_render_policy policy, uint32_t interval = 1);
+
+    [[nodiscard]] ppu_render_policy get_render_policy() const
+    {
+        return render_policy_;
+    }
+
+    // whether the frame in progress is being drawn
+    [[nodiscard]] bool is_rendering() const
+    {
+        return rendering_;
+    }
+
+    /** publishes every completed frame to output when the ppu enters vblank, for a presenter on another thread
+     * that shouldn't read the framebuffer while it's being drawn. when threaded, the renderer thread publishes
+     * once it drew the last line. output has to outlive this, null stops publishing. copies don't publish
+     */
+    void set_frame_output(triple_buffer<frame>* output);
+
+    /** takes over the screen of ahead, a copy of this ppu that ran further, and publishes it if there's a frame
+     * output. for run-ahead (see run_ahead.h), which shows frames of a copy that's thrown away after
+     */
+    void present(const ppu& ahead);
+
+    /** # of cycles the last visible line spent drawing (mode 3). the fifo renderer's depends on the fine scroll,
+     * the window and the sprites on the line, the scanline renderer's is always 172
+     */
+    [[nodiscard]] uint32_t get_drawing_cycles() const
+    {
+        return drawing_cycles_;
+    }
+
+    /** moves scanline rendering to a thread of its own (see ppu_thread.h), or back inline. the output is
+     * identical either way. while threaded, the framebuffer lags behind emulation and may be mid-update when read,
+     * call finish_rendering() before reading it for anything that needs an exact frame.
+     * mem has to be the memory_map passed to tick(), its vram/oam write tracking is switched along with this
+     */
+    void set_threaded(bool threaded, memory_map& mem);
+
+    [[nodiscard]] bool is_threaded() const
+    {
+        return thread_ != nullptr;
+    }
+
+    // blocks until every line emulated so far is in the framebuffer. a no-op when rendering inline
+    void finish_rendering() const;
+
+    /** renders one line of shades (see get_shades) from the registers and memory as they were at the start of the
+     * line. shared by inline and threaded rendering, so both produce the same output
+     */
+    static void render_line(const scanline_registers& regs, const video_memory& video, int scanline, screen& out);
+
+    /** the screen as 2 bit shades, 4 pixels to a byte with the leftmost pixel in the low bits, PACKED_LINE_SIZE
+     * bytes per line. this is what the ppu draws and publishes, colors are only applied when someone asks for them
+     */
+    [[nodiscard]] std::span<const uint8_t> get_shades() const;
+
+    /** hash_bytes of the hashes of every line of get_shades(). line hashes are kept between calls and only lines
+     * that changed are hashed again, which makes hashing a mostly static screen every frame cheap.
+     * waits for rendering like finish_rendering()
+     */
+    [[nodiscard]] uint64_t get_frame_hash();
+
+    // the screen in SHADE_COLORS, expanded from the shades into out
+    void get_framebuffer(std::span<uint32_t, FRAMEBUFFER_SIZE> out) const;
+
+    // one color per pixel of packed shades
+    static void expand_shades(std::span<const uint8_t> shades, uint32_t* colors);
+
+    // incremented every time the ppu enters vblank, or every frame's worth of cycles while the lcd is off
+    [[nodiscard]] uint64_t get_frame_count() const
+    {
+        return frame_count_;
+    }
+
+    // line and mode counters, the fifo renderer's progress, plus the framebuffer if flags has STATE_FRAMEBUFFER. see save_state.h
+    void save(state_writer& out, uint16_t flags) const;
+    void load(state_reader& in, uint16_t flags);
+
+private:
 
     // LCD registers addresses
     static constexpr uint16_t LCDC_ADDR = 0xFF40;
@@ -53,33 +242,120 @@ private:
     uint32_t cyclecounter_ {0};
     uint8_t currentline_ {0};
     ppu_mode mode_ {ppu_mode::OAM};
-    uint32_t framebuffer_[SCREEN_WIDTH * SCREEN_HEIGHT]{};
+    uint64_t frame_count_ {0};
+    uint32_t lcd_off_cycles_ {0};
+
+    // null while rendering inline
+    std::unique_ptr<ppu_thread> thread_;
 
     void render_scanline(memory_map& mem);
-    void render_background(memory_map& mem, int scanline);
-    void render_window(memory_map& mem, int scanline);
-    void render_sprites(memory_map& mem, int scanline);
+    static void render_background(const scanline_registers& regs, const video_memory& video, int scanline,
+                                  uint8_t* pixels);
+    static void render_window(const scanline_registers& regs, const video_memory& video, int scanline,
+                              uint8_t* pixels);
+    static void render_sprites(const scanline_registers& regs, const video_memory& video, int scanline,
+                               uint8_t* pixels);
     void update_mode(memory_map& mem);
 
-    [[nodiscard]] uint32_t get_color(uint8_t color_id, uint8_t palette) const;
+    // the fifo renderer, see ppu_fifo.cpp
+    void tick_fifo(uint32_t cycles, memory_map& mem);
+    void next_line_fifo(memory_map& mem);
+    void start_drawing(const memory_map& mem, const video_memory& video);
+    [[nodiscard]] bool step_fifo(const memory_map& mem, const video_memory& video);
+    void step_fetcher(uint8_t lcdc, const memory_map& mem, const video_memory& video);
+    void fetch_sprite(uint8_t lcdc, const video_memory& video);
+
+    [[nodiscard]] static scanline_registers read_registers(const memory_map& mem);
 
-    [[nodiscard]] bool is_lcd_enabled(uint8_t lcdc) const
+    static void unpack_line(const uint8_t* packed, uint8_t* line);
+
+    [[nodiscard]] static uint8_t get_shade(uint8_t color_id, uint8_t palette);
+
+    [[nodiscard]] static bool is_lcd_enabled(uint8_t lcdc)
     {
         return lcdc & 0x80;
     }
 
-    [[nodiscard]] bool is_window_enabled(uint8_t lcdc) const
+    [[nodiscard]] static bool is_window_enabled(uint8_t lcdc)
     {
         return lcdc & 0x20;
     }
 
-    [[nodiscard]] bool is_sprites_enabled(uint8_t lcdc) const
+    [[nodiscard]] static bool is_sprites_enabled(uint8_t lcdc)
     {
         return lcdc & 0x02;
     }
 
-    [[nodiscard]] bool is_bg_enabled(uint8_t lcdc) const
+    [[nodiscard]] static bool is_bg_enabled(uint8_t lcdc)
     {
         return lcdc & 0x01;
     }
+
+    screen screen_;
+    triple_buffer<frame>* output_ {nullptr};
+
+    // the fifo renderer's progress through the line being drawn. no padding, so save states stay byte exact
+    struct fifo_state
+    {
+        struct sprite
+        {
+            uint8_t y;
+            uint8_t x;
+            uint8_t tile;
+            uint8_t attributes;
+            bool fetched;
+        };
+
+        struct sprite_pixel
+        {
+            uint8_t color_id; // 0 is transparent
+            uint8_t attributes; // of the sprite it came from, for the palette and the background priority
+        };
+
+        uint16_t cycles; // spent drawing this line
+        std::array<uint8_t, SCREEN_WIDTH> pixels; // shades drawn so far
+        uint8_t x; // # of pixels drawn
+        uint8_t discard; // pixels still to drop from the background fifo, for the fine scroll
+
+        // background fifo, 8 pixels at most and only refilled when empty, as two bit planes shifted out the top
+        uint8_t bg_low;
+        uint8_t bg_high;
+        uint8_t bg_count;
+
+        std::array<sprite_pixel, 8> sprite_fifo;
+        uint8_t sprite_fifo_count;
+
+        // background/window fetcher. tile, low and high take 2 cycles each, push waits for an empty fifo
+        uint8_t fetch_step;
+        uint8_t fetch_cycles;
+        uint8_t fetch_x; // in tiles
+        uint8_t tile_id;
+        uint8_t tile_row; // 0-7
+        uint8_t tile_low;
+        uint8_t tile_high;
+        bool first_fetch; // the first fetch of a line is thrown away
+        bool window_active;
+
+        // sprites found by the oam scan, in oam order
+        std::array<sprite, 10> sprites;
+        uint8_t sprite_count;
+        uint8_t sprite_index; // the sprite being fetched
+        uint8_t sprite_cycles; // left until it's in the sprite fifo
+    };
+
+    static_assert(std::has_unique_object_representations_v<fifo_state>);
+
+    ppu_renderer renderer_ {ppu_renderer::scanline};
+    fifo_state fifo_ {};
+    uint8_t window_line_ {0}; // lines of the window drawn this frame
+    bool window_y_reached_ {false}; // ly matched wy this frame
+    uint16_t drawing_cycles_ {CYCLES_DRAWING};
+    ppu_render_policy render_policy_ {ppu_render_policy::all};
+    uint32_t render_interval_ {1};
+    bool rendering_ {true}; // the policy's verdict on the frame in progress
+
+    // decides whether the next frame to finish is drawn, called once the last one is done
+    void update_rendering();
+
+    void publish_frame();
 };
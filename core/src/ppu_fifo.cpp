@@ -0,0 +1,306 @@
+#include "ppu.h"
+
+#include <algorithm>
+
+// the pixel fifo renderer. every cycle of mode 3 the fetcher works on the next 8 background or window pixels and
+// one pixel leaves the fifos for the screen, with registers and memory read as they are at that cycle. mode 3 takes
+// 172 cycles plus SCX % 8 for the fine scroll, 6 when the window starts and 6-11 for every sprite, so effects
+// that change registers halfway through a line and code that polls STAT see what the hardware shows them.
+
+namespace
+{
+    enum fetch_step : uint8_t
+    {
+        FETCH_TILE,
+        FETCH_LOW,
+        FETCH_HIGH,
+        FETCH_PUSH
+    };
+}
+
+void gb::ppu::tick_fifo(uint32_t cycles, memory_map& mem)
+{
+    const video_memory video{{mem.get_vram_page(0), mem.get_vram_page(1)}, mem.get_oam()};
+
+    for (uint32_t cycle = 0; cycle < cycles; cycle++)
+    {
+        if (mode_ == ppu_mode::Drawing && step_fifo(mem, video))
+        {
+            if (rendering_)
+                screen_.store_line(currentline_, fifo_.pixels.data());
+            drawing_cycles_ = fifo_.cycles;
+            mode_ = ppu_mode::HBlank;
+        }
+
+        cyclecounter_++;
+        if (mode_ == ppu_mode::OAM && cyclecounter_ == CYCLES_OAM)
+        {
+            start_drawing(mem, video);
+            mode_ = ppu_mode::Drawing;
+        }
+        else if (cyclecounter_ >= CYCLES_LINE)
+        {
+            cyclecounter_ = 0;
+            next_line_fifo(mem);
+        }
+    }
+
+    // the mode enumerators are in the order of their STAT values
+    uint8_t stat = (mem.read(STAT_ADDR) & 0xF8) | static_cast<uint8_t>(mode_);
+    if (currentline_ == mem.read(LYC_ADDR))
+        stat |= 0x04;
+    mem.write(STAT_ADDR, stat);
+}
+
+void gb::ppu::next_line_fifo(memory_map& mem)
+{
+    if (fifo_.window_active)
+        window_line_++;
+    fifo_.window_active = false;
+
+    currentline_++;
+    if (currentline_ >= TOTAL_LINES)
+    {
+        currentline_ = 0;
+        window_line_ = 0;
+        window_y_reached_ = false;
+    }
+
+    mem.write(LY_ADDR, currentline_);
+
+    // a line that didn't finish drawing in time, which only happens when switching renderers midway, is dropped
+    if (currentline_ < SCREEN_HEIGHT)
+    {
+        mode_ = ppu_mode::OAM;
+    }
+    else if (currentline_ == SCREEN_HEIGHT)
+    {
+        mode_ = ppu_mode::VBlank;
+        frame_count_++;
+        // a thread, if there is one, has nothing queued while the fifo draws
+        if (output_ && rendering_)
+            screen_.publish(*output_);
+        update_rendering();
+    }
+}
+
+void gb::ppu::start_drawing(const memory_map& mem, const video_memory& video)
+{
+    fifo_ = {};
+    fifo_.first_fetch = true;
+
+    const uint8_t lcdc = mem.read(LCDC_ADDR);
+    fifo_.discard = mem.read(SCX_ADDR) & 0x07;
+    if (mem.read(WY_ADDR) == currentline_)
+        window_y_reached_ = true;
+
+    // the oam scan picks the first 10 sprites overlapping the line, whether sprites are enabled or not
+    const int sprite_height = lcdc & 0x04 ? 16 : 8;
+    const int y = currentline_ + 16;
+    for (uint16_t address = OAM_START; address <= OAM_END && fifo_.sprite_count < fifo_.sprites.size(); address += 4)
+    {
+        const uint8_t sprite_y = video.read_oam(address);
+        if (y < sprite_y || y >= sprite_y + sprite_height)
+            continue;
+
+        fifo_state::sprite& sprite = fifo_.sprites[fifo_.sprite_count++];
+        sprite.y = sprite_y;
+        sprite.x = video.read_oam(address + 1);
+        sprite.tile = video.read_oam(address + 2);
+        sprite.attributes = video.read_oam(address + 3);
+    }
+}
+
+bool gb::ppu::step_fifo(const memory_map& mem, const video_memory& video)
+{
+    fifo_state& fifo = fifo_;
+    fifo.cycles++;
+
+    // pixels stop while a sprite is fetched
+    if (fifo.sprite_cycles > 0)
+    {
+        if (--fifo.sprite_cycles == 0)
+            fetch_sprite(mem.read(LCDC_ADDR), video);
+        return false;
+    }
+
+    const uint8_t lcdc = mem.read(LCDC_ADDR);
+
+    step_fetcher(lcdc, mem, video);
+
+    if (fifo.bg_count == 0)
+        return false;
+
+    // the window starts when the next pixel out would be under it. it restarts the fetcher on the window's tiles,
+    // throwing away the background pixels already fetched
+    if (!fifo.window_active && window_y_reached_ && is_window_enabled(lcdc))
+    {
+        const uint8_t wx = mem.read(WX_ADDR);
+        if (fifo.x + 7 == wx || (wx < 7 && fifo.x == 0))
+        {
+            fifo.window_active = true;
+            fifo.discard = wx < 7 ? 7 - wx : 0;
+            fifo.bg_count = 0;
+            fifo.fetch_step = FETCH_TILE;
+            fifo.fetch_cycles = 1; // this cycle is the first of the fetch
+            fifo.fetch_x = 0;
+            return false;
+        }
+    }
+
+    if (fifo.discard > 0)
+    {
+        fifo.bg_low <<= 1;
+        fifo.bg_high <<= 1;
+        fifo.bg_count--;
+        fifo.discard--;
+        return false;
+    }
+
+    // a sprite starting at this pixel is fetched once the fetcher has the background tile it's working on,
+    // sprites hanging off the left edge start at the first pixel
+    if (is_sprites_enabled(lcdc))
+    {
+        for (uint8_t i = 0; i < fifo.sprite_count; i++)
+        {
+            const fifo_state::sprite& sprite = fifo.sprites[i];
+            if (sprite.fetched || std::max(sprite.x, uint8_t{8}) - 8 != fifo.x)
+                continue;
+
+            if (fifo.fetch_step == FETCH_PUSH)
+            {
+                fifo.sprites[i].fetched = true;
+                fifo.sprite_index = i;
+                fifo.sprite_cycles = 5;
+            }
+            return false;
+        }
+    }
+
+    const uint8_t color_id = ((fifo.bg_high >> 6) & 0x02) | (fifo.bg_low >> 7);
+    fifo.bg_low <<= 1;
+    fifo.bg_high <<= 1;
+    fifo.bg_count--;
+
+    fifo_state::sprite_pixel sprite{};
+    if (fifo.sprite_fifo_count > 0)
+    {
+        sprite = fifo.sprite_fifo[0];
+        std::copy(fifo.sprite_fifo.begin() + 1, fifo.sprite_fifo.end(), fifo.sprite_fifo.begin());
+        fifo.sprite_fifo_count--;
+    }
+
+    // with the background off, background and window are blank and never cover sprites
+    const uint8_t bg_color_id = is_bg_enabled(lcdc) ? color_id : 0;
+    uint8_t shade = is_bg_enabled(lcdc) ? get_shade(color_id, mem.read(BGP_ADDR)) : 0;
+    if (sprite.color_id != 0 && is_sprites_enabled(lcdc) && !((sprite.attributes & 0x80) && bg_color_id != 0))
+        shade = get_shade(sprite.color_id, mem.read(sprite.attributes & 0x10 ? OBP1_ADDR : OBP0_ADDR));
+
+    fifo.pixels[fifo.x++] = shade;
+    return fifo.x == SCREEN_WIDTH;
+}
+
+void gb::ppu::step_fetcher(uint8_t lcdc, const memory_map& mem, const video_memory& video)
+{
+    fifo_state& fifo = fifo_;
+
+    if (fifo.fetch_step == FETCH_PUSH)
+    {
+        if (fifo.bg_count > 0)
+            return;
+
+        fifo.bg_low = fifo.tile_low;
+        fifo.bg_high = fifo.tile_high;
+        fifo.bg_count = 8;
+        fifo.fetch_x++;
+        fifo.fetch_step = FETCH_TILE;
+        return;
+    }
+
+    if (++fifo.fetch_cycles < 2)
+        return;
+    fifo.fetch_cycles = 0;
+
+    switch (fifo.fetch_step)
+    {
+        case FETCH_TILE:
+        {
+            uint16_t tile_map;
+            uint8_t y;
+            uint8_t tile_col;
+            if (fifo.window_active)
+            {
+                tile_map = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+                y = window_line_;
+                tile_col = fifo.fetch_x & 31;
+            }
+            else
+            {
+                tile_map = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+                y = static_cast<uint8_t>(currentline_ + mem.read(SCY_ADDR));
+                tile_col = ((mem.read(SCX_ADDR) >> 3) + fifo.fetch_x) & 31;
+            }
+            fifo.tile_id = video.read_vram(tile_map + (y / 8) * 32 + tile_col);
+            fifo.tile_row = y % 8;
+            fifo.fetch_step = FETCH_LOW;
+            break;
+        }
+
+        case FETCH_LOW:
+        case FETCH_HIGH:
+        {
+            const uint16_t tile = (lcdc & 0x10) ? 0x8000 + fifo.tile_id * 16
+                                                : 0x9000 + static_cast<int8_t>(fifo.tile_id) * 16;
+            const uint16_t address = tile + fifo.tile_row * 2;
+            if (fifo.fetch_step == FETCH_LOW)
+            {
+                fifo.tile_low = video.read_vram(address);
+                fifo.fetch_step = FETCH_HIGH;
+            }
+            else
+            {
+                fifo.tile_high = video.read_vram(address + 1);
+                fifo.fetch_step = FETCH_PUSH;
+                // the line's first fetch is done twice
+                if (fifo.first_fetch)
+                {
+                    fifo.first_fetch = false;
+                    fifo.fetch_step = FETCH_TILE;
+                }
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void gb::ppu::fetch_sprite(uint8_t lcdc, const video_memory& video)
+{
+    fifo_state& fifo = fifo_;
+    const fifo_state::sprite& sprite = fifo.sprites[fifo.sprite_index];
+
+    const bool tall_sprites = lcdc & 0x04;
+    const int sprite_height = tall_sprites ? 16 : 8;
+    int row = (currentline_ + 16 - sprite.y) & (sprite_height - 1);
+    if (sprite.attributes & 0x40)
+        row = sprite_height - 1 - row;
+
+    const uint8_t tile = tall_sprites ? sprite.tile & 0xFE : sprite.tile;
+    const uint16_t address = 0x8000 + tile * 16 + row * 2;
+    const uint8_t low = video.read_vram(address);
+    const uint8_t high = video.read_vram(address + 1);
+
+    // pixels already in the fifo belong to sprites further left or earlier in oam, they win wherever they're opaque
+    const int hidden = sprite.x < 8 ? 8 - sprite.x : 0;
+    for (int x = hidden; x < 8; x++)
+    {
+        const int bit = (sprite.attributes & 0x20) ? x : 7 - x;
+        const uint8_t color_id = ((low >> bit) & 1) | (((high >> bit) & 1) << 1);
+        fifo_state::sprite_pixel& pixel = fifo.sprite_fifo[x - hidden];
+        if (x - hidden >= fifo.sprite_fifo_count || pixel.color_id == 0)
+            pixel = {color_id, sprite.attributes};
+    }
+    fifo.sprite_fifo_count = std::max<uint8_t>(fifo.sprite_fifo_count, 8 - hidden);
+}
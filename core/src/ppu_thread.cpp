@@ -0,0 +1,226 @@
+#include "ppu_thread.h"
+
+#include "host_trace.h"
+
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace
+{
+    // big enough for many frames of records, a record is at most a few kilobytes
+    constexpr size_t SEGMENT_SIZE = 256 * 1024;
+
+    enum record_flags : uint8_t
+    {
+        RECORD_OAM = 0x01, // the oam follows the vram blocks
+        RECORD_STOP = 0x02, // no line, the renderer exits
+        RECORD_PUBLISH = 0x04 // no line, the shades go to output
+    };
+
+    // followed by the dirty vram blocks in ascending order, then the oam if RECORD_OAM
+    struct record_header
+    {
+        uint8_t flags;
+        uint8_t scanline;
+        gb::scanline_registers regs;
+        std::array<uint64_t, VRAM_BLOCK_COUNT / 64> vram_dirty;
+        gb::triple_buffer<gb::ppu::frame>* output;
+    };
+
+    constexpr size_t MAX_RECORD_SIZE = sizeof(record_header) + VRAM_SIZE + OAM_SIZE;
+    static_assert(MAX_RECORD_SIZE <= SEGMENT_SIZE);
+}
+
+struct gb::ppu_thread::segment
+{
+    std::unique_ptr<uint8_t[]> data {std::make_unique<uint8_t[]>(SEGMENT_SIZE)};
+
+    // written by the producer only. committed is how far the consumer may read, next is set once the producer
+    // moved on to a new segment and won't commit anything more here
+    std::atomic<size_t> committed {0};
+    std::atomic<segment*> next {nullptr};
+
+    // the next segment in free_segments_
+    segment* next_free {nullptr};
+};
+
+gb::ppu_thread::ppu_thread(ppu::screen& out) :
+    write_segment_(new segment),
+    read_segment_(write_segment_),
+    screen_(out)
+{
+    thread_ = std::thread{&ppu_thread::run, this};
+}
+
+gb::ppu_thread::~ppu_thread()
+{
+    push(RECORD_STOP, 0, {}, nullptr);
+    thread_.join();
+    delete read_segment_;
+    for (segment* s = free_segments_.load(std::memory_order_acquire); s;)
+        delete std::exchange(s, s->next_free);
+}
+
+void gb::ppu_thread::submit(uint8_t scanline, const scanline_registers& regs, memory_map& mem)
+{
+    push(0, scanline, regs, &mem);
+}
+
+void gb::ppu_thread::publish(triple_buffer<ppu::frame>& output)
+{
+    push(RECORD_PUBLISH, 0, {}, nullptr, &output);
+}
+
+void gb::ppu_thread::finish() const
+{
+    uint64_t rendered = rendered_.load(std::memory_order_acquire);
+    while (rendered < submitted_count_)
+    {
+        rendered_.wait(rendered, std::memory_order_acquire);
+        rendered = rendered_.load(std::memory_order_acquire);
+    }
+}
+
+void gb::ppu_thread::push(uint8_t flags, uint8_t scanline, const scanline_registers& regs, memory_map* mem,
+                          triple_buffer<ppu::frame>* output)
+{
+    record_header header{};
+    header.flags = flags;
+    header.scanline = scanline;
+    header.regs = regs;
+    header.output = output;
+    if (mem)
+    {
+        header.vram_dirty = mem->take_vram_dirty();
+        if (mem->take_oam_dirty())
+            header.flags |= RECORD_OAM;
+    }
+
+    // a renderer that fell this far behind is waited for, rather than queueing up more and more frames
+    uint64_t rendered = rendered_.load(std::memory_order_acquire);
+    while (submitted_count_ - rendered >= MAX_PENDING_RECORDS)
+    {
+        rendered_.wait(rendered, std::memory_order_acquire);
+        rendered = rendered_.load(std::memory_order_acquire);
+    }
+
+    size_t size = sizeof(header) + ((header.flags & RECORD_OAM) ? OAM_SIZE : 0);
+    for (const uint64_t word : header.vram_dirty)
+        size += std::popcount(word) * VRAM_BLOCK_SIZE;
+
+    // records never straddle segments, the consumer follows next once it read everything committed
+    if (write_pos_ + size > SEGMENT_SIZE)
+    {
+        segment* next = take_segment();
+        write_segment_->next.store(next, std::memory_order_release);
+        write_segment_ = next;
+        write_pos_ = 0;
+    }
+
+    uint8_t* out = write_segment_->data.get() + write_pos_;
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (size_t block = 0; block < VRAM_BLOCK_COUNT; block++)
+    {
+        if (!(header.vram_dirty[block / 64] & (uint64_t{1} << (block % 64))))
+            continue;
+        const size_t offset = block * VRAM_BLOCK_SIZE;
+        std::memcpy(out, mem->get_vram_page(offset >> MEM_PAGE_SHIFT) + (offset & MEM_PAGE_MASK), VRAM_BLOCK_SIZE);
+        out += VRAM_BLOCK_SIZE;
+    }
+    if (header.flags & RECORD_OAM)
+        std::memcpy(out, mem->get_oam(), OAM_SIZE);
+
+    write_pos_ += size;
+    write_segment_->committed.store(write_pos_, std::memory_order_release);
+    submitted_count_++;
+    submitted_.store(submitted_count_, std::memory_order_release);
+    submitted_.notify_one();
+}
+
+gb::ppu_thread::segment* gb::ppu_thread::take_segment()
+{
+    // only this thread pops, so the head can't be popped and pushed again between the load and the exchange
+    segment* s = free_segments_.load(std::memory_order_acquire);
+    while (s && !free_segments_.compare_exchange_weak(s, s->next_free, std::memory_order_acquire))
+    {
+    }
+    if (!s)
+        return new segment;
+
+    s->committed.store(0, std::memory_order_relaxed);
+    s->next.store(nullptr, std::memory_order_relaxed);
+    return s;
+}
+
+void gb::ppu_thread::recycle_segment(segment* s)
+{
+    s->next_free = free_segments_.load(std::memory_order_relaxed);
+    while (!free_segments_.compare_exchange_weak(s->next_free, s, std::memory_order_release,
+                                                 std::memory_order_relaxed))
+    {
+    }
+}
+
+void gb::ppu_thread::run()
+{
+    GB_TRACE_THREAD_NAME("ppu");
+    uint64_t consumed = 0;
+    while (true)
+    {
+        uint64_t submitted = submitted_.load(std::memory_order_acquire);
+        while (submitted == consumed)
+        {
+            submitted_.wait(submitted, std::memory_order_acquire);
+            submitted = submitted_.load(std::memory_order_acquire);
+        }
+
+        // a record is available, either in this segment or at the start of the next one
+        if (read_pos_ == read_segment_->committed.load(std::memory_order_acquire))
+        {
+            segment* next = read_segment_->next.load(std::memory_order_acquire);
+            recycle_segment(read_segment_);
+            read_segment_ = next;
+            read_pos_ = 0;
+        }
+
+        const uint8_t* in = read_segment_->data.get() + read_pos_;
+        record_header header{};
+        std::memcpy(&header, in, sizeof(header));
+        in += sizeof(header);
+
+        for (size_t block = 0; block < VRAM_BLOCK_COUNT; block++)
+        {
+            if (!(header.vram_dirty[block / 64] & (uint64_t{1} << (block % 64))))
+                continue;
+            std::memcpy(vram_.data() + block * VRAM_BLOCK_SIZE, in, VRAM_BLOCK_SIZE);
+            in += VRAM_BLOCK_SIZE;
+        }
+        if (header.flags & RECORD_OAM)
+        {
+            std::memcpy(oam_.data(), in, OAM_SIZE);
+            in += OAM_SIZE;
+        }
+        read_pos_ = static_cast<size_t>(in - read_segment_->data.get());
+
+        if (header.flags & RECORD_STOP)
+            return;
+
+        if (header.flags & RECORD_PUBLISH)
+        {
+            screen_.publish(*header.output);
+        }
+        else
+        {
+            GB_TRACE_SCOPE("ppu_thread::render_line");
+            const video_memory video{{vram_.data(), vram_.data() + MEM_PAGE_SIZE}, oam_.data()};
+            ppu::render_line(header.regs, video, header.scanline, screen_);
+        }
+
+        consumed++;
+        rendered_.store(consumed, std::memory_order_release);
+        rendered_.notify_all();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "ppu.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace gb
+{
+    class ppu_thread;
+}
+
+// renders scanlines for a ppu on a thread of its own.
+// at the start of every visible line the emulation thread appends a record to a single producer/single consumer
+// queue: the registers the line depends on, and the vram blocks and oam written since the previous record. the
+// renderer applies those to its own copy of vram/oam and renders the line with ppu::render_line, so the output is
+// the same as inline rendering. the queue is a chain of segments, which the renderer hands back for reuse once it
+// read them. it holds at most MAX_PENDING_RECORDS records, a few frames: submit() only waits for the renderer
+// when it falls that far behind, which also bounds how many segments there ever are.
+class gb::ppu_thread
+{
+public:
+    // lines are rendered into out, which has to outlive this
+    explicit ppu_thread(ppu::screen& out);
+
+    // renders everything submitted so far, then stops the thread
+    ~ppu_thread();
+
+    // lines and publishes not rendered yet before submit() and publish() wait for the renderer: 3 frames of 144
+    // lines and a publish each
+    static constexpr uint64_t MAX_PENDING_RECORDS = 3 * (144 + 1);
+
+    ppu_thread(const ppu_thread&) = delete;
+    ppu_thread& operator=(const ppu_thread&) = delete;
+
+    // emulation thread only. takes mem's dirty vram/oam along with the registers
+    void submit(uint8_t scanline, const scanline_registers& regs, memory_map& mem);
+
+    // emulation thread only. publishes the shades to output once every line submitted so far is drawn
+    void publish(triple_buffer<ppu::frame>& output);
+
+    // emulation thread only. blocks until every submitted line is rendered
+    void finish() const;
+
+private:
+    struct segment;
+
+    // producer side
+    segment* write_segment_;
+    size_t write_pos_ {0};
+    uint64_t submitted_count_ {0};
+
+    // consumer side
+    segment* read_segment_;
+    size_t read_pos_ {0};
+    std::array<uint8_t, VRAM_SIZE> vram_ {};
+    std::array<uint8_t, OAM_SIZE> oam_ {};
+    ppu::screen& screen_;
+
+    // records published and records rendered, waited on with atomic wait/notify
+    std::atomic<uint64_t> submitted_ {0};
+    std::atomic<uint64_t> rendered_ {0};
+
+    // segments the renderer is done with, for the producer to reuse. pushed by the consumer, popped by the
+    // producer only
+    std::atomic<segment*> free_segments_ {nullptr};
+
+    std::thread thread_;
+
+    void push(uint8_t flags, uint8_t scanline, const scanline_registers& regs, memory_map* mem,
+              triple_buffer<ppu::frame>* output = nullptr);
+    segment* take_segment();
+    void recycle_segment(segment* s);
+    void run();
+};
@@ -0,0 +1,194 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    // BB:AAAA, like the .sym files write them
+    void write_address(std::ostream& out, uint16_t bank, uint16_t address)
+    {
+        out << std::hex << std::setfill('0') << std::setw(2) << bank << ':' << std::setw(4) << address << std::dec;
+    }
+
+    // only rom has banks
+    uint16_t lookup_bank(uint16_t bank, uint16_t address)
+    {
+        return address >= 0x4000 && address < 0x8000 ? bank : 0;
+    }
+
+    // rom0, romx, vram, cartridge ram, wram, echo ram and everything from oam up
+    int region(uint16_t address)
+    {
+        if (address < 0x8000)
+            return address >> 14;
+        return address < 0xFE00 ? address >> 13 : 8;
+    }
+}
+
+void gb::profiler::reset()
+{
+    opcodes_ = {};
+    boot_ = {};
+    rom0_.clear();
+    romx_.clear();
+    upper_.assign(UPPER_SIZE, {});
+}
+
+gb::profile_counter gb::profiler::get_location(uint16_t bank, uint16_t address) const
+{
+    if (address >= 0x8000)
+        return upper_[address - 0x8000];
+
+    const std::vector<profile_counter>& window = address < 0x4000 ? rom0_ : romx_;
+    const size_t index = static_cast<size_t>(bank) * cartridge::BANK_SIZE_ROM + (address & 0x3FFF);
+    return index < window.size() ? window[index] : profile_counter{};
+}
+
+gb::profile_counter gb::profiler::get_boot_location(uint16_t address) const
+{
+    return address < BOOT_SIZE ? boot_[address] : profile_counter{};
+}
+
+uint64_t gb::profiler::total_cycles() const
+{
+    uint64_t total = 0;
+    for (const profile_counter& counter : opcodes_)
+        total += counter.cycles;
+    return total;
+}
+
+template<typename Visit>
+void gb::profiler::for_each_location(Visit visit) const
+{
+    for (size_t i = 0; i < boot_.size(); i++)
+    {
+        if (boot_[i].count)
+            visit(location_key{true, 0, static_cast<uint16_t>(i)}, boot_[i]);
+    }
+
+    // the bank is wherever in the rom the window pointed
+    const auto visit_window = [&](const std::vector<profile_counter>& window, uint16_t base)
+    {
+        for (size_t i = 0; i < window.size(); i++)
+        {
+            if (window[i].count == 0)
+                continue;
+            const auto bank = static_cast<uint16_t>(i / cartridge::BANK_SIZE_ROM);
+            const auto address = static_cast<uint16_t>(base + i % cartridge::BANK_SIZE_ROM);
+            visit(location_key{false, bank, address}, window[i]);
+        }
+    };
+    visit_window(rom0_, 0x0000);
+    visit_window(romx_, 0x4000);
+
+    for (size_t i = 0; i < upper_.size(); i++)
+    {
+        if (upper_[i].count)
+            visit(location_key{false, 0, static_cast<uint16_t>(0x8000 + i)}, upper_[i]);
+    }
+}
+
+void gb::profiler::write_csv(std::ostream& out, const symbol_table* symbols) const
+{
+    out << "bank,address,count,cycles" << (symbols ? ",symbol\n" : "\n");
+    for_each_location([&](const location_key& key, const profile_counter& counter)
+    {
+        out << std::hex << std::setfill('0');
+        if (key.boot)
+            out << "boot";
+        else
+            out << std::setw(2) << key.bank;
+        out << ',' << std::setw(4) << key.address << std::dec << ',' << counter.count << ',' << counter.cycles;
+        if (symbols)
+        {
+            // the boot rom isn't part of the program the symbols describe
+            const symbol* label = key.boot ? nullptr : symbols->find(key.bank, key.address);
+            out << ',' << (label ? label->name : "");
+        }
+        out << '\n';
+    });
+}
+
+void gb::profiler::write_opcode_csv(std::ostream& out) const
+{
+    out << "opcode,count,cycles\n";
+    for (size_t i = 0; i < opcodes_.size(); i++)
+    {
+        if (opcodes_[i].count == 0)
+            continue;
+        out << std::hex << std::setfill('0') << std::setw(2) << i << std::dec << ',' << opcodes_[i].count << ','
+            << opcodes_[i].cycles << '\n';
+    }
+}
+
+void gb::profiler::write_folded(std::ostream& out, const symbol_table* symbols) const
+{
+    for_each_location([&](const location_key& key, const profile_counter& counter)
+    {
+        const symbol* label = symbols && !key.boot ? symbols->find(key.bank, key.address) : nullptr;
+        if (label)
+            out << label->name << ';';
+        if (key.boot)
+            out << "boot:" << std::hex << std::setfill('0') << std::setw(4) << key.address << std::dec;
+        else
+            write_address(out, key.bank, key.address);
+        out << ' ' << counter.cycles << '\n';
+    });
+}
+
+gb::symbol_table::symbol_table(const std::filesystem::path& path)
+{
+    std::ifstream file{path};
+    if (!file)
+        throw std::runtime_error("Failed to read symbols: " + path.string());
+    std::stringstream text;
+    text << file.rdbuf();
+    *this = parse(text.str());
+}
+
+gb::symbol_table gb::symbol_table::parse(const std::string& text)
+{
+    symbol_table table;
+    std::istringstream lines{text};
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        line = line.substr(0, line.find(';'));
+        unsigned bank, address;
+        char name[256];
+        if (std::sscanf(line.c_str(), " %x:%x %255s", &bank, &address, name) != 3 || bank > 0xFFFF ||
+            address > 0xFFFF)
+            continue;
+        const auto addr = static_cast<uint16_t>(address);
+        table.symbols_.push_back({lookup_bank(static_cast<uint16_t>(bank), addr), addr, name});
+    }
+
+    std::ranges::stable_sort(table.symbols_, [](const symbol& a, const symbol& b)
+    {
+        return a.bank != b.bank ? a.bank < b.bank : a.address < b.address;
+    });
+    return table;
+}
+
+const gb::symbol* gb::symbol_table::find(uint16_t bank, uint16_t address) const
+{
+    bank = lookup_bank(bank, address);
+    // the first label past address, the one before it is the candidate
+    const auto after = std::ranges::upper_bound(symbols_, std::pair{bank, address}, {}, [](const symbol& s)
+    {
+        return std::pair{s.bank, s.address};
+    });
+    if (after == symbols_.begin())
+        return nullptr;
+
+    // a label only covers its own region, code in hram isn't part of whatever wram label comes last
+    const symbol& label = *std::prev(after);
+    if (label.bank != bank || region(label.address) != region(address))
+        return nullptr;
+    return &label;
+}
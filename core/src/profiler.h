@@ -0,0 +1,171 @@
+#pragma once
+
+#include "cartridge.h"
+#include "memory_map.h"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace gb
+{
+    class profiler;
+    class symbol_table;
+
+    struct profile_counter
+    {
+        uint64_t count; // instructions executed
+        uint64_t cycles; // machine cycles they took
+    };
+
+    // a label of a .sym file
+    struct symbol
+    {
+        uint16_t bank;
+        uint16_t address;
+        std::string name;
+    };
+}
+
+// counts what the cpu executes, per opcode and per instruction address, for finding where emulated time goes.
+// the cpu only feeds one when the emulator is built with GB_PROFILE (cmake -DGB_PROFILE=ON), without it
+// cpu::execute has no trace of profiling at all.
+// the counters are flat arrays, per byte of the rom as seen through each of the two rom windows, of the boot rom
+// and of 0x8000-0xFFFF, so recording an instruction is two additions and an index computed from the mapped rom
+// banks. instructions in rom are told apart by the bank they were mapped from, everything from 0x8000 up counts
+// as bank 0 and the boot rom has counters of its own
+class gb::profiler
+{
+public:
+#ifdef GB_PROFILE
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    /** the counters of the instruction at pc, in the bank mapped there right now. the cpu calls this before every
+     * instruction runs, which may switch the bank it came from (or the boot rom) out from under it. the
+     * reference stays valid until the next call. the rom windows index their counters by the offset of the mapped
+     * bank into the rom image, the arrays only grow this far on the first instruction that needs it. rom0 rarely
+     * sees anything but bank 0
+     */
+    profile_counter& locate(const memory_map& mem, uint16_t pc)
+    {
+        const cartridge& cart = mem.get_cartridge();
+        const uint8_t* rom = cart.rom()->data();
+        if (pc < 0x4000)
+        {
+            if (pc < BOOT_SIZE && mem.is_boot_rom_mapped())
+                return boot_[pc];
+            const auto index = static_cast<size_t>(cart.rom0_window() - rom) + pc;
+            if (index >= rom0_.size())
+                rom0_.resize((index / cartridge::BANK_SIZE_ROM + 1) * cartridge::BANK_SIZE_ROM);
+            return rom0_[index];
+        }
+        if (pc < 0x8000)
+        {
+            const auto index = static_cast<size_t>(cart.romx_window() - rom) + (pc - 0x4000);
+            if (index >= romx_.size())
+                romx_.resize(cart.rom()->size());
+            return romx_[index];
+        }
+        return upper_[pc - 0x8000];
+    }
+
+    // called by the cpu after every instruction, with what locate returned before it ran
+    void record(profile_counter& location, uint8_t opcode, uint32_t cycles)
+    {
+        opcodes_[opcode].count++;
+        opcodes_[opcode].cycles += cycles;
+        location.count++;
+        location.cycles += cycles;
+    }
+
+    // both at once, for an instruction that didn't change the mapping
+    void record(const memory_map& mem, uint16_t pc, uint8_t opcode, uint32_t cycles)
+    {
+        record(locate(mem, pc), opcode, cycles);
+    }
+
+    void reset();
+
+    [[nodiscard]] const profile_counter& get_opcode(uint8_t opcode) const
+    {
+        return opcodes_[opcode];
+    }
+
+    // nothing for addresses that never executed. 0x0000-0x3FFF and 0x4000-0x7FFF are counted apart, whatever bank
+    // each of them had mapped
+    [[nodiscard]] profile_counter get_location(uint16_t bank, uint16_t address) const;
+
+    // 0x0000-0x00FF while the boot rom was mapped over the cartridge
+    [[nodiscard]] profile_counter get_boot_location(uint16_t address) const;
+
+    [[nodiscard]] uint64_t total_cycles() const;
+
+    /** bank,address,count,cycles for every address that executed anything, address in hex as the cpu saw it and
+     * "boot" as the bank of the boot rom. with symbols, a last column names the label the address belongs to
+     */
+    void write_csv(std::ostream& out, const symbol_table* symbols = nullptr) const;
+
+    // opcode,count,cycles for every opcode that executed
+    void write_opcode_csv(std::ostream& out) const;
+
+    /** one "frames cycles" line per executed address, for flamegraph.pl and friends. with symbols, the frames are
+     * the label the address belongs to and the address (BB:AAAA, boot:AAAA), without them just the address
+     */
+    void write_folded(std::ostream& out, const symbol_table* symbols = nullptr) const;
+
+private:
+    static constexpr size_t BOOT_SIZE = 0x100;
+    static constexpr size_t UPPER_SIZE = 0x8000; // 0x8000-0xFFFF
+
+    // where an executed address was, for dumping
+    struct location_key
+    {
+        bool boot;
+        uint16_t bank;
+        uint16_t address;
+    };
+
+    // calls visit(location_key, profile_counter) for every address that executed anything, in address order per
+    // window: the boot rom, 0x0000-0x3FFF, 0x4000-0x7FFF, then the rest
+    template<typename Visit>
+    void for_each_location(Visit visit) const;
+
+    std::array<profile_counter, 256> opcodes_ {};
+    std::array<profile_counter, BOOT_SIZE> boot_ {};
+    std::vector<profile_counter> rom0_;
+    std::vector<profile_counter> romx_;
+    std::vector<profile_counter> upper_ = std::vector<profile_counter>(UPPER_SIZE);
+};
+
+// the labels of a .sym file as rgbds and wla-dx write them: "BB:AAAA name" per line, ';' starts a comment and
+// [section] lines are skipped
+class gb::symbol_table
+{
+public:
+    symbol_table() = default;
+
+    // throws std::runtime_error if the file can't be read
+    explicit symbol_table(const std::filesystem::path& path);
+
+    // from the text of a .sym file
+    static symbol_table parse(const std::string& text);
+
+    /** the label at or closest before address in the same bank, nullptr if there's none. addresses below 0x4000
+     * and from 0x8000 up look in bank 0, where .sym files put them
+     */
+    [[nodiscard]] const symbol* find(uint16_t bank, uint16_t address) const;
+
+    [[nodiscard]] size_t size() const
+    {
+        return symbols_.size();
+    }
+
+private:
+    std::vector<symbol> symbols_; // sorted by bank, then address
+};
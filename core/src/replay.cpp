@@ -0,0 +1,96 @@
+#include "replay.h"
+
+#include "hash.h"
+
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+    // what's hashed once the big parts are hashed by themselves. no padding, so the hash only depends on the values
+    struct hashed_state
+    {
+        std::array<uint64_t, RAM_PAGE_COUNT> pages;
+        uint64_t oam, io, hram, screen;
+        uint16_t af, bc, de, hl, sp, pc;
+        uint16_t reserved[2];
+    };
+
+    static_assert(std::has_unique_object_representations_v<hashed_state>);
+}
+
+gb::state_hasher::state_hasher(gameboy& gb) :
+    gb_(gb)
+{
+    gb_.mem.set_page_tracking(true);
+}
+
+gb::state_hasher::~state_hasher()
+{
+    gb_.mem.set_page_tracking(false);
+}
+
+uint64_t gb::state_hasher::hash()
+{
+    const uint8_t written = gb_.mem.take_written_pages();
+    for (size_t i = 0; i < RAM_PAGE_COUNT; i++)
+    {
+        if (written & (1 << i))
+        {
+            const auto page = gb_.mem.get_ram_page(i);
+            page_hashes_[i] = hash_bytes(page.data(), page.size());
+        }
+    }
+
+    hashed_state state{};
+
+    state.af = gb_.cpu.AF.full;
+    state.bc = gb_.cpu.BC.full;
+    state.de = gb_.cpu.DE.full;
+    state.hl = gb_.cpu.HL.full;
+    state.sp = gb_.cpu.SP.full;
+    state.pc = gb_.cpu.PC.full;
+    state.pages = page_hashes_;
+    state.oam = hash_bytes(gb_.mem.get_oam(), OAM_SIZE);
+    state.io = hash_bytes(gb_.mem.get_io().data(), gb_.mem.get_io().size());
+    state.hram = hash_bytes(gb_.mem.get_hram().data(), gb_.mem.get_hram().size());
+    state.screen = gb_.ppu.get_frame_hash();
+    return hash_bytes(&state, sizeof(state));
+}
+
+void gb::record_hashes(gameboy& gb, input_movie& movie)
+{
+    state_hasher hasher{gb};
+    std::vector<uint64_t> hashes;
+    hashes.reserve(movie.frame_count());
+    for (uint64_t frame = 0; frame < movie.frame_count(); frame++)
+    {
+        gb.mem.set_buttons(movie.get_buttons(frame));
+        gb.run_frame();
+        hashes.push_back(hasher.hash());
+    }
+    movie.set_hashes(std::move(hashes));
+}
+
+gb::replay_result gb::verify_replay(gameboy& gb, const input_movie& movie)
+{
+    state_hasher hasher{gb};
+    replay_result result{};
+    for (uint64_t frame = 0; frame < movie.frame_count(); frame++)
+    {
+        gb.mem.set_buttons(movie.get_buttons(frame));
+        gb.run_frame();
+        result.frames++;
+
+        const uint64_t hash = hasher.hash();
+        if (hash != movie.get_hash(frame))
+        {
+            result.diverged = true;
+            result.first_divergence = frame;
+            result.expected_hash = movie.get_hash(frame);
+            result.actual_hash = hash;
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "gameboy.h"
+#include "input_movie.h"
+
+#include <array>
+#include <cstdint>
+
+namespace gb
+{
+    class state_hasher;
+
+    struct replay_result
+    {
+        uint64_t frames; // replayed
+        bool diverged;
+        uint64_t first_divergence; // the first frame whose state hash differs, if diverged
+        uint64_t expected_hash; // at that frame
+        uint64_t actual_hash;
+    };
+
+    // plays movie on gb from wherever it is, and stores the state hash after every frame in the movie
+    void record_hashes(gameboy& gb, input_movie& movie);
+
+    /** plays movie on gb from wherever it is, comparing the state after every frame against the hashes the movie
+     * was recorded with, up to the first frame that differs. the movie has to have hashes (input_movie::has_hashes)
+     */
+    replay_result verify_replay(gameboy& gb, const input_movie& movie);
+}
+
+// hashes the state that tells whether two runs went the same way: the cpu registers, vram, wram, oam, io, hram and
+// the screen. the ram pages are write tracked (see memory_map::set_page_tracking), so only pages written since the
+// last hash are read again, and the screen's hash only rehashes lines that changed (see ppu::get_frame_hash).
+// an idle frame costs a few hundred bytes of hashing instead of 16 KB
+class gb::state_hasher
+{
+public:
+    // turns on page tracking in gb's memory for as long as this is around
+    explicit state_hasher(gameboy& gb);
+    ~state_hasher();
+
+    state_hasher(const state_hasher&) = delete;
+    state_hasher& operator=(const state_hasher&) = delete;
+
+    [[nodiscard]] uint64_t hash();
+
+private:
+    gameboy& gb_;
+    std::array<uint64_t, RAM_PAGE_COUNT> page_hashes_ {};
+};
@@ -0,0 +1,126 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace
+{
+    // kaiser window shape, about 70 dB down in the stop band
+    constexpr double KAISER_BETA = 7.0;
+
+    // dot product of TAPS samples against one row of the filter. the sums run over LANES separate accumulators, the
+    // same math whether the lanes end up in one vector register or not, so the compiler vectorizes it without
+    // -ffast-math
+    float dot(const float* samples, const float* filter)
+    {
+        std::array<float, gb::resampler::LANES> sums{};
+        for (size_t i = 0; i < gb::resampler::TAPS; i += gb::resampler::LANES)
+        {
+            for (size_t lane = 0; lane < gb::resampler::LANES; lane++)
+                sums[lane] += samples[i + lane] * filter[i + lane];
+        }
+
+        float sum = 0.0f;
+        for (float lane : sums)
+            sum += lane;
+        return sum;
+    }
+
+    // the modified bessel function of the first kind, order 0, for the kaiser window. std::cyl_bessel_i is missing
+    // from libc++, and the power series sum of ((x/2)^k / k!)^2 is down to double precision within 25 terms for
+    // x up to 10
+    double bessel_i0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 25; k++)
+        {
+            term *= x / (2.0 * k);
+            sum += term * term;
+        }
+        return sum;
+    }
+
+    int16_t to_sample(float value)
+    {
+        return static_cast<int16_t>(std::clamp(value, -32768.0f, 32767.0f));
+    }
+}
+
+gb::resampler::resampler(uint32_t input_rate, uint32_t output_rate) :
+    input_rate_(input_rate),
+    output_rate_(output_rate)
+{
+    auto filter = std::make_shared<std::vector<std::array<float, TAPS>>>(PHASES);
+
+    // cut off just below the lower rate's nyquist frequency. with 64 taps the transition is about 9 kHz wide at
+    // 131072 Hz in, so going to 48000 Hz everything that would fold back below 20 kHz is gone, and up to 19 kHz is
+    // kept
+    const double cutoff = 0.49 * std::min(input_rate, output_rate) / input_rate;
+    constexpr double CENTER = TAPS / 2.0 - 1.0;
+    const double window_scale = bessel_i0(KAISER_BETA);
+
+    for (size_t phase = 0; phase < PHASES; phase++)
+    {
+        const double offset = static_cast<double>(phase) / PHASES;
+        std::array<double, TAPS> taps{};
+        double sum = 0.0;
+        for (size_t i = 0; i < TAPS; i++)
+        {
+            const double x = static_cast<double>(i) - CENTER - offset;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * std::numbers::pi * cutoff * x) /
+                                                 (2.0 * std::numbers::pi * cutoff * x);
+            const double r = x / (TAPS / 2.0);
+            const double window = r <= -1.0 || r >= 1.0
+                                  ? 0.0
+                                  : bessel_i0(KAISER_BETA * std::sqrt(1.0 - r * r)) / window_scale;
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+
+        // unity gain at dc for every phase, so a constant level stays constant
+        for (size_t i = 0; i < TAPS; i++)
+            (*filter)[phase][i] = static_cast<float>(taps[i] / sum);
+    }
+    filter_ = std::move(filter);
+
+    set_rate_factor(1.0);
+    clear();
+}
+
+void gb::resampler::set_rate_factor(double factor)
+{
+    // rounded up, so a second in is never more than a second out
+    step_ = static_cast<uint64_t>(std::ceil(std::ldexp(static_cast<double>(input_rate_) / (output_rate_ * factor), 32)));
+}
+
+void gb::resampler::process(std::span<const float> left, std::span<const float> right, std::vector<int16_t>& out)
+{
+    history_[0].insert(history_[0].end(), left.begin(), left.end());
+    history_[1].insert(history_[1].end(), right.begin(), right.end());
+
+    const size_t available = history_[0].size();
+    while ((position_ >> 32) + TAPS <= available)
+    {
+        const size_t index = position_ >> 32;
+        const float* filter = (*filter_)[((position_ & 0xFFFFFFFF) * PHASES) >> 32].data();
+        out.push_back(to_sample(dot(&history_[0][index], filter)));
+        out.push_back(to_sample(dot(&history_[1][index], filter)));
+        position_ += step_;
+    }
+
+    // keep what the next output samples still need
+    const size_t consumed = std::min<size_t>(position_ >> 32, available);
+    for (std::vector<float>& history : history_)
+        history.erase(history.begin(), history.begin() + static_cast<std::ptrdiff_t>(consumed));
+    position_ -= uint64_t{consumed} << 32;
+}
+
+void gb::resampler::clear()
+{
+    // primed with silence, so output starts with the first input
+    for (std::vector<float>& history : history_)
+        history.assign(TAPS - 1, 0.0f);
+    position_ = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace gb
+{
+    class resampler;
+}
+
+// takes stereo samples from one rate to another with a polyphase fir filter: a kaiser windowed sinc cut off around
+// 20 kHz, tabulated at PHASES sub-sample positions, so every output sample is one dot product of TAPS input samples
+// per side against the row for its position. the dot products are written over LANES independent sums, which the
+// compiler turns into vector instructions without being allowed to reorder floating point math.
+// the ratio can be nudged while running, for a caller keeping an audio device's buffer at a steady level.
+class gb::resampler
+{
+public:
+    static constexpr size_t TAPS = 64;
+    static constexpr size_t PHASES = 128;
+    static constexpr size_t LANES = 8;
+
+    resampler(uint32_t input_rate, uint32_t output_rate);
+
+    /** scales the output rate by factor, 1.0 is exact. a factor above 1 makes more samples out of the same input,
+     * for a device that plays slightly faster than the emulator runs
+     */
+    void set_rate_factor(double factor);
+
+    // resamples left and right, which are the same length, and appends interleaved samples to out
+    void process(std::span<const float> left, std::span<const float> right, std::vector<int16_t>& out);
+
+    // back to silence
+    void clear();
+
+private:
+    static_assert(TAPS % LANES == 0);
+
+    uint32_t input_rate_;
+    uint32_t output_rate_;
+
+    // the filter for every sub-sample position. never changes once built, so copies share it
+    std::shared_ptr<const std::vector<std::array<float, TAPS>>> filter_;
+
+    // input samples per output sample, in 1/2^32ths
+    uint64_t step_ {0};
+    // position of the next output sample in the history, in 1/2^32ths of an input sample
+    uint64_t position_ {0};
+
+    // the last TAPS - 1 input samples, then the new ones
+    std::array<std::vector<float>, 2> history_;
+};
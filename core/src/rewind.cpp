@@ -0,0 +1,204 @@
+#include "rewind.h"
+
+#include "delta_codec.h"
+
+#include <algorithm>
+#include <chrono>
+
+gb::rewind_buffer::rewind_buffer(size_t capacity_bytes, uint32_t interval_frames, uint32_t keyframe_interval) :
+    interval_frames_(std::max<uint32_t>(interval_frames, 1)),
+    keyframe_interval_(std::max<uint32_t>(keyframe_interval, 1)),
+    ring_(capacity_bytes),
+    // a delta of an idle frame is a handful of bytes, this is plenty of entries for any realistic ring
+    entries_(std::max<size_t>(capacity_bytes / 64, 16))
+{
+}
+
+void gb::rewind_buffer::on_frame(const gameboy& gb)
+{
+    if (entry_count_ == 0 || gb.get_frame_count() >= last_capture_frame_ + interval_frames_)
+        capture(gb);
+}
+
+void gb::rewind_buffer::capture(const gameboy& gb)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    if (current_.empty())
+    {
+        const size_t state_size = gb.save_state_size();
+        current_.resize(state_size);
+        previous_.resize(state_size);
+        encoded_.resize(delta_codec::max_encoded_size(state_size));
+    }
+
+    gb.save_state(current_);
+
+    if (entry_count_ == entries_.size())
+        evict_oldest_group();
+
+    bool keyframe = entry_count_ == 0 || captures_since_keyframe_ >= keyframe_interval_;
+    size_t encoded_size = delta_codec::encode(current_, keyframe ? std::span<const uint8_t>{} : previous_, encoded_);
+
+    size_t offset = allocate(encoded_size);
+    while (offset == NO_SPACE && entry_count_ > 0)
+    {
+        evict_oldest_group();
+        // a delta needs the captures before it, once they're all gone this has to become a keyframe
+        if (entry_count_ == 0 && !keyframe)
+        {
+            keyframe = true;
+            encoded_size = delta_codec::encode(current_, {}, encoded_);
+        }
+        offset = allocate(encoded_size);
+    }
+    if (offset == NO_SPACE || encoded_size == 0)
+        return; // the ring is empty by now, so this is a keyframe and even that doesn't fit
+
+    std::copy_n(encoded_.begin(), encoded_size, ring_.begin() + static_cast<ptrdiff_t>(offset));
+    entry_at(entry_count_) = entry{gb.get_frame_count(), offset, encoded_size, keyframe};
+    entry_count_++;
+    write_pos_ = offset + encoded_size;
+    used_bytes_ += encoded_size;
+    captures_since_keyframe_ = keyframe ? 1 : captures_since_keyframe_ + 1;
+    last_capture_frame_ = gb.get_frame_count();
+    std::swap(current_, previous_);
+
+    last_capture_us_ = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    total_capture_us_ += last_capture_us_;
+    captures_++;
+}
+
+bool gb::rewind_buffer::rewind(gameboy& gb, uint64_t frames)
+{
+    if (entry_count_ == 0)
+        return false;
+
+    const uint64_t now = gb.get_frame_count();
+    const uint64_t target = now - std::min(frames, now);
+
+    // newest capture at or before the target, or the oldest one if the target is out of range
+    size_t index = 0;
+    for (size_t i = entry_count_; i-- > 0;)
+    {
+        if (entry_at(i).frame <= target)
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if (!reconstruct(index) || !gb.load_state(current_))
+        return false;
+
+    // history continues from the restored capture
+    const entry& restored = entry_at(index);
+    for (size_t i = index + 1; i < entry_count_; i++)
+        used_bytes_ -= entry_at(i).size;
+    entry_count_ = index + 1;
+    write_pos_ = restored.offset + restored.size;
+    captures_since_keyframe_ = 0;
+    for (size_t i = index + 1; i-- > 0;)
+    {
+        captures_since_keyframe_++;
+        if (entry_at(i).keyframe)
+            break;
+    }
+    last_capture_frame_ = restored.frame;
+    std::copy(current_.begin(), current_.end(), previous_.begin());
+
+    // re-emulate the frames between the capture and the target. counted rather than compared against the
+    // frame count, which doesn't advance with the lcd off
+    for (uint64_t frame = restored.frame; frame < target; frame++)
+        gb.run_frame();
+
+    return true;
+}
+
+void gb::rewind_buffer::clear()
+{
+    write_pos_ = 0;
+    used_bytes_ = 0;
+    entry_tail_ = 0;
+    entry_count_ = 0;
+    captures_since_keyframe_ = 0;
+    last_capture_frame_ = 0;
+}
+
+gb::rewind_stats gb::rewind_buffer::stats() const
+{
+    rewind_stats stats{};
+    stats.capacity_bytes = ring_.size();
+    stats.used_bytes = used_bytes_;
+    stats.memory_footprint = ring_.size() + current_.size() + previous_.size() + encoded_.size() +
+                             entries_.size() * sizeof(entry);
+    stats.state_size = current_.size();
+    stats.entries = entry_count_;
+    stats.frames_covered = entry_count_ > 0 ? entry_at(entry_count_ - 1).frame - entry_at(0).frame : 0;
+    stats.captures = captures_;
+    stats.last_capture_us = last_capture_us_;
+    stats.average_capture_us = captures_ > 0 ? total_capture_us_ / static_cast<double>(captures_) : 0.0;
+    return stats;
+}
+
+size_t gb::rewind_buffer::allocate(size_t size) const
+{
+    if (entry_count_ == 0)
+        return size <= ring_.size() ? 0 : NO_SPACE;
+
+    const size_t oldest = entry_at(0).offset;
+    const size_t newest = entry_at(entry_count_ - 1).offset;
+
+    if (newest >= oldest)
+    {
+        // live data is [oldest, write_pos_), try the end first, then wrap around
+        if (write_pos_ + size <= ring_.size())
+            return write_pos_;
+        if (size <= oldest)
+            return 0;
+    }
+    else if (write_pos_ + size <= oldest)
+    {
+        // already wrapped, live data is [oldest, end) and [0, write_pos_)
+        return write_pos_;
+    }
+    return NO_SPACE;
+}
+
+void gb::rewind_buffer::evict_oldest_group()
+{
+    // the oldest entry is always a keyframe, drop it along with the deltas that depend on it
+    do
+    {
+        used_bytes_ -= entry_at(0).size;
+        entry_tail_ = (entry_tail_ + 1) % entries_.size();
+        entry_count_--;
+    } while (entry_count_ > 0 && !entry_at(0).keyframe);
+
+    if (entry_count_ == 0)
+        clear();
+}
+
+bool gb::rewind_buffer::reconstruct(size_t index)
+{
+    size_t keyframe = index;
+    while (!entry_at(keyframe).keyframe)
+        keyframe--;
+
+    std::fill(current_.begin(), current_.end(), 0);
+    for (size_t i = keyframe; i <= index; i++)
+    {
+        const entry& e = entry_at(i);
+        if (!delta_codec::decode(std::span{ring_}.subspan(e.offset, e.size), current_))
+            return false;
+    }
+    return true;
+}
+
+std::ostream& gb::operator<<(std::ostream& os, const rewind_stats& stats)
+{
+    return os << "rewind: " << stats.entries << " captures over " << stats.frames_covered << " frames, "
+              << stats.used_bytes << "/" << stats.capacity_bytes << " bytes (" << stats.memory_footprint
+              << " total, " << stats.state_size << " per raw state), capture " << stats.last_capture_us
+              << " us (avg " << stats.average_capture_us << " us)";
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "gameboy.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace gb
+{
+    class rewind_buffer;
+
+    struct rewind_stats
+    {
+        size_t capacity_bytes; // size of the compressed history ring
+        size_t used_bytes; // compressed bytes currently held
+        size_t memory_footprint; // everything the rewind buffer allocated, ring included
+        size_t state_size; // size of one uncompressed save state
+        size_t entries;
+        uint64_t frames_covered; // distance between the oldest and newest capture
+        uint64_t captures;
+        double last_capture_us;
+        double average_capture_us;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const rewind_stats& stats);
+}
+
+// history of save states for rewinding, kept in a fixed size ring.
+// every capture is stored as the xor delta against the previous one, run length coded (see delta_codec.h), with
+// a whole keyframe every so often. once the ring is full, the oldest keyframe and its deltas are dropped together.
+class gb::rewind_buffer
+{
+public:
+    /**
+     * @param capacity_bytes size of the compressed history ring, allocated up front
+     * @param interval_frames a state is captured every this many frames
+     * @param keyframe_interval every this many captures is stored whole, which bounds the cost of a rewind
+     */
+    explicit rewind_buffer(size_t capacity_bytes, uint32_t interval_frames = 1, uint32_t keyframe_interval = 60);
+
+    // call after every emulated frame, captures once the interval has passed
+    void on_frame(const gameboy& gb);
+
+    // captures the current state regardless of the interval
+    void capture(const gameboy& gb);
+
+    /** goes back `frames` frames. restores the newest capture at or before the target from its keyframe, then
+     * re-emulates forward to the target frame. captures after the restored one are dropped.
+     * targets older than the history are clamped to the oldest capture.
+     * @returns false if nothing was captured yet
+     */
+    bool rewind(gameboy& gb, uint64_t frames);
+
+    void clear();
+
+    [[nodiscard]] rewind_stats stats() const;
+
+private:
+    struct entry
+    {
+        uint64_t frame;
+        size_t offset; // into ring_
+        size_t size;
+        bool keyframe;
+    };
+
+    static constexpr size_t NO_SPACE = SIZE_MAX;
+
+    uint32_t interval_frames_;
+    uint32_t keyframe_interval_;
+
+    std::vector<uint8_t> ring_;
+    size_t write_pos_ {0};
+    size_t used_bytes_ {0};
+
+    // entries are a ring as well, oldest at entry_tail_
+    std::vector<entry> entries_;
+    size_t entry_tail_ {0};
+    size_t entry_count_ {0};
+    uint32_t captures_since_keyframe_ {0};
+    uint64_t last_capture_frame_ {0};
+
+    // scratch, sized on the first capture
+    std::vector<uint8_t> current_;
+    std::vector<uint8_t> previous_;
+    std::vector<uint8_t> encoded_;
+
+    uint64_t captures_ {0};
+    double last_capture_us_ {0};
+    double total_capture_us_ {0};
+
+    [[nodiscard]] entry& entry_at(size_t i)
+    {
+        return entries_[(entry_tail_ + i) % entries_.size()];
+    }
+
+    [[nodiscard]] const entry& entry_at(size_t i) const
+    {
+        return entries_[(entry_tail_ + i) % entries_.size()];
+    }
+
+    [[nodiscard]] size_t allocate(size_t size) const;
+    void evict_oldest_group();
+    bool reconstruct(size_t index);
+};
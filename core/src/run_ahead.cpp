@@ -0,0 +1,49 @@
+#include "run_ahead.h"
+
+#include <chrono>
+
+gb::run_ahead::run_ahead(uint32_t frames) :
+    frames_(frames)
+{
+}
+
+uint32_t gb::run_ahead::run_frame(gameboy& gb, uint8_t buttons)
+{
+    gb.mem.set_buttons(buttons);
+    gb.ppu.set_render_policy(frames_ == 0 ? ppu_render_policy::all : ppu_render_policy::none);
+    const uint32_t cycles = gb.run_frame();
+    if (frames_ == 0)
+        return cycles;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // the fork holds the same buttons, and has no audio to make
+    gameboy ahead = gb.fork();
+    for (uint32_t frame = 0; frame < frames_; frame++)
+    {
+        ahead.ppu.set_render_policy(frame + 1 == frames_ ? ppu_render_policy::all : ppu_render_policy::none);
+        ahead.run_frame();
+    }
+    gb.ppu.present(ahead.ppu);
+
+    last_us_ = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    total_us_ += last_us_;
+    runs_++;
+    return cycles;
+}
+
+gb::run_ahead_stats gb::run_ahead::stats() const
+{
+    run_ahead_stats stats{};
+    stats.frames = frames_;
+    stats.runs = runs_;
+    stats.last_us = last_us_;
+    stats.average_us = runs_ ? total_us_ / static_cast<double>(runs_) : 0.0;
+    return stats;
+}
+
+std::ostream& gb::operator<<(std::ostream& os, const run_ahead_stats& stats)
+{
+    return os << "run-ahead: " << stats.frames << " frames, " << stats.runs << " runs, cost " << stats.last_us
+              << " us per frame (avg " << stats.average_us << " us)";
+}
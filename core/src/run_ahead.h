@@ -0,0 +1,53 @@
+#pragma once
+
+#include "gameboy.h"
+
+#include <cstdint>
+#include <ostream>
+
+namespace gb
+{
+    class run_ahead;
+
+    struct run_ahead_stats
+    {
+        uint32_t frames; // how far ahead
+        uint64_t runs;
+        double last_us; // forking and running ahead, on top of the real frame
+        double average_us;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const run_ahead_stats& stats);
+}
+
+// hides input latency. every frame the console runs once for real without drawing, then a fork of it runs
+// `frames` frames further with the same buttons held, drawing only the last one, and that's the frame shown. the
+// fork is thrown away after, so a game that takes a few frames to react to a press shows it that many frames
+// sooner, while the real console stays exactly where it'd be without run-ahead, audio included.
+// forking only copies what the fork writes to (see memory_map::fork), so nearly all of the cost is the frames run
+// ahead.
+class gb::run_ahead
+{
+public:
+    explicit run_ahead(uint32_t frames);
+
+    /** runs gb for a frame with buttons held (see joypad.h), then ahead of it. gb's ppu publishes the frame from
+     * ahead to its frame output and has it as its screen, gb stops drawing frames of its own
+     * @returns # of machine cycles gb executed
+     */
+    uint32_t run_frame(gameboy& gb, uint8_t buttons);
+
+    [[nodiscard]] uint32_t get_frames() const
+    {
+        return frames_;
+    }
+
+    [[nodiscard]] run_ahead_stats stats() const;
+
+private:
+    uint32_t frames_;
+
+    uint64_t runs_ {0};
+    double last_us_ {0};
+    double total_us_ {0};
+};
@@ -0,0 +1,71 @@
+#include "save_state.h"
+
+#include "cpu.h"
+#include "memory_map.h"
+#include "ppu.h"
+
+namespace
+{
+    void write_body(const gb::cpu& cpu, const gb::memory_map& mem, const gb::ppu& ppu, gb::state_writer& out,
+                    uint16_t flags)
+    {
+        cpu.save(out);
+        mem.save(out);
+        ppu.save(out, flags);
+    }
+}
+
+size_t gb::save_state_size(const cpu& cpu, const memory_map& mem, const ppu& ppu, uint16_t flags)
+{
+    // an empty writer only counts
+    state_writer counter{{}};
+    counter.write(save_state_header{});
+    write_body(cpu, mem, ppu, counter, flags);
+    return counter.size();
+}
+
+size_t gb::save_state(const cpu& cpu, const memory_map& mem, const ppu& ppu, std::span<uint8_t> out,
+                      uint16_t flags)
+{
+    state_writer writer{out};
+
+    // the size is patched in at the end, so the header doesn't cost a second pass
+    save_state_header header{};
+    header.magic = SAVE_STATE_MAGIC;
+    header.version = SAVE_STATE_VERSION;
+    header.flags = flags;
+    header.ram_size = static_cast<uint32_t>(mem.get_cartridge().ram_size());
+    header.rom_checksum = mem.get_cartridge().rom_checksum();
+    writer.write(header);
+
+    write_body(cpu, mem, ppu, writer, flags);
+    if (writer.failed())
+        return 0;
+
+    header.size = static_cast<uint32_t>(writer.size());
+    std::memcpy(out.data(), &header, sizeof(header));
+    return writer.size();
+}
+
+bool gb::load_state(cpu& cpu, memory_map& mem, ppu& ppu, std::span<const uint8_t> in)
+{
+    save_state_header header{};
+    if (in.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, in.data(), sizeof(header));
+
+    if (header.magic != SAVE_STATE_MAGIC || header.version != SAVE_STATE_VERSION)
+        return false;
+    if (header.ram_size != mem.get_cartridge().ram_size() ||
+        header.rom_checksum != mem.get_cartridge().rom_checksum())
+        return false;
+    if (header.size > in.size() || header.size != save_state_size(cpu, mem, ppu, header.flags))
+        return false;
+
+    // everything is validated, so the reads below can't run out of data
+    state_reader reader{in.subspan(sizeof(header), header.size - sizeof(header))};
+    cpu.load(reader);
+    mem.load(reader);
+    ppu.load(reader, header.flags);
+    return !reader.failed();
+}
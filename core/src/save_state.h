@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+namespace gb
+{
+    struct cpu;
+    class memory_map;
+    class ppu;
+    class state_writer;
+    class state_reader;
+
+    enum save_state_flags : uint16_t
+    {
+        STATE_FRAMEBUFFER = 0x01 // also store the ppu framebuffer, not needed to resume emulation
+    };
+
+    // bump whenever the layout of any component changes
+    static constexpr uint16_t SAVE_STATE_VERSION = 6;
+    static constexpr uint32_t SAVE_STATE_MAGIC = 0x53534247; // "GBSS"
+
+    struct save_state_header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t flags;
+        uint32_t size; // total size, including this header
+        uint32_t ram_size; // external ram, which is the only part whose size depends on the cartridge
+        uint16_t rom_checksum; // global checksum from the cartridge header, to reject states of other roms
+        uint16_t reserved;
+    };
+
+    /** snapshots the emulator into a caller provided buffer. nothing is allocated.
+     * the layout is fixed for a given rom and flags, so consecutive states can be diffed byte by byte.
+     * values are stored in host byte order.
+     * @returns # of bytes written, 0 if the buffer was too small. it holds a partial state then, which won't load
+     */
+    size_t save_state(const cpu& cpu, const memory_map& mem, const ppu& ppu, std::span<uint8_t> out,
+                      uint16_t flags = 0);
+
+    // restores a snapshot taken by save_state. the state is validated up front, on failure nothing is changed
+    bool load_state(cpu& cpu, memory_map& mem, ppu& ppu, std::span<const uint8_t> in);
+
+    // the exact # of bytes save_state writes for this rom and flags
+    size_t save_state_size(const cpu& cpu, const memory_map& mem, const ppu& ppu, uint16_t flags = 0);
+}
+
+// appends raw bytes to a fixed buffer. running out of space flags the writer as failed, but keeps counting,
+// so writing into an empty buffer measures the size of a state
+class gb::state_writer
+{
+public:
+    explicit state_writer(std::span<uint8_t> buffer) :
+        buffer_(buffer)
+    {
+    }
+
+    void write_bytes(const void* data, size_t size)
+    {
+        if (offset_ + size <= buffer_.size())
+            std::memcpy(buffer_.data() + offset_, data, size);
+        else
+            failed_ = true;
+        offset_ += size;
+    }
+
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write_bytes(&value, sizeof(T));
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return offset_;
+    }
+
+    [[nodiscard]] bool failed() const
+    {
+        return failed_;
+    }
+
+private:
+    std::span<uint8_t> buffer_;
+    size_t offset_ {0};
+    bool failed_ {false};
+};
+
+// reads back what a state_writer wrote, in the same order
+class gb::state_reader
+{
+public:
+    explicit state_reader(std::span<const uint8_t> buffer) :
+        buffer_(buffer)
+    {
+    }
+
+    void read_bytes(void* data, size_t size)
+    {
+        if (offset_ + size <= buffer_.size())
+            std::memcpy(data, buffer_.data() + offset_, size);
+        else
+            failed_ = true;
+        offset_ += size;
+    }
+
+    template <typename T>
+    void read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        read_bytes(&value, sizeof(T));
+    }
+
+    [[nodiscard]] size_t size() const
+    {
+        return offset_;
+    }
+
+    [[nodiscard]] bool failed() const
+    {
+        return failed_;
+    }
+
+private:
+    std::span<const uint8_t> buffer_;
+    size_t offset_ {0};
+    bool failed_ {false};
+};
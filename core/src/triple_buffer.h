@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace gb
+{
+    template <typename T>
+    class triple_buffer;
+}
+
+// hands complete values from one writer thread to one reader thread without either of them waiting.
+// the writer fills the back slot and publishes it by swapping it with the middle slot, the reader picks up the
+// middle slot by swapping it with its front slot. the reader always gets the latest published value, values
+// published in between are skipped, and neither side ever sees a slot the other one is using.
+template <typename T>
+class gb::triple_buffer
+{
+public:
+    // writer only. the slot to fill, its contents are whatever was published three slots ago
+    [[nodiscard]] T& write_buffer()
+    {
+        return slots_[back_];
+    }
+
+    // writer only. makes the write buffer the latest value and moves on to another slot
+    void publish()
+    {
+        back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // writer only. whether the reader hasn't picked up the last published value yet
+    [[nodiscard]] bool has_unread() const
+    {
+        return middle_.load(std::memory_order_relaxed) & FRESH;
+    }
+
+    /** reader only. switches read_buffer() to the latest value
+     * @returns false if nothing was published since the last call, read_buffer() stays the same then
+     */
+    bool acquire()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // reader only
+    [[nodiscard]] const T& read_buffer() const
+    {
+        return slots_[front_];
+    }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x03;
+    static constexpr uint8_t FRESH = 0x04; // set in middle_ when the writer published since the reader last swapped
+
+    std::array<T, 3> slots_ {};
+
+    // each side only touches its own index and the shared middle one, kept on separate cache lines
+    alignas(64) uint8_t back_ {0};
+    alignas(64) std::atomic<uint8_t> middle_ {1};
+    alignas(64) uint8_t front_ {2};
+};
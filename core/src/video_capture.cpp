@@ -0,0 +1,161 @@
+#include "video_capture.h"
+
+#include "delta_codec.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+gb::video_capture::video_capture(const std::filesystem::path& path, uint16_t keyframe_interval) :
+    file_(path, std::ios::binary | std::ios::trunc),
+    keyframe_interval_(std::max<uint16_t>(keyframe_interval, 1)),
+    slots_(QUEUE_FRAMES),
+    encoded_(delta_codec::max_encoded_size(ppu::PACKED_FRAME_SIZE))
+{
+    if (!file_)
+        throw std::runtime_error("Failed to create video capture: " + path.string());
+
+    video_capture_header header{};
+    header.magic = VIDEO_CAPTURE_MAGIC;
+    header.version = VIDEO_CAPTURE_VERSION;
+    header.width = ppu::PACKED_LINE_SIZE * 4;
+    header.height = ppu::PACKED_FRAME_SIZE / ppu::PACKED_LINE_SIZE;
+    header.keyframe_interval = keyframe_interval_;
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    bytes_written_ = sizeof(header);
+    failed_ = !file_;
+
+    thread_ = std::thread{&video_capture::run, this};
+}
+
+gb::video_capture::~video_capture()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    queued_.notify_one();
+    thread_.join();
+}
+
+void gb::video_capture::add_frame(std::span<const uint8_t> shades)
+{
+    std::unique_lock lock{mutex_};
+    if (failed_)
+        return;
+
+    // only waits when the writer is QUEUE_FRAMES behind
+    written_.wait(lock, [this] { return count_ < slots_.size(); });
+    frame& slot = slots_[(head_ + count_) % slots_.size()];
+    std::copy_n(shades.begin(), std::min(shades.size(), slot.size()), slot.begin());
+    count_++;
+    lock.unlock();
+    queued_.notify_one();
+}
+
+void gb::video_capture::flush()
+{
+    std::unique_lock lock{mutex_};
+    written_.wait(lock, [this] { return count_ == 0; });
+}
+
+bool gb::video_capture::ok() const
+{
+    std::lock_guard lock{mutex_};
+    return !failed_;
+}
+
+uint64_t gb::video_capture::frames_written() const
+{
+    std::lock_guard lock{mutex_};
+    return frames_written_;
+}
+
+uint64_t gb::video_capture::bytes_written() const
+{
+    std::lock_guard lock{mutex_};
+    return bytes_written_;
+}
+
+void gb::video_capture::run()
+{
+    std::unique_lock lock{mutex_};
+    while (true)
+    {
+        queued_.wait(lock, [this] { return count_ > 0 || stopping_; });
+        if (count_ == 0)
+            break;
+
+        // the slot stays taken while it's encoded, add_frame only fills the ones after it
+        const frame& shades = slots_[head_];
+        const bool keyframe = frames_written_ % keyframe_interval_ == 0;
+        lock.unlock();
+
+        const bool written = write_frame(shades, keyframe);
+
+        lock.lock();
+        head_ = (head_ + 1) % slots_.size();
+        count_--;
+        if (written)
+        {
+            frames_written_++;
+        }
+        else
+        {
+            // nothing more gets written, so nobody waits for a slot again
+            failed_ = true;
+            count_ = 0;
+        }
+        written_.notify_all();
+    }
+
+    file_.flush();
+}
+
+bool gb::video_capture::write_frame(const frame& shades, bool keyframe)
+{
+    const std::span<const uint8_t> reference = keyframe ? std::span<const uint8_t>{} : previous_;
+    const size_t size = delta_codec::encode(shades, reference, encoded_);
+    previous_ = shades;
+
+    video_record_header record{};
+    record.size = static_cast<uint32_t>(size);
+    record.keyframe = keyframe ? 1 : 0;
+    file_.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    file_.write(reinterpret_cast<const char*>(encoded_.data()), static_cast<std::streamsize>(size));
+    if (!file_ || size == 0)
+        return false;
+
+    std::lock_guard lock{mutex_};
+    bytes_written_ += sizeof(record) + size;
+    return true;
+}
+
+gb::video_reader::video_reader(const std::filesystem::path& path) :
+    file_(path, std::ios::binary)
+{
+    if (!file_.read(reinterpret_cast<char*>(&header_), sizeof(header_)) || header_.magic != VIDEO_CAPTURE_MAGIC)
+        throw std::runtime_error("Not a video capture: " + path.string());
+    if (header_.version != VIDEO_CAPTURE_VERSION)
+        throw std::runtime_error("Unsupported video capture version: " + path.string());
+    if (static_cast<size_t>(header_.width) * header_.height / 4 != current_.size())
+        throw std::runtime_error("Unsupported video capture size: " + path.string());
+}
+
+bool gb::video_reader::next_frame(std::span<uint8_t> shades)
+{
+    video_record_header record{};
+    if (!file_.read(reinterpret_cast<char*>(&record), sizeof(record)))
+        return false;
+
+    payload_.resize(record.size);
+    if (!file_.read(reinterpret_cast<char*>(payload_.data()), record.size))
+        throw std::runtime_error("Video capture is truncated");
+
+    if (record.keyframe)
+        current_.fill(0);
+    if (!delta_codec::decode(payload_, current_))
+        throw std::runtime_error("Video capture is damaged");
+
+    std::copy_n(current_.begin(), std::min(shades.size(), current_.size()), shades.begin());
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ppu.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace gb
+{
+    class video_capture;
+    class video_reader;
+
+    static constexpr uint32_t VIDEO_CAPTURE_MAGIC = 0x43564247; // "GBVC"
+    static constexpr uint16_t VIDEO_CAPTURE_VERSION = 1;
+
+    // file layout: this header, then one record per frame, a video_record_header followed by its delta_codec
+    // payload. all values in host byte order
+    struct video_capture_header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t width; // in pixels
+        uint16_t height;
+        uint16_t keyframe_interval;
+    };
+
+    struct video_record_header
+    {
+        uint32_t size; // of the payload
+        uint8_t keyframe; // 1 if the payload isn't a delta against the previous frame
+        uint8_t reserved[3];
+    };
+}
+
+// records frames losslessly to a file. frames are the ppu's packed 2 bit shades, each one stored as the xor delta
+// against the previous frame, zero run length coded (see delta_codec.h), with a whole frame every so often.
+// encoding and writing happen on a thread of its own. frames wait for it in a fixed number of slots, and
+// add_frame only blocks when all of them are full, so memory stays bounded and no frame is ever dropped.
+class gb::video_capture
+{
+public:
+    static constexpr size_t QUEUE_FRAMES = 16;
+
+    /** creates or truncates the file
+     * @param keyframe_interval every this many frames is stored whole, so a damaged capture is readable past it
+     */
+    explicit video_capture(const std::filesystem::path& path, uint16_t keyframe_interval = 600);
+
+    // writes every frame added so far
+    ~video_capture();
+
+    video_capture(const video_capture&) = delete;
+    video_capture& operator=(const video_capture&) = delete;
+
+    // queues a copy of shades, which is ppu::get_shades() or a published ppu::frame
+    void add_frame(std::span<const uint8_t> shades);
+
+    // blocks until every frame added so far is written
+    void flush();
+
+    // false once writing to the file failed, frames after that are dropped
+    [[nodiscard]] bool ok() const;
+
+    [[nodiscard]] uint64_t frames_written() const;
+    [[nodiscard]] uint64_t bytes_written() const; // including the headers
+
+private:
+    using frame = std::array<uint8_t, ppu::PACKED_FRAME_SIZE>;
+
+    std::ofstream file_;
+    uint16_t keyframe_interval_;
+
+    // ring of queued frames, guarded by mutex_
+    std::vector<frame> slots_;
+    size_t head_ {0}; // next slot to write
+    size_t count_ {0};
+    bool stopping_ {false};
+    bool failed_ {false};
+    uint64_t frames_written_ {0};
+    uint64_t bytes_written_ {0};
+    mutable std::mutex mutex_;
+    std::condition_variable queued_; // a frame was added, or stopping
+    std::condition_variable written_; // a slot freed up
+
+    // writer thread only
+    frame previous_ {};
+    std::vector<uint8_t> encoded_;
+
+    std::thread thread_;
+
+    void run();
+    [[nodiscard]] bool write_frame(const frame& shades, bool keyframe);
+};
+
+// reads frames back from a capture
+class gb::video_reader
+{
+public:
+    // throws std::runtime_error if the file can't be opened or isn't a capture
+    explicit video_reader(const std::filesystem::path& path);
+
+    [[nodiscard]] uint16_t width() const
+    {
+        return header_.width;
+    }
+
+    [[nodiscard]] uint16_t height() const
+    {
+        return header_.height;
+    }
+
+    /** decodes the next frame into shades, PACKED_FRAME_SIZE bytes
+     * @returns false at the end of the capture. throws std::runtime_error if the capture is damaged
+     */
+    bool next_frame(std::span<uint8_t> shades);
+
+private:
+    std::ifstream file_;
+    video_capture_header header_ {};
+    std::array<uint8_t, ppu::PACKED_FRAME_SIZE> current_ {};
+    std::vector<uint8_t> payload_;
+};
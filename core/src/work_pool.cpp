@@ -0,0 +1,119 @@
+#include "work_pool.h"
+
+#include <algorithm>
+
+namespace
+{
+    // lets submit() find the deque of the worker it's called from
+    thread_local const gb::work_pool* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+}
+
+gb::work_pool::work_pool(size_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+        queues_.push_back(std::make_unique<worker_queue>());
+
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+        threads_.emplace_back(&work_pool::worker_loop, this, i);
+}
+
+gb::work_pool::~work_pool()
+{
+    wait();
+    {
+        std::lock_guard lock{sleep_mutex_};
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_)
+        thread.join();
+}
+
+void gb::work_pool::submit(task t)
+{
+    const size_t index = current_pool == this
+                             ? current_worker
+                             : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+    pending_.fetch_add(1);
+    {
+        std::lock_guard lock{queues_[index]->mutex};
+        queues_[index]->tasks.push_back(std::move(t));
+    }
+    {
+        std::lock_guard lock{sleep_mutex_};
+        queued_.fetch_add(1);
+    }
+    wake_.notify_one();
+}
+
+void gb::work_pool::wait()
+{
+    std::unique_lock lock{sleep_mutex_};
+    done_.wait(lock, [this] { return pending_.load() == 0; });
+}
+
+void gb::work_pool::worker_loop(size_t index)
+{
+    current_pool = this;
+    current_worker = index;
+
+    task t;
+    while (true)
+    {
+        if (pop_own(index, t) || steal(index, t))
+        {
+            queued_.fetch_sub(1);
+            t();
+            t = nullptr;
+
+            if (pending_.fetch_sub(1) == 1)
+            {
+                std::lock_guard lock{sleep_mutex_};
+                done_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock lock{sleep_mutex_};
+        wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0)
+            return;
+    }
+}
+
+bool gb::work_pool::pop_own(size_t index, task& out)
+{
+    worker_queue& queue = *queues_[index];
+    std::lock_guard lock{queue.mutex};
+    if (queue.tasks.empty())
+        return false;
+
+    out = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool gb::work_pool::steal(size_t index, task& out)
+{
+    // start at the next worker so thieves spread out instead of all hitting worker 0
+    for (size_t i = 1; i < queues_.size(); i++)
+    {
+        worker_queue& victim = *queues_[(index + i) % queues_.size()];
+        std::lock_guard lock{victim.mutex};
+        if (victim.tasks.empty())
+            continue;
+
+        out = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
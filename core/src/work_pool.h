@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gb
+{
+    class work_pool;
+}
+
+// fixed set of worker threads with one task deque each. a worker takes its newest task from its own deque, and
+// once that runs dry steals the oldest task of another worker, so uneven tasks still keep every core busy.
+// meant for coarse tasks (a whole emulator run), every deque operation takes a lock.
+class gb::work_pool
+{
+public:
+    using task = std::function<void()>;
+
+    // 0 threads means one per hardware thread
+    explicit work_pool(size_t thread_count = 0);
+
+    // finishes every task already submitted
+    ~work_pool();
+
+    work_pool(const work_pool&) = delete;
+    work_pool& operator=(const work_pool&) = delete;
+
+    // tasks submitted from a worker go to its own deque, others are spread round robin
+    void submit(task t);
+
+    // blocks until every submitted task has finished, including tasks those submitted
+    void wait();
+
+    [[nodiscard]] size_t thread_count() const
+    {
+        return threads_.size();
+    }
+
+    // # of tasks a worker took from another worker's deque
+    [[nodiscard]] uint64_t steal_count() const
+    {
+        return steals_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    // tasks sitting in a deque, and tasks submitted but not finished yet
+    std::atomic<size_t> queued_ {0};
+    std::atomic<size_t> pending_ {0};
+    std::atomic<size_t> next_queue_ {0};
+    std::atomic<uint64_t> steals_ {0};
+
+    // sleeping workers and wait() are woken through these. queued_ only grows and stopping_ only changes while
+    // holding sleep_mutex_, so no wakeup is lost
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    bool stopping_ {false};
+
+    void worker_loop(size_t index);
+    bool pop_own(size_t index, task& out);
+    bool steal(size_t index, task& out);
+};
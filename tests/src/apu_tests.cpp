@@ -0,0 +1,165 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <numbers>
+#include <memory_map.h>
+#include <span>
+#include <gtest/gtest.h>
+
+class ApuTests : public ::testing::Test
+{
+public:
+    gb::memory_map mem{};
+
+    void SetUp() override
+    {
+        mem.write(0xFF26, 0x80); // nr52: power on
+        mem.write(0xFF24, 0x77); // nr50: full volume
+        mem.write(0xFF25, 0x22); // nr51: channel 2 left and right
+    }
+
+    // channel 2 at 512 Hz, 50% duty, full volume
+    void play_channel_2()
+    {
+        mem.write(0xFF16, 0x80); // nr21
+        mem.write(0xFF17, 0xF0); // nr22
+        mem.write(0xFF18, 0x00); // nr23: frequency 1792 is 131072 / (2048 - 1792) Hz
+        mem.write(0xFF19, 0x87); // nr24: trigger
+    }
+
+    static constexpr uint32_t CLOCKS_PER_SECOND = gb::apu::CYCLES_PER_SECOND / 4;
+
+    // sign changes of the left channel. the output is band-limited, so it rings a little before and after every
+    // edge, which doesn't count
+    static int crossings(std::span<const int16_t> samples)
+    {
+        int count = 0;
+        int sign = 0;
+        for (size_t i = 0; i < samples.size(); i += 2)
+        {
+            const int sample_sign = samples[i] > 256 ? 1 : samples[i] < -256 ? -1 : 0;
+            if (sample_sign != 0 && sample_sign != sign)
+            {
+                count += sign != 0 ? 1 : 0;
+                sign = sample_sign;
+            }
+        }
+        return count;
+    }
+
+    // amplitude of the left channel at frequency, by correlating with a sine and cosine
+    static double amplitude(std::span<const int16_t> samples, double frequency, uint32_t sample_rate)
+    {
+        double sine = 0.0;
+        double cosine = 0.0;
+        const size_t count = samples.size() / 2;
+        for (size_t i = 0; i < count; i++)
+        {
+            const double phase = 2.0 * std::numbers::pi * frequency * static_cast<double>(i) / sample_rate;
+            sine += samples[2 * i] * std::sin(phase);
+            cosine += samples[2 * i] * std::cos(phase);
+        }
+        return 2.0 * std::hypot(sine, cosine) / static_cast<double>(count);
+    }
+};
+
+TEST_F(ApuTests, LengthTurnsChannelsOffWithoutSynthesis)
+{
+    // given:
+    mem.write(0xFF12, 0xF0); // nr12: dac on
+    mem.write(0xFF11, 0x3E); // nr11: 2 length steps
+    mem.write(0xFF14, 0xC0); // nr14: trigger with length enabled
+
+    // then:
+    EXPECT_EQ(mem.read(0xFF26), 0xF1);
+
+    // when: 4 frame sequencer steps, 2 of which clock lengths
+    mem.advance_clock(4 * gb::apu::CYCLES_PER_STEP / 4);
+
+    // then:
+    EXPECT_EQ(mem.read(0xFF26), 0xF0);
+    EXPECT_FALSE(mem.get_apu().is_synthesizing());
+    EXPECT_TRUE(mem.get_apu().get_samples().empty());
+}
+
+TEST_F(ApuTests, ReadsBackWritableBitsOnly)
+{
+    // when:
+    mem.write(0xFF11, 0x9E); // nr11: duty and length
+    mem.write(0xFF30, 0x5A); // wave ram
+
+    // then: the length is write only
+    EXPECT_EQ(mem.read(0xFF11), 0xBF);
+    EXPECT_EQ(mem.read(0xFF13), 0xFF);
+    EXPECT_EQ(mem.read(0xFF30), 0x5A);
+
+    // when: powered off
+    mem.write(0xFF26, 0x00);
+    mem.write(0xFF11, 0x40);
+
+    // then: registers are cleared and ignore writes
+    EXPECT_EQ(mem.read(0xFF11), 0x3F);
+    EXPECT_EQ(mem.read(0xFF26), 0x70);
+    EXPECT_EQ(mem.read(0xFF30), 0x5A);
+}
+
+TEST_F(ApuTests, SynthesizesSquareWave)
+{
+    // given:
+    mem.get_apu().set_synthesis(48000, mem.get_clock());
+    play_channel_2();
+
+    // when: a second, synthesized a frame at a time
+    for (int frame = 0; frame < 64; frame++)
+    {
+        mem.advance_clock(CLOCKS_PER_SECOND / 64);
+        mem.get_apu().synthesize(mem.get_clock());
+    }
+
+    // then: stereo samples, crossing zero twice per period
+    const std::span<const int16_t> samples = mem.get_apu().get_samples();
+    EXPECT_EQ(samples.size(), 2 * 48000);
+    EXPECT_NEAR(crossings(samples), 2 * 512, 4);
+    EXPECT_EQ(samples[1000], samples[1001]);
+}
+
+TEST_F(ApuTests, AppliesQueuedWritesAtTheirTime)
+{
+    // given:
+    mem.get_apu().set_synthesis(48000, mem.get_clock());
+    play_channel_2();
+
+    // when: the channel is stopped halfway through and only synthesized afterwards
+    mem.advance_clock(CLOCKS_PER_SECOND / 2);
+    mem.write(0xFF17, 0x00); // nr22: dac off
+    mem.advance_clock(CLOCKS_PER_SECOND / 2);
+    mem.get_apu().synthesize(mem.get_clock());
+
+    // then: sound in the first half only
+    const std::span<const int16_t> samples = mem.get_apu().get_samples();
+    ASSERT_EQ(samples.size(), 2 * 48000);
+    EXPECT_NEAR(crossings(samples.first(48000)), 512, 4);
+    for (size_t i = 48000 + 2 * 4800; i < samples.size(); i++)
+        ASSERT_LT(std::abs(samples[i]), 64) << "sample " << i;
+}
+
+TEST_F(ApuTests, KeepsHarmonicsAboveNyquistFromAliasing)
+{
+    // given: a 16384 Hz square wave, whose third harmonic at 49152 Hz would fold back to 1152 Hz at 48 kHz
+    mem.get_apu().set_synthesis(48000, mem.get_clock());
+    mem.write(0xFF16, 0x80); // nr21: 50% duty
+    mem.write(0xFF17, 0xF0); // nr22
+    mem.write(0xFF18, 0xF8); // nr23: frequency 2040 is 131072 / 8 Hz
+    mem.write(0xFF19, 0x87); // nr24: trigger
+
+    // when:
+    mem.advance_clock(CLOCKS_PER_SECOND / 4);
+    mem.get_apu().synthesize(mem.get_clock());
+
+    // then: the alias is more than 60 dB below the tone
+    const std::span<const int16_t> samples = mem.get_apu().get_samples();
+    const double tone = amplitude(samples, 16384.0, 48000);
+    const double alias = amplitude(samples, 1152.0, 48000);
+    EXPECT_GT(tone, 4000.0);
+    EXPECT_LT(alias, tone / 1000.0);
+}
@@ -0,0 +1,86 @@
+#include <array>
+#include <audio_ring.h>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+TEST(AudioRingTests, WrapsAroundAndKeepsPairsTogether)
+{
+    // given:
+    gb::audio_ring ring{6};
+    ASSERT_EQ(ring.capacity(), 8u);
+
+    // when: more than fits
+    const std::array<int16_t, 10> samples = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    EXPECT_EQ(ring.write(samples), 8u);
+
+    // then: reads stop at a whole pair
+    std::array<int16_t, 3> out{};
+    EXPECT_EQ(ring.read(out), 2u);
+    EXPECT_EQ(out[0], 1);
+    EXPECT_EQ(out[1], 2);
+    EXPECT_EQ(ring.size(), 6u);
+
+    // when: around the end
+    EXPECT_EQ(ring.write(std::span(samples).subspan(8)), 2u);
+
+    // then:
+    std::array<int16_t, 8> rest{};
+    EXPECT_EQ(ring.read(rest), 8u);
+    EXPECT_EQ(rest, (std::array<int16_t, 8>{3, 4, 5, 6, 7, 8, 9, 10}));
+    EXPECT_EQ(ring.read(rest), 0u);
+}
+
+TEST(AudioRingTests, MovesEverySampleInOrderBetweenThreads)
+{
+    // given:
+    gb::audio_ring ring{256};
+    constexpr int16_t COUNT = 30000;
+
+    // when: a writer and a reader going at their own pace
+    std::thread writer{[&]
+    {
+        std::vector<int16_t> block;
+        for (int16_t next = 0; next < COUNT;)
+        {
+            block.clear();
+            for (int16_t i = 0; i < 64 && next + i < COUNT; i++)
+                block.push_back(static_cast<int16_t>(next + i));
+            const size_t count = ring.write(block);
+            next = static_cast<int16_t>(next + count);
+            if (count == 0)
+                std::this_thread::yield();
+        }
+    }};
+
+    std::vector<int16_t> received;
+    std::array<int16_t, 50> out{};
+    while (received.size() < COUNT)
+    {
+        const size_t count = ring.read(out);
+        received.insert(received.end(), out.begin(), out.begin() + static_cast<std::ptrdiff_t>(count));
+        if (count == 0)
+            std::this_thread::yield();
+    }
+    writer.join();
+
+    // then:
+    for (int16_t i = 0; i < COUNT; i++)
+        ASSERT_EQ(received[i], i);
+}
+
+TEST(AudioRingTests, RateFactorSteersTowardsTarget)
+{
+    // given:
+    gb::audio_ring ring{1024};
+    const std::vector<int16_t> samples(768, 0);
+
+    // then: running dry makes more samples, exactly on target changes nothing, too full makes fewer
+    EXPECT_DOUBLE_EQ(ring.rate_factor(512), 1.0 + gb::audio_ring::MAX_RATE_DEVIATION);
+    ring.write(std::span(samples).first(512));
+    EXPECT_DOUBLE_EQ(ring.rate_factor(512), 1.0);
+    ring.write(std::span(samples).first(256));
+    EXPECT_DOUBLE_EQ(ring.rate_factor(512), 1.0 - gb::audio_ring::MAX_RATE_DEVIATION / 2);
+}
@@ -0,0 +1,178 @@
+#include <atomic>
+#include <batch.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <input_movie.h>
+#include <joypad.h>
+#include <metrics.h>
+#include <stdexcept>
+#include "test_roms.h"
+#include <vector>
+#include <work_pool.h>
+#include <gtest/gtest.h>
+
+TEST(WorkPoolTests, RunsEveryTaskIncludingNestedOnes)
+{
+    // given:
+    gb::work_pool pool{4};
+    std::atomic<int> count{0};
+
+    // when: every task submits another from inside the pool
+    for (int i = 0; i < 100; i++)
+    {
+        pool.submit([&pool, &count]
+        {
+            count++;
+            pool.submit([&count] { count++; });
+        });
+    }
+    pool.wait();
+
+    // then:
+    EXPECT_EQ(pool.thread_count(), 4);
+    EXPECT_EQ(count.load(), 200);
+}
+
+class BatchTests : public ::testing::Test
+{
+public:
+    std::filesystem::path dir;
+
+    void SetUp() override
+    {
+        dir = std::filesystem::temp_directory_path() /
+              ("gbemu_batch_" + std::string{::testing::UnitTest::GetInstance()->current_test_info()->name()});
+        std::filesystem::create_directories(dir);
+
+        // spins on jr -2 once the boot rom hands over
+        const uint8_t program[] = {0x18, 0xFE};
+        const auto rom = test_roms::make_rom(program);
+        std::ofstream{dir / "loop.gb", std::ios::binary}.write(reinterpret_cast<const char*>(rom->data()),
+                                                               static_cast<std::streamsize>(rom->size()));
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir);
+    }
+
+    void write_manifest(const std::string& contents) const
+    {
+        std::ofstream{dir / "jobs.txt"} << contents;
+    }
+};
+
+TEST_F(BatchTests, IdenticalJobsGiveIdenticalResults)
+{
+    // given:
+    write_manifest("# rom movie frames\n"
+                   "loop.gb - 3\n"
+                   "\n"
+                   "\"loop.gb\" - 3\n"
+                   "loop.gb - 3\n"
+                   "missing.gb - 3\n");
+
+    // when:
+    const std::vector<gb::batch_job> jobs = gb::load_manifest(dir / "jobs.txt");
+    const gb::batch_summary summary = gb::run_batch(jobs, 2);
+
+    // then: one failed rom doesn't take the others with it
+    ASSERT_EQ(summary.results.size(), 4);
+    EXPECT_EQ(summary.threads, 2);
+    EXPECT_EQ(summary.frames, 9);
+    for (size_t i = 0; i < 3; i++)
+    {
+        EXPECT_TRUE(summary.results[i].ok) << summary.results[i].error;
+        EXPECT_GT(summary.results[i].cycles, 0);
+        EXPECT_EQ(summary.results[i].framebuffer_hash, summary.results[0].framebuffer_hash);
+        EXPECT_EQ(summary.results[i].state_hash, summary.results[0].state_hash);
+        EXPECT_EQ(summary.results[i].pc, summary.results[0].pc);
+    }
+    EXPECT_FALSE(summary.results[3].ok);
+    EXPECT_FALSE(summary.results[3].error.empty());
+}
+
+TEST_F(BatchTests, MalformedManifestThrows)
+{
+    // given:
+    write_manifest("loop.gb -\n");
+
+    // when/then:
+    EXPECT_THROW(gb::load_manifest(dir / "jobs.txt"), std::runtime_error);
+}
+
+TEST_F(BatchTests, PlaysInputMovies)
+{
+    // given:
+    gb::input_movie movie{};
+    for (int frame = 0; frame < 3; frame++)
+        movie.add_frame(gb::joypad::LEFT | gb::joypad::A);
+    movie.save(dir / "left.gbm");
+    std::ofstream{dir / "broken.gbm"} << "not a movie";
+
+    write_manifest("loop.gb left.gbm 3\n"
+                   "loop.gb broken.gbm 3\n"
+                   "loop.gb missing.gbm 3\n"
+                   "loop.gb - 3\n"
+                   "loop.gb left.gbm 3\n");
+
+    // when:
+    const gb::batch_summary summary = gb::run_batch(gb::load_manifest(dir / "jobs.txt"), 2);
+
+    // then: bad movies fail their own job only
+    ASSERT_EQ(summary.results.size(), 5);
+    EXPECT_TRUE(summary.results[0].ok) << summary.results[0].error;
+    EXPECT_EQ(summary.results[0].frames, 3);
+    EXPECT_FALSE(summary.results[1].ok);
+    EXPECT_FALSE(summary.results[1].error.empty());
+    EXPECT_FALSE(summary.results[2].ok);
+
+    // then: the buttons reached the console, the same movie gives the same state and no movie a different one
+    ASSERT_TRUE(summary.results[3].ok) << summary.results[3].error;
+    ASSERT_TRUE(summary.results[4].ok) << summary.results[4].error;
+    EXPECT_NE(summary.results[0].state_hash, summary.results[3].state_hash);
+    EXPECT_EQ(summary.results[0].state_hash, summary.results[4].state_hash);
+}
+
+TEST_F(BatchTests, SkippingFramesKeepsTheResults)
+{
+    // given:
+    write_manifest("loop.gb - 30\n");
+    const std::vector<gb::batch_job> jobs = gb::load_manifest(dir / "jobs.txt");
+
+    // when:
+    const gb::batch_summary all = gb::run_batch(jobs, 1);
+    const gb::batch_summary none = gb::run_batch(jobs, 1, ppu_render_policy::none);
+    const gb::batch_summary some = gb::run_batch(jobs, 1, ppu_render_policy::every_nth, 7);
+
+    // then:
+    for (const gb::batch_summary* summary : {&none, &some})
+    {
+        ASSERT_TRUE(summary->results[0].ok) << summary->results[0].error;
+        EXPECT_EQ(summary->results[0].cycles, all.results[0].cycles);
+        EXPECT_EQ(summary->results[0].framebuffer_hash, all.results[0].framebuffer_hash);
+        EXPECT_EQ(summary->results[0].pc, all.results[0].pc);
+    }
+}
+
+TEST_F(BatchTests, CountsMetricsWhileRunning)
+{
+    // given:
+    write_manifest("loop.gb - 10\n"
+                   "loop.gb - 20\n"
+                   "missing.gb - 5\n");
+    const std::vector<gb::batch_job> jobs = gb::load_manifest(dir / "jobs.txt");
+    gb::metrics_registry metrics;
+
+    // when:
+    const gb::batch_summary summary = gb::run_batch(jobs, 2, ppu_render_policy::none, 1, &metrics);
+
+    // then: the last frame of a job is always drawn
+    EXPECT_EQ(metrics.counter("frames").value(), 30);
+    EXPECT_EQ(metrics.counter("frames_not_drawn").value(), 28);
+    EXPECT_EQ(metrics.counter("emulated_cycles").value(), summary.results[0].cycles + summary.results[1].cycles);
+    EXPECT_EQ(metrics.counter("jobs_done").value(), 2);
+    EXPECT_EQ(metrics.counter("jobs_failed").value(), 1);
+    EXPECT_EQ(metrics.histogram("frame_time_us").count(), 30);
+}
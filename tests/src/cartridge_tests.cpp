@@ -0,0 +1,346 @@
+#include <battery_ram.h>
+#include <cartridge.h>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory_map.h>
+#include <string>
+#include <gtest/gtest.h>
+
+namespace
+{
+    // builds a rom where the first two bytes of every bank hold its bank number
+    gb::rom_image make_rom(uint8_t cart_type, size_t num_banks, uint8_t ram_size)
+    {
+        std::vector<uint8_t> rom(num_banks * ROM_BANK_SIZE, 0);
+        for (size_t bank = 0; bank < num_banks; bank++)
+        {
+            rom[bank * ROM_BANK_SIZE] = static_cast<uint8_t>(bank);
+            rom[bank * ROM_BANK_SIZE + 1] = static_cast<uint8_t>(bank >> 8);
+        }
+        rom[gb::cartridge::HEADER_TYPE_ADDR] = cart_type;
+        rom[gb::cartridge::HEADER_RAM_SIZE_ADDR] = ram_size;
+        return std::make_shared<const std::vector<uint8_t>>(std::move(rom));
+    }
+}
+
+class CartridgeTests : public ::testing::Test
+{
+public:
+    gb::memory_map mem{};
+
+    void SetUp() override
+    {
+        mem.skip_boot_rom();
+    }
+};
+
+TEST_F(CartridgeTests, MBC1_UpperRomBitsAndBankingModeWork)
+{
+    // given: 2 MB MBC1+RAM+BATTERY, 32 KB RAM
+    mem.load_rom(make_rom(0x03, 128, 0x03));
+
+    // when: bank 0x25 = upper bits 0b01, lower bits 0b00101
+    mem.write(0x2000, 0x05);
+    mem.write(0x4000, 0x01);
+
+    // then:
+    EXPECT_EQ(mem.read(0x4000), 0x25);
+    EXPECT_EQ(mem.read(0x0000), 0x00);
+
+    // when: mode 1 also banks 0x0000-0x3FFF
+    mem.write(0x6000, 0x01);
+
+    // then:
+    EXPECT_EQ(mem.read(0x0000), 0x20);
+    EXPECT_TRUE(mem.get_cartridge().has_battery());
+}
+
+TEST_F(CartridgeTests, MBC1_BankZeroMapsToOneAndBanksWrapAround)
+{
+    // given: 256 KB MBC1
+    mem.load_rom(make_rom(0x01, 16, 0x00));
+
+    // when:
+    mem.write(0x2000, 0x00);
+
+    // then:
+    EXPECT_EQ(mem.read(0x4000), 0x01);
+
+    // when: bank 0x13 doesn't exist on a 16 bank rom
+    mem.write(0x2000, 0x13);
+
+    // then:
+    EXPECT_EQ(mem.read(0x4000), 0x03);
+}
+
+TEST_F(CartridgeTests, MBC1_RamNeedsEnablingAndIsBanked)
+{
+    // given:
+    mem.load_rom(make_rom(0x03, 4, 0x03));
+
+    // when: disabled ram reads open bus and ignores writes
+    mem.write(0xA000, 0x12);
+
+    // then:
+    EXPECT_EQ(mem.read(0xA000), 0xFF);
+
+    // when:
+    mem.write(0x0000, 0x0A);
+    mem.write(0x6000, 0x01);
+    mem.write(0x4000, 0x02);
+    mem.write(0xA000, 0x34);
+    mem.write(0x4000, 0x00);
+    mem.write(0xA000, 0x56);
+
+    // then:
+    EXPECT_EQ(mem.read(0xA000), 0x56);
+    mem.write(0x4000, 0x02);
+    EXPECT_EQ(mem.read(0xA000), 0x34);
+}
+
+TEST_F(CartridgeTests, MBC2_RamIsFourBitsAndMirrored)
+{
+    // given:
+    mem.load_rom(make_rom(0x06, 16, 0x00));
+
+    // when: address bit 8 selects the rom bank register
+    mem.write(0x2100, 0x07);
+    mem.write(0x0000, 0x0A);
+    mem.write(0xA001, 0x3C);
+
+    // then:
+    EXPECT_EQ(mem.read(0x4000), 0x07);
+    EXPECT_EQ(mem.read(0xA001), 0xFC);
+    EXPECT_EQ(mem.read(0xA201), 0xFC);
+}
+
+TEST_F(CartridgeTests, MBC3_RtcIsComputedFromEmulatedCycles)
+{
+    // given: MBC3+TIMER+RAM+BATTERY
+    mem.load_rom(make_rom(0x10, 8, 0x03));
+    mem.write(0x0000, 0x0A);
+
+    // when: 1 day, 1 hour, 1 minute and 1 second of emulated time pass
+    for (int second = 0; second < 86400 + 3600 + 60 + 1; second++)
+        mem.advance_clock(gb::cartridge::RTC_CYCLES_PER_SECOND);
+    mem.write(0x6000, 0x00);
+    mem.write(0x6000, 0x01);
+
+    // then:
+    mem.write(0x4000, 0x08);
+    EXPECT_EQ(mem.read(0xA000), 1);
+    mem.write(0x4000, 0x09);
+    EXPECT_EQ(mem.read(0xA000), 1);
+    mem.write(0x4000, 0x0A);
+    EXPECT_EQ(mem.read(0xA000), 1);
+    mem.write(0x4000, 0x0B);
+    EXPECT_EQ(mem.read(0xA000), 1);
+
+    // when: halting and writing the seconds register freezes the clock at that value
+    mem.write(0x4000, 0x0C);
+    mem.write(0xA000, 0x40);
+    mem.write(0x4000, 0x08);
+    mem.write(0xA000, 30);
+    mem.advance_clock(100 * gb::cartridge::RTC_CYCLES_PER_SECOND);
+    mem.write(0x6000, 0x00);
+    mem.write(0x6000, 0x01);
+
+    // then:
+    EXPECT_EQ(mem.read(0xA000), 30);
+}
+
+TEST_F(CartridgeTests, MBC5_NineBitRomBankAndBankZeroWork)
+{
+    // given: 8 MB MBC5
+    mem.load_rom(make_rom(0x19, 512, 0x00));
+
+    // when:
+    mem.write(0x2000, 0x00);
+
+    // then: mbc5 can map bank 0 into the switchable window
+    EXPECT_EQ(mem.read(0x4000), 0x00);
+
+    // when:
+    mem.write(0x2000, 0x05);
+    mem.write(0x3000, 0x01);
+
+    // then: bank 0x105
+    EXPECT_EQ(mem.read(0x4000), 0x05);
+    EXPECT_EQ(mem.read(0x4001), 0x01);
+    mem.write(0x3000, 0x00);
+    EXPECT_EQ(mem.read(0x4001), 0x00);
+}
+
+class BatterySaveTests : public ::testing::Test
+{
+public:
+    std::filesystem::path rom_path;
+    std::filesystem::path sav_path;
+
+    void SetUp() override
+    {
+        const auto dir = std::filesystem::temp_directory_path();
+        const auto name = std::string{"gbemu_"} + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        rom_path = dir / (name + ".gb");
+        sav_path = dir / (name + ".sav");
+        std::filesystem::remove(sav_path);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(rom_path);
+        std::filesystem::remove(sav_path);
+    }
+
+    void write_rom(uint8_t cart_type, uint8_t ram_size)
+    {
+        const gb::rom_image rom = make_rom(cart_type, 4, ram_size);
+        std::ofstream rom_file(rom_path, std::ios::binary);
+        rom_file.write(reinterpret_cast<const char*>(rom->data()), static_cast<std::streamsize>(rom->size()));
+    }
+};
+
+TEST_F(BatterySaveTests, RamPersistsAcrossInstances)
+{
+    // given: MBC1+RAM+BATTERY, 32 KB RAM
+    write_rom(0x03, 0x03);
+    {
+        gb::memory_map mem{};
+        mem.load_rom(rom_path);
+        mem.write(0x0000, 0x0A);
+        mem.write(0x6000, 0x01);
+        mem.write(0x4000, 0x03);
+
+        // when:
+        mem.write(0xA123, 0x42);
+    }
+
+    // then: the save holds the whole ram, and a new instance reads it back
+    EXPECT_EQ(std::filesystem::file_size(sav_path), 4 * RAM_BANK_SIZE);
+
+    gb::memory_map mem{};
+    mem.load_rom(rom_path);
+    EXPECT_TRUE(mem.get_cartridge().is_save_attached());
+    mem.write(0x0000, 0x0A);
+    mem.write(0x6000, 0x01);
+    mem.write(0x4000, 0x03);
+    EXPECT_EQ(mem.read(0xA123), 0x42);
+}
+
+TEST_F(BatterySaveTests, RtcIsStoredInSaveFooter)
+{
+    // given: MBC3+TIMER+RAM+BATTERY, 8 KB RAM
+    write_rom(0x10, 0x02);
+    {
+        gb::memory_map mem{};
+        mem.load_rom(rom_path);
+        mem.write(0x0000, 0x0A);
+
+        // when: halted at 0 days, 5 hours
+        mem.write(0x4000, 0x0C);
+        mem.write(0xA000, 0x40);
+        mem.write(0x4000, 0x0A);
+        mem.write(0xA000, 5);
+    }
+
+    // then:
+    EXPECT_EQ(std::filesystem::file_size(sav_path), RAM_BANK_SIZE + 48);
+
+    gb::memory_map mem{};
+    mem.load_rom(rom_path);
+    mem.write(0x0000, 0x0A);
+    mem.write(0x6000, 0x00);
+    mem.write(0x6000, 0x01);
+    mem.write(0x4000, 0x0A);
+    EXPECT_EQ(mem.read(0xA000), 5);
+}
+
+TEST_F(BatterySaveTests, ForksShareRamBanksAndNeverWriteTheSave)
+{
+    // given: MBC5+RAM+BATTERY, 32 KB RAM
+    write_rom(0x1B, 0x03);
+    gb::memory_map mem{};
+    mem.load_rom(rom_path);
+    mem.write(0x0000, 0x0A);
+    mem.write(0xA000, 0x11);
+
+    // when:
+    gb::memory_map child = mem.fork();
+
+    // then: every bank is shared, and only the original is attached to the save
+    EXPECT_EQ(mem.get_cartridge().shared_ram_bank_count(), 4);
+    EXPECT_EQ(child.get_cartridge().shared_ram_bank_count(), 4);
+    EXPECT_FALSE(child.get_cartridge().is_save_attached());
+    EXPECT_EQ(child.read(0xA000), 0x11);
+
+    // when: each side writes to bank 0
+    child.write(0xA000, 0x22);
+    mem.write(0xA001, 0x33);
+    child.flush_save();
+    mem.flush_save();
+
+    // then: each copied just that bank, and the save only holds the original's writes
+    EXPECT_EQ(mem.get_cartridge().shared_ram_bank_count(), 3);
+    EXPECT_EQ(child.get_cartridge().shared_ram_bank_count(), 3);
+    EXPECT_EQ(mem.read(0xA000), 0x11);
+    EXPECT_EQ(child.read(0xA000), 0x22);
+    EXPECT_EQ(child.read(0xA001), 0x00);
+
+    std::ifstream save_file(sav_path, std::ios::binary);
+    std::array<char, 2> saved {};
+    save_file.read(saved.data(), saved.size());
+    EXPECT_EQ(saved[0], 0x11);
+    EXPECT_EQ(saved[1], 0x33);
+}
+
+TEST_F(BatterySaveTests, HeapFallbackWritesOnlyDirtyPages)
+{
+    // given: heap backed ram over an existing save
+    std::ofstream{sav_path, std::ios::binary} << std::string(RAM_BANK_SIZE, '\xAA');
+    gb::battery_ram ram{RAM_BANK_SIZE, 0};
+    EXPECT_EQ(ram.attach(sav_path, 0, false), RAM_BANK_SIZE);
+    EXPECT_FALSE(ram.is_mapped());
+    ram.flush();
+
+    // when: the file changes behind its back, then a few bytes in two pages are written and flushed
+    std::ofstream{sav_path, std::ios::binary} << std::string(RAM_BANK_SIZE, '\x55');
+    for (const size_t offset : {0x010, 0x011, 0x1234})
+    {
+        ram.data()[offset] = 0x42;
+        ram.mark_dirty(offset);
+    }
+    ram.flush();
+
+    // then: the two dirty pages are written whole, the rest of the file is left alone
+    std::ifstream save_file{sav_path, std::ios::binary};
+    const std::string saved{std::istreambuf_iterator<char>{save_file}, {}};
+    ASSERT_EQ(saved.size(), RAM_BANK_SIZE);
+    for (size_t offset = 0; offset < RAM_BANK_SIZE; offset++)
+    {
+        const size_t page = offset / gb::battery_ram::PAGE_SIZE;
+        char expected = page == 0x00 || page == 0x12 ? '\xAA' : '\x55';
+        if (offset == 0x010 || offset == 0x011 || offset == 0x1234)
+            expected = 0x42;
+        ASSERT_EQ(saved[offset], expected) << "offset " << offset;
+    }
+}
+
+TEST_F(BatterySaveTests, CartridgesWithoutBatteryDontCreateSaves)
+{
+    // given: MBC1+RAM
+    write_rom(0x02, 0x02);
+
+    // when:
+    {
+        gb::memory_map mem{};
+        mem.load_rom(rom_path);
+        mem.write(0x0000, 0x0A);
+        mem.write(0xA000, 0x42);
+        mem.flush_save();
+    }
+
+    // then:
+    EXPECT_FALSE(std::filesystem::exists(sav_path));
+}
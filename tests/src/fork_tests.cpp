@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <gameboy.h>
+#include <memory>
+#include <memory_map.h>
+#include "test_roms.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+class ForkTests : public ::testing::Test
+{
+public:
+    gb::memory_map mem{};
+
+    void SetUp() override
+    {
+        mem.skip_boot_rom();
+    }
+};
+
+TEST_F(ForkTests, ForkSharesPagesUntilWritten)
+{
+    // given:
+    mem.write(0x8010, 0x11);
+    mem.write(0xC123, 0x22);
+    mem.write(0xD456, 0x33);
+
+    // when:
+    gb::memory_map child = mem.fork();
+
+    // then: everything is shared and visible to both
+    EXPECT_EQ(mem.shared_page_count(), 4);
+    EXPECT_EQ(child.shared_page_count(), 4);
+    EXPECT_EQ(child.read(0x8010), 0x11);
+    EXPECT_EQ(child.read(0xC123), 0x22);
+    EXPECT_EQ(child.read(0xE123), 0x22);
+
+    // when: each side writes to a different page
+    child.write(0xC123, 0x44);
+    mem.write(0xD456, 0x55);
+
+    // then: each map copied only the page it wrote to, and neither write leaks into the other map
+    EXPECT_EQ(mem.shared_page_count(), 3);
+    EXPECT_EQ(child.shared_page_count(), 3);
+    EXPECT_EQ(mem.read(0xC123), 0x22);
+    EXPECT_EQ(child.read(0xC123), 0x44);
+    EXPECT_EQ(child.read(0xE123), 0x44);
+    EXPECT_EQ(mem.read(0xD456), 0x55);
+    EXPECT_EQ(child.read(0xD456), 0x33);
+}
+
+TEST_F(ForkTests, PageIsCopiedOnceEvenIfTheForkIsGone)
+{
+    // given:
+    {
+        gb::memory_map child = mem.fork();
+        child.write(0x9000, 0x01);
+    }
+
+    // when:
+    mem.write(0x9000, 0x02);
+    mem.write(0xF000, 0x03); // echo of 0xD000, which never has a direct page
+
+    // then: the written pages are owned again, the other two stay shared until written
+    EXPECT_EQ(mem.shared_page_count(), 2);
+    EXPECT_EQ(mem.read(0x9000), 0x02);
+    EXPECT_EQ(mem.read(0xD000), 0x03);
+}
+
+TEST_F(ForkTests, CopiesOwnTheirPagesAndRomIsAlwaysShared)
+{
+    // given:
+    auto rom = std::make_shared<std::vector<uint8_t>>(0x8000, 0x00);
+    (*rom)[0x4000] = 0x77;
+    mem.load_rom(gb::rom_image{rom});
+
+    // when:
+    gb::memory_map copy = mem;
+    gb::memory_map child = mem.fork();
+
+    // then:
+    EXPECT_EQ(copy.shared_page_count(), 0);
+    EXPECT_EQ(child.get_cartridge().rom().get(), rom.get());
+    EXPECT_EQ(child.read(0x4000), 0x77);
+}
+
+TEST(GameboyForkTests, ForksRunIndependentlyFromTheSameState)
+{
+    // given: a rom that spins on jr -2
+    const uint8_t program[] = {0x18, 0xFE};
+    gb::gameboy parent{test_roms::make_rom(program)};
+    test_roms::start(parent);
+    parent.run_frame();
+
+    // when:
+    gb::gameboy child = parent.fork();
+    parent.run_frame();
+    child.run_frame();
+
+    // then: both reach the same state
+    EXPECT_EQ(test_roms::snapshot(parent), test_roms::snapshot(child));
+
+    // when: the child diverges
+    child.mem.write(0xC000, 0x99);
+    child.cpu.BC.full = 0x1234;
+
+    // then:
+    EXPECT_EQ(parent.mem.read(0xC000), 0x00);
+    EXPECT_EQ(parent.cpu.BC.full, parent.cpu.get_r16<gb::cpu::r16::BC>().full);
+    EXPECT_EQ(child.cpu.get_r16<gb::cpu::r16::BC>().full, 0x1234);
+}
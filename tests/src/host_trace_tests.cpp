@@ -0,0 +1,94 @@
+#include <gameboy.h>
+#include <host_trace.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+
+class HostTraceTests : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        gb::host_trace::clear();
+    }
+
+    void TearDown() override
+    {
+        gb::host_trace::stop();
+        gb::host_trace::clear();
+    }
+
+    static std::string export_json()
+    {
+        std::ostringstream json;
+        gb::host_trace::write_json(json);
+        return json.str();
+    }
+};
+
+TEST_F(HostTraceTests, RecordsScopesPerThread)
+{
+    // given:
+    gb::host_trace::start();
+
+    // when:
+    {
+        const gb::trace_scope scope{"outer"};
+        std::thread worker{[]
+        {
+            gb::host_trace::set_thread_name("worker \"1\"");
+            const gb::trace_scope inner{"inner"};
+        }};
+        worker.join();
+    }
+    gb::host_trace::stop();
+    {
+        const gb::trace_scope ignored{"after stop"};
+    }
+
+    // then:
+    const std::string json = export_json();
+    EXPECT_TRUE(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    EXPECT_NE(json.find(R"({"name":"outer","ph":"X")"), std::string::npos);
+    EXPECT_NE(json.find(R"({"name":"inner","ph":"X")"), std::string::npos);
+    EXPECT_NE(json.find(R"("args":{"name":"worker \"1\""})"), std::string::npos);
+    EXPECT_EQ(json.find("after stop"), std::string::npos);
+    EXPECT_EQ(gb::host_trace::dropped(), 0);
+}
+
+TEST_F(HostTraceTests, FlushesTotalsAsCounters)
+{
+    // given:
+    gb::host_trace::start();
+
+    // when:
+    for (int i = 0; i < 100; i++)
+        const gb::trace_total_scope scope{gb::trace_total::cpu_execute};
+    gb::host_trace::flush_totals();
+    gb::host_trace::stop();
+
+    // then: one counter per total
+    const std::string json = export_json();
+    EXPECT_NE(json.find(R"({"name":"cpu::execute","ph":"C")"), std::string::npos);
+    EXPECT_NE(json.find(R"({"name":"ppu::tick","ph":"C")"), std::string::npos);
+}
+
+TEST_F(HostTraceTests, EmulationIsTraced)
+{
+    if constexpr (!gb::host_trace::ENABLED)
+        GTEST_SKIP() << "built without GB_TRACE";
+
+    // given:
+    gb::gameboy gb{};
+    gb::host_trace::start();
+
+    // when:
+    gb.run_frame();
+    gb::host_trace::stop();
+
+    // then:
+    const std::string json = export_json();
+    EXPECT_NE(json.find(R"({"name":"gameboy::run_frame","ph":"X")"), std::string::npos);
+    EXPECT_NE(json.find(R"({"name":"cpu::execute","ph":"C")"), std::string::npos);
+}
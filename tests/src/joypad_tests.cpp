@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gameboy.h>
+#include <input_movie.h>
+#include <joypad.h>
+#include <memory_map.h>
+#include <memory>
+#include <stdexcept>
+#include "test_roms.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+TEST(JoypadTests, ReadsPressedButtonsOnTheSelectedRows)
+{
+    // given:
+    gb::joypad pad{};
+    EXPECT_FALSE(pad.set_buttons(gb::joypad::RIGHT | gb::joypad::START));
+
+    // then: nothing selected reads all lines high
+    EXPECT_EQ(pad.read(), 0xFF);
+
+    // when/then: the directions
+    EXPECT_TRUE(pad.write(0x20));
+    EXPECT_EQ(pad.read(), 0xEE);
+
+    // when/then: the buttons
+    EXPECT_TRUE(pad.write(0x10));
+    EXPECT_EQ(pad.read(), 0xD7);
+
+    // when/then: both rows share the lines
+    EXPECT_TRUE(pad.write(0x00));
+    EXPECT_EQ(pad.read(), 0xC6);
+}
+
+TEST(JoypadTests, RequestsTheInterruptWhenALineGoesLow)
+{
+    // given:
+    gb::memory_map mem{};
+    mem.write(gb::joypad::ADDRESS, 0x10);
+    mem.write(IF_REG, 0x00);
+
+    // when: a direction, its row isn't selected
+    mem.set_buttons(gb::joypad::DOWN);
+
+    // then:
+    EXPECT_EQ(mem.read(IF_REG) & INTERRUPT_JOYPAD, 0);
+
+    // when: a button
+    mem.set_buttons(gb::joypad::DOWN | gb::joypad::B);
+
+    // then:
+    EXPECT_EQ(mem.read(IF_REG) & INTERRUPT_JOYPAD, INTERRUPT_JOYPAD);
+    EXPECT_EQ(mem.read(gb::joypad::ADDRESS), 0xDD);
+
+    // when: the row with the direction held is selected
+    mem.write(IF_REG, 0x00);
+    mem.write(gb::joypad::ADDRESS, 0x20);
+
+    // then:
+    EXPECT_EQ(mem.read(IF_REG) & INTERRUPT_JOYPAD, INTERRUPT_JOYPAD);
+    EXPECT_EQ(mem.read(gb::joypad::ADDRESS), 0xE7);
+}
+
+TEST(JoypadTests, InputMovieRoundTrips)
+{
+    // given:
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "gbemu_movie_round_trip.gbm";
+    gb::input_movie movie{};
+    for (uint32_t frame = 0; frame < 300; frame++)
+        movie.add_frame(static_cast<uint8_t>(frame * 7));
+
+    // when:
+    movie.save(path);
+    const gb::input_movie loaded{path};
+
+    // then: nothing is held past the end
+    ASSERT_EQ(loaded.frame_count(), 300u);
+    for (uint32_t frame = 0; frame < 300; frame++)
+        EXPECT_EQ(loaded.get_buttons(frame), static_cast<uint8_t>(frame * 7));
+    EXPECT_EQ(loaded.get_buttons(300), 0);
+
+    // when: cut short
+    std::filesystem::resize_file(path, sizeof(gb::input_movie_header) + 10);
+
+    // then:
+    EXPECT_THROW(gb::input_movie{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(JoypadTests, InputMovieCountIsCheckedAgainstTheFile)
+{
+    // given: a header that claims the most frames it can, with hashes, in front of 10 bytes
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "gbemu_movie_bad_count.gbm";
+    gb::input_movie_header header{};
+    header.magic = gb::INPUT_MOVIE_MAGIC;
+    header.version = gb::INPUT_MOVIE_VERSION;
+    header.flags = gb::INPUT_MOVIE_HASHES;
+    header.frame_count = UINT32_MAX;
+    {
+        std::ofstream file{path, std::ios::binary};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write("0123456789", 10);
+    }
+
+    // then: reported like any other short file, rather than allocating for it
+    EXPECT_THROW(gb::input_movie{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(JoypadTests, MoviePlaysIntoTheProgram)
+{
+    // given: a rom that selects both rows and keeps reading the lines into a
+    const uint8_t program[] = {0xEA, 0x00, 0xFF, 0xFA, 0x00, 0xFF, 0x18, 0xF8};
+    gb::gameboy gb{test_roms::make_rom(program)};
+    test_roms::start(gb);
+    gb.cpu.AF.full = 0x0000;
+
+    gb::input_movie movie{};
+    movie.add_frame(0);
+    movie.add_frame(gb::joypad::LEFT | gb::joypad::A);
+    movie.add_frame(gb::joypad::DOWN);
+
+    // when/then:
+    const uint8_t expected[] = {0xCF, 0xCC, 0xC7, 0xCF};
+    for (uint64_t frame = 0; frame < 4; frame++)
+    {
+        gb.mem.set_buttons(movie.get_buttons(frame));
+        gb.run_frame();
+        EXPECT_EQ(gb.cpu.AF.full >> 8, expected[frame]) << "frame " << frame;
+    }
+}
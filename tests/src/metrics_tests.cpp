@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstdint>
+#include <metrics.h>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+
+TEST(MetricsTests, HistogramBucketsStayWithinAnEighth)
+{
+    // every bucket starts right after the previous one ends, and is at most an 8th of its values wide
+    uint64_t next = 0;
+    for (size_t i = 0; i < gb::metric_histogram::BUCKET_COUNT; i++)
+    {
+        const uint64_t limit = gb::metric_histogram::bucket_limit(i);
+        ASSERT_EQ(gb::metric_histogram::bucket_index(next), i);
+        ASSERT_EQ(gb::metric_histogram::bucket_index(limit), i);
+        ASSERT_LE(limit - next, next / 8);
+        next = limit + 1;
+    }
+    EXPECT_EQ(next, 0); // wrapped around past UINT64_MAX
+}
+
+TEST(MetricsTests, HistogramPercentiles)
+{
+    // given:
+    gb::metric_histogram histogram;
+
+    // when: 1 to 1000
+    for (uint64_t value = 1; value <= 1000; value++)
+        histogram.record(value);
+
+    // then: within a bucket of the exact values
+    const gb::histogram_summary summary = histogram.summary();
+    EXPECT_EQ(summary.count, 1000);
+    EXPECT_DOUBLE_EQ(summary.mean, 500.5);
+    EXPECT_GE(summary.p50, 500);
+    EXPECT_LE(summary.p50, 500 + 500 / 8);
+    EXPECT_GE(summary.p99, 990);
+    EXPECT_LE(summary.p99, 1000);
+    EXPECT_EQ(summary.max, 1000);
+    EXPECT_EQ(gb::metric_histogram{}.percentile(0.5), 0);
+}
+
+TEST(MetricsTests, ReporterWritesJsonLines)
+{
+    // given:
+    gb::metrics_registry registry;
+    gb::metric_counter& frames = registry.counter("frames");
+    registry.histogram("frame_time_us").record(400);
+    std::ostringstream out;
+
+    // when: a reporter that never gets to its interval, only its last line
+    {
+        gb::metrics_reporter reporter{registry, out, std::chrono::hours{1}};
+        frames.add(60);
+        reporter.report();
+        frames.add(30);
+    }
+
+    // then:
+    std::istringstream lines{out.str()};
+    std::string first, last, none;
+    ASSERT_TRUE(std::getline(lines, first));
+    ASSERT_TRUE(std::getline(lines, last));
+    EXPECT_FALSE(std::getline(lines, none));
+    EXPECT_TRUE(first.starts_with("{\"seconds\":"));
+    EXPECT_NE(first.find("\"frames\":60,\"frames_per_second\":"), std::string::npos);
+    EXPECT_NE(first.find(R"("frame_time_us":{"count":1,"mean":400.000,"p50":400,"p90":400,"p99":400,"max":400})"),
+              std::string::npos);
+    EXPECT_NE(last.find("\"frames\":90,"), std::string::npos);
+    EXPECT_TRUE(last.ends_with("}"));
+    EXPECT_EQ(&registry.counter("frames"), &frames);
+}
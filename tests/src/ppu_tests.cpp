@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <hash.h>
+#include <memory>
+#include <memory_map.h>
+#include <ppu.h>
+#include <span>
+#include <triple_buffer.h>
+#include <gtest/gtest.h>
+
+class PpuTests : public ::testing::Test
+{
+public:
+    gb::memory_map mem{};
+    gb::ppu ppu{};
+
+    void SetUp() override
+    {
+        mem.skip_boot_rom();
+        mem.write(0xFF40, 0x91); // lcdc: lcd, unsigned tiles and background, map at 0x9800 is all tile 0
+        mem.write(0xFF42, 0); // scy
+        mem.write(0xFF43, 0); // scx
+
+        // every row of tile 0 is color ids 0, 1, 2, 3, 0, 1, 2, 3
+        for (uint16_t address = 0x8000; address < 0x8010; address += 2)
+        {
+            mem.write(address, 0x55);
+            mem.write(address + 1, 0x33);
+        }
+    }
+
+    // two frames, line 0 is only drawn once the first frame wraps around
+    void run_frames()
+    {
+        while (ppu.get_frame_count() < 2)
+            ppu.tick(4, mem);
+    }
+
+    void run_frame()
+    {
+        const uint64_t frame = ppu.get_frame_count();
+        while (ppu.get_frame_count() == frame)
+            ppu.tick(4, mem);
+    }
+
+    // runs until the given line is drawn
+    void run_line(int line)
+    {
+        while (mem.read(0xFF44) != line) // ly
+            ppu.tick(4, mem);
+        while (mem.read(0xFF44) == line)
+            ppu.tick(4, mem);
+    }
+
+    static uint8_t pixel(std::span<const uint8_t> shades, int x, int y)
+    {
+        return (shades[y * gb::ppu::PACKED_LINE_SIZE + x / 4] >> (x % 4 * 2)) & 0x03;
+    }
+
+    // scrolled background, window and sprites, all of which both renderers draw the same way
+    static void setup_scene(gb::memory_map& mem)
+    {
+        mem.skip_boot_rom();
+        mem.write(0xFF40, 0xF3); // lcdc: lcd, window map at 0x9C00, window, unsigned tiles, sprites, background
+        mem.write(0xFF42, 21); // scy
+        mem.write(0xFF43, 13); // scx
+        mem.write(0xFF4A, 90); // wy
+        mem.write(0xFF4B, 87); // wx
+        mem.write(0xFF47, 0xE4); // bgp
+        mem.write(0xFF48, 0xD2); // obp0
+        mem.write(0xFF49, 0x1B); // obp1
+
+        for (uint16_t address = 0x8000; address < 0x8100; address++) // tiles 0-15
+            mem.write(address, static_cast<uint8_t>(address * 29 + 7));
+        for (uint16_t i = 0; i < 0x400; i++)
+        {
+            mem.write(0x9800 + i, static_cast<uint8_t>(i * 7 % 16));
+            mem.write(0x9C00 + i, static_cast<uint8_t>(i * 3 % 16));
+        }
+
+        // sprites apart from each other and the screen edges, flipped and with either palette
+        constexpr uint8_t attributes[] = {0x00, 0x10, 0x20, 0x40, 0x30};
+        for (uint8_t i = 0; i < 5; i++)
+        {
+            mem.write(0xFE00 + i * 4, 30 + i * 20); // y
+            mem.write(0xFE01 + i * 4, 20 + i * 30); // x
+            mem.write(0xFE02 + i * 4, i); // tile
+            mem.write(0xFE03 + i * 4, attributes[i]);
+        }
+        for (uint16_t address = 0xFE14; address < 0xFEA0; address++)
+            mem.write(address, 0); // the rest off screen
+    }
+
+    static gb::ppu::line_mask lines(int first, int count)
+    {
+        gb::ppu::line_mask mask{};
+        for (int line = first; line < first + count; line++)
+            mask[line / 64] |= uint64_t{1} << (line % 64);
+        return mask;
+    }
+};
+
+TEST_F(PpuTests, StoresPackedShades)
+{
+    // given:
+    mem.write(0xFF47, 0x1B); // bgp: color id 0 is black, 3 is white
+
+    // when:
+    run_frames();
+
+    // then: 4 pixels to a byte, leftmost in the low bits
+    const std::span<const uint8_t> shades = ppu.get_shades();
+    ASSERT_EQ(shades.size(), gb::ppu::PACKED_FRAME_SIZE);
+    for (size_t i = 0; i < shades.size(); i++)
+        ASSERT_EQ(shades[i], 0x1B) << "byte " << i;
+}
+
+TEST_F(PpuTests, ExpandsShadesToColors)
+{
+    // given:
+    mem.write(0xFF47, 0xE4); // bgp: color ids map to the same shades
+
+    // when:
+    run_frames();
+
+    // then:
+    std::array<uint32_t, gb::ppu::FRAMEBUFFER_SIZE> framebuffer{};
+    ppu.get_framebuffer(framebuffer);
+    for (size_t i = 0; i < gb::ppu::FRAMEBUFFER_SIZE; i++)
+        ASSERT_EQ(framebuffer[i], gb::ppu::SHADE_COLORS[i % 4]) << "pixel " << i;
+}
+
+TEST_F(PpuTests, PublishesChangedLinesSinceTheReadersLastFrame)
+{
+    // given:
+    mem.write(0xFF47, 0xE4); // bgp
+    auto frames = std::make_unique<gb::triple_buffer<gb::ppu::frame>>();
+    ppu.set_frame_output(frames.get());
+    run_frames();
+
+    // then: a new reader starts with everything changed
+    ASSERT_TRUE(frames->acquire());
+    EXPECT_EQ(frames->read_buffer().changed, lines(0, 144));
+
+    // when: the screen stays the same
+    run_frame();
+
+    // then:
+    ASSERT_TRUE(frames->acquire());
+    EXPECT_EQ(frames->read_buffer().changed, lines(0, 0));
+
+    // when: two frames change different rows of tiles, and the reader only looks after the second one
+    mem.write(0x9800, 0x01); // top left tile, tile 1 is blank
+    run_frame();
+    mem.write(0x9840, 0x01); // third row of tiles
+    run_frame();
+
+    // then: the lines of the skipped frame are included
+    ASSERT_TRUE(frames->acquire());
+    gb::ppu::line_mask expected = lines(0, 8);
+    expected[0] |= lines(16, 8)[0];
+    EXPECT_EQ(frames->read_buffer().changed, expected);
+    ppu.set_frame_output(nullptr);
+}
+
+TEST_F(PpuTests, FrameHashFollowsTheScreen)
+{
+    // given:
+    mem.write(0xFF47, 0xE4); // bgp
+    run_frames();
+    const uint64_t first = ppu.get_frame_hash();
+
+    // when: nothing changes
+    run_frame();
+
+    // then:
+    EXPECT_EQ(ppu.get_frame_hash(), first);
+
+    // when: a line changes
+    mem.write(0x9A20, 0x01); // a tile in the middle of the screen
+    run_frame();
+
+    // then: the cached line hashes agree with hashing everything from scratch
+    const uint64_t second = ppu.get_frame_hash();
+    EXPECT_NE(second, first);
+
+    const std::span<const uint8_t> shades = ppu.get_shades();
+    std::array<uint64_t, 144> line_hashes{};
+    for (size_t line = 0; line < line_hashes.size(); line++)
+        line_hashes[line] = gb::hash_bytes(&shades[line * gb::ppu::PACKED_LINE_SIZE], gb::ppu::PACKED_LINE_SIZE);
+    EXPECT_EQ(second, gb::hash_bytes(line_hashes.data(), sizeof(line_hashes)));
+}
+
+TEST_F(PpuTests, FifoDrawsWhatTheScanlineRendererDraws)
+{
+    // given:
+    gb::memory_map scanline_mem{};
+    gb::memory_map fifo_mem{};
+    setup_scene(scanline_mem);
+    setup_scene(fifo_mem);
+    gb::ppu fifo_ppu{};
+    fifo_ppu.set_renderer(ppu_renderer::fifo);
+
+    // when:
+    while (ppu.get_frame_count() < 2)
+        ppu.tick(4, scanline_mem);
+    while (fifo_ppu.get_frame_count() < 2)
+        fifo_ppu.tick(4, fifo_mem);
+
+    // then:
+    const std::span<const uint8_t> expected = ppu.get_shades();
+    const std::span<const uint8_t> shades = fifo_ppu.get_shades();
+    for (int y = 0; y < 144; y++)
+    {
+        for (int x = 0; x < 160; x++)
+            ASSERT_EQ(pixel(shades, x, y), pixel(expected, x, y)) << "pixel " << x << ", " << y;
+    }
+}
+
+TEST_F(PpuTests, FifoDrawingTimeDependsOnScrollWindowAndSprites)
+{
+    // given:
+    mem.write(0xFF4A, 30); // wy
+    mem.write(0xFF4B, 47); // wx
+    mem.write(0xFE00, 16 + 60); // a sprite on line 60
+    mem.write(0xFE01, 8 + 100);
+    for (uint16_t address = 0xFE04; address < 0xFEA0; address++)
+        mem.write(address, 0);
+
+    // then: the scanline renderer always takes the same time
+    run_line(10);
+    EXPECT_EQ(ppu.get_drawing_cycles(), 172);
+
+    // when:
+    ppu.set_renderer(ppu_renderer::fifo);
+    run_line(11);
+
+    // then: the shortest mode 3
+    EXPECT_EQ(ppu.get_drawing_cycles(), 172);
+
+    // when: fine scroll
+    mem.write(0xFF43, 5); // scx
+    run_line(20);
+
+    // then: the scrolled out pixels are fetched and dropped
+    EXPECT_EQ(ppu.get_drawing_cycles(), 177);
+
+    // when: the window starts midway
+    mem.write(0xFF43, 0);
+    mem.write(0xFF40, 0xB1); // lcdc with the window
+    run_line(40);
+
+    // then:
+    EXPECT_EQ(ppu.get_drawing_cycles(), 178);
+
+    // when: a sprite, without the window
+    mem.write(0xFF40, 0x93); // lcdc with sprites
+    run_line(60);
+
+    // then: 6 to 11 cycles, depending on how far the background fetch got
+    EXPECT_GE(ppu.get_drawing_cycles(), 178);
+    EXPECT_LE(ppu.get_drawing_cycles(), 183);
+}
+
+TEST_F(PpuTests, FifoShowsRegisterWritesWithinALine)
+{
+    // given:
+    mem.write(0xFF47, 0xE4); // bgp
+    ppu.set_renderer(ppu_renderer::fifo);
+
+    // when: the palette is inverted halfway through drawing line 10
+    while (mem.read(0xFF44) != 10 || (mem.read(0xFF41) & 0x03) != 3) // ly, stat mode 3
+        ppu.tick(4, mem);
+    for (int i = 0; i < 20; i++)
+        ppu.tick(4, mem);
+    mem.write(0xFF47, 0x1B);
+    run_line(10);
+
+    // then: the left of the line has the old palette and the right the new one
+    const std::span<const uint8_t> shades = ppu.get_shades();
+    for (int x = 0; x < 4; x++)
+    {
+        EXPECT_EQ(pixel(shades, x, 10), x) << "pixel " << x;
+        EXPECT_EQ(pixel(shades, 156 + x, 10), 3 - x) << "pixel " << 156 + x;
+    }
+
+    // and: the lines around it have either
+    run_line(11);
+    EXPECT_EQ(pixel(shades, 159, 9), 3);
+    EXPECT_EQ(pixel(shades, 0, 11), 3);
+}
+
+TEST_F(PpuTests, RenderPolicySkipsDrawingButNotTiming)
+{
+    for (const ppu_renderer renderer : {ppu_renderer::scanline, ppu_renderer::fifo})
+    {
+        // given:
+        gb::memory_map drawn_mem{};
+        gb::memory_map skipped_mem{};
+        setup_scene(drawn_mem);
+        setup_scene(skipped_mem);
+        gb::ppu drawn{};
+        gb::ppu skipped{};
+        drawn.set_renderer(renderer);
+        skipped.set_renderer(renderer);
+        skipped.set_render_policy(ppu_render_policy::every_nth, 3);
+        auto frames = std::make_unique<gb::triple_buffer<gb::ppu::frame>>();
+        skipped.set_frame_output(frames.get());
+
+        // when/then: ly and stat match on every tick, frames are drawn and published every third frame only
+        while (drawn.get_frame_count() < 9)
+        {
+            const uint64_t frame = drawn.get_frame_count();
+            drawn.tick(4, drawn_mem);
+            skipped.tick(4, skipped_mem);
+            ASSERT_EQ(skipped_mem.read(0xFF44), drawn_mem.read(0xFF44));
+            ASSERT_EQ(skipped_mem.read(0xFF41), drawn_mem.read(0xFF41));
+            ASSERT_EQ(skipped.get_frame_count(), drawn.get_frame_count());
+
+            if (drawn.get_frame_count() != frame)
+            {
+                const bool shown = drawn.get_frame_count() % 3 == 0;
+                ASSERT_EQ(frames->acquire(), shown) << "frame " << drawn.get_frame_count();
+                if (shown)
+                {
+                    ASSERT_TRUE(std::ranges::equal(frames->read_buffer().shades, drawn.get_shades()));
+                }
+            }
+        }
+
+        // when: nothing at all
+        skipped.set_render_policy(ppu_render_policy::none);
+        skipped_mem.write(0xFF47, 0x1B); // bgp, so drawing would change the screen
+        while (skipped.get_frame_count() < 12)
+            skipped.tick(4, skipped_mem);
+
+        // then:
+        EXPECT_FALSE(frames->acquire());
+        EXPECT_TRUE(std::ranges::equal(skipped.get_shades(), drawn.get_shades()));
+        skipped.set_frame_output(nullptr);
+    }
+}
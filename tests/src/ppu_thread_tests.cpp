@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <memory_map.h>
+#include <ppu.h>
+#include <span>
+#include <vector>
+#include <gtest/gtest.h>
+
+class PpuThreadTests : public ::testing::Test
+{
+public:
+    gb::memory_map inline_mem{};
+    gb::memory_map threaded_mem{};
+    gb::ppu inline_ppu{};
+    gb::ppu threaded_ppu{};
+
+    void SetUp() override
+    {
+        for (gb::memory_map* mem : {&inline_mem, &threaded_mem})
+        {
+            mem->skip_boot_rom();
+            mem->write(0xFF40, 0xF3); // lcdc: lcd, window at 0x9C00, unsigned tiles, sprites and background
+            mem->write(0xFF47, 0xE4); // bgp
+            mem->write(0xFF48, 0xD2); // obp0
+            mem->write(0xFF49, 0x1B); // obp1
+            mem->write(0xFF4A, 80); // wy
+            mem->write(0xFF4B, 90); // wx
+        }
+        threaded_ppu.set_threaded(true, threaded_mem);
+    }
+
+    // the same pseudo random vram, oam and scroll writes, interleaved with ppu ticks, on both consoles
+    void run(int frames)
+    {
+        uint32_t seed = 12345;
+        const auto next = [&seed]
+        {
+            seed = seed * 1103515245 + 12345;
+            return static_cast<uint8_t>(seed >> 16);
+        };
+
+        const uint64_t target = inline_ppu.get_frame_count() + frames;
+        while (inline_ppu.get_frame_count() < target)
+        {
+            const uint16_t vram_address = VRAM_START + ((next() << 8 | next()) % VRAM_SIZE);
+            const uint16_t oam_address = OAM_START + next() % OAM_SIZE;
+            const uint8_t vram_value = next();
+            const uint8_t oam_value = next();
+            const uint8_t scroll = next();
+            for (gb::memory_map* mem : {&inline_mem, &threaded_mem})
+            {
+                mem->write(vram_address, vram_value);
+                mem->write(oam_address, oam_value);
+                if (scroll < 8)
+                    mem->write(0xFF43, scroll); // scx
+            }
+
+            inline_ppu.tick(20, inline_mem);
+            threaded_ppu.tick(20, threaded_mem);
+        }
+    }
+
+    static std::vector<uint32_t> framebuffer(const gb::ppu& ppu)
+    {
+        std::vector<uint32_t> data(gb::ppu::FRAMEBUFFER_SIZE);
+        ppu.get_framebuffer(std::span<uint32_t, gb::ppu::FRAMEBUFFER_SIZE>{data});
+        return data;
+    }
+};
+
+TEST_F(PpuThreadTests, MatchesInlineRendering)
+{
+    // when:
+    run(5);
+    threaded_ppu.finish_rendering();
+
+    // then:
+    EXPECT_TRUE(threaded_ppu.is_threaded());
+    EXPECT_EQ(threaded_ppu.get_frame_count(), inline_ppu.get_frame_count());
+    EXPECT_EQ(framebuffer(threaded_ppu), framebuffer(inline_ppu));
+}
+
+TEST_F(PpuThreadTests, SwitchingBackToInlineKeepsRenderedLines)
+{
+    // given:
+    run(2);
+
+    // when: switching finishes the queued lines first
+    threaded_ppu.set_threaded(false, threaded_mem);
+    run(2);
+
+    // then:
+    EXPECT_FALSE(threaded_ppu.is_threaded());
+    EXPECT_EQ(framebuffer(threaded_ppu), framebuffer(inline_ppu));
+}
+
+TEST_F(PpuThreadTests, LongRunsReuseTheQueue)
+{
+    // when: many times more records than the queue holds, most of them with dirty vram and oam
+    run(60);
+    threaded_ppu.finish_rendering();
+
+    // then:
+    EXPECT_EQ(framebuffer(threaded_ppu), framebuffer(inline_ppu));
+}
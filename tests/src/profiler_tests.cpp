@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cstdint>
+#include <gameboy.h>
+#include <memory>
+#include <memory_map.h>
+#include <profiler.h>
+#include <sstream>
+#include "test_roms.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace
+{
+    // a cartridge of the given type, skipped past the boot rom
+    gb::memory_map make_map(uint8_t cart_type, size_t rom_size)
+    {
+        auto rom = std::make_shared<std::vector<uint8_t>>(rom_size, 0x00);
+        (*rom)[gb::cartridge::HEADER_TYPE_ADDR] = cart_type;
+        gb::memory_map mem{};
+        mem.load_rom(gb::rom_image{rom});
+        mem.skip_boot_rom();
+        return mem;
+    }
+}
+
+TEST(ProfilerTests, CountsPerBankedAddress)
+{
+    // given: a 64 KB mbc1 cartridge with bank 2 mapped
+    gb::memory_map mem = make_map(0x01, 0x10000);
+    mem.write(0x2000, 2);
+    gb::profiler profiler;
+
+    // when:
+    profiler.record(mem, 0x0150, 0x00, 1);
+    profiler.record(mem, 0x4010, 0xFA, 4);
+    profiler.record(mem, 0x4010, 0xFA, 4);
+    profiler.record(mem, 0xFF80, 0x18, 3);
+    mem.write(0x2000, 3);
+    profiler.record(mem, 0x4010, 0xEA, 4);
+
+    // then:
+    EXPECT_EQ(profiler.get_location(0, 0x0150).count, 1);
+    EXPECT_EQ(profiler.get_location(2, 0x4010).count, 2);
+    EXPECT_EQ(profiler.get_location(2, 0x4010).cycles, 8);
+    EXPECT_EQ(profiler.get_location(3, 0x4010).count, 1);
+    EXPECT_EQ(profiler.get_location(1, 0x4010).count, 0);
+    EXPECT_EQ(profiler.get_location(0, 0xFF80).cycles, 3);
+    EXPECT_EQ(profiler.get_opcode(0xFA).count, 2);
+    EXPECT_EQ(profiler.total_cycles(), 16);
+
+    std::ostringstream csv;
+    profiler.write_csv(csv);
+    EXPECT_EQ(csv.str(), "bank,address,count,cycles\n00,0150,1,1\n02,4010,2,8\n03,4010,1,4\n00,ff80,1,3\n");
+}
+
+TEST(ProfilerTests, BanksComeFromTheMappedWindow)
+{
+    // given: a 1 MB mbc1 cartridge in mode 1, which maps bank 0x20 at 0x0000
+    gb::memory_map mbc1 = make_map(0x01, 0x100000);
+    mbc1.write(0x6000, 0x01);
+    mbc1.write(0x4000, 0x01);
+    // an mbc5 cartridge with bank 0 mapped at 0x4000
+    gb::memory_map mbc5 = make_map(0x19, 0x10000);
+    mbc5.write(0x2000, 0x00);
+    // the boot rom over bank 0
+    gb::memory_map booting{};
+    booting.load_rom(gb::rom_image{std::make_shared<std::vector<uint8_t>>(0x8000, 0x00)});
+    gb::profiler profiler;
+
+    // when:
+    profiler.record(mbc1, 0x0150, 0x00, 1);
+    profiler.record(mbc5, 0x4010, 0x00, 1);
+    profiler.record(booting, 0x0050, 0x00, 1);
+    profiler.record(booting, 0x0150, 0x00, 1);
+
+    // then: each counted at the bank and address the cpu saw
+    EXPECT_EQ(profiler.get_location(0x20, 0x0150).count, 1);
+    EXPECT_EQ(profiler.get_location(0x20, 0x4150).count, 0);
+    EXPECT_EQ(profiler.get_location(0, 0x4010).count, 1);
+    EXPECT_EQ(profiler.get_location(0, 0x0010).count, 0);
+    EXPECT_EQ(profiler.get_boot_location(0x0050).count, 1);
+    EXPECT_EQ(profiler.get_location(0, 0x0050).count, 0);
+    EXPECT_EQ(profiler.get_location(0, 0x0150).count, 1);
+
+    std::ostringstream csv;
+    profiler.write_csv(csv);
+    EXPECT_EQ(csv.str(), "bank,address,count,cycles\nboot,0050,1,1\n00,0150,1,1\n20,0150,1,1\n00,4010,1,1\n");
+}
+
+TEST(ProfilerTests, CountsInstructionsWhereTheyWereFetched)
+{
+    if constexpr (!gb::profiler::ENABLED)
+        GTEST_SKIP() << "built without GB_PROFILE";
+
+    // given: a 64 KB mbc1 cartridge that jumps to bank 1, which maps bank 2 over itself
+    auto rom = std::make_shared<std::vector<uint8_t>>(0x10000, 0x00);
+    (*rom)[gb::cartridge::HEADER_TYPE_ADDR] = 0x01;
+    const uint8_t entry[] = {0xC3, 0x00, 0x40}; // jp 0x4000
+    const uint8_t bank1[] = {
+        0xFA, 0x00, 0x02, // ld a,(0x200)
+        0xEA, 0x00, 0x20, // ld (0x2000),a, a is 2
+        0x18, 0xFE}; // jr -2, never runs: bank 2 is mapped by now, and all nops
+    std::ranges::copy(entry, rom->begin() + 0x100);
+    std::ranges::copy(bank1, rom->begin() + 0x4000);
+    (*rom)[0x200] = 0x02;
+    gb::gameboy gb{gb::rom_image{rom}};
+    test_roms::start(gb);
+    // and the boot rom's last instruction, ldh (0x50),a, which unmaps it
+    gb::gameboy booting{gb::rom_image{rom}};
+    booting.cpu.PC.full = 0x00FE;
+    booting.cpu.AF.high = 0x01;
+    gb::profiler profiler;
+
+    // when:
+    gb.cpu.set_profiler(&profiler);
+    booting.cpu.set_profiler(&profiler);
+    for (int i = 0; i < 4; i++)
+        gb.cpu.execute(gb.mem);
+    booting.cpu.execute(booting.mem);
+
+    // then: the store counts in bank 1 and the next instruction in bank 2
+    EXPECT_EQ(profiler.get_location(1, 0x4003).count, 1);
+    EXPECT_EQ(profiler.get_location(2, 0x4003).count, 0);
+    EXPECT_EQ(profiler.get_location(2, 0x4006).count, 1);
+
+    // then: ldh counts in the boot rom, not the cartridge that took its place
+    EXPECT_FALSE(booting.mem.is_boot_rom_mapped());
+    EXPECT_EQ(profiler.get_boot_location(0x00FE).count, 1);
+    EXPECT_EQ(profiler.get_location(0, 0x00FE).count, 0);
+}
+
+TEST(ProfilerTests, SymbolizesAgainstSymFiles)
+{
+    // given:
+    const gb::symbol_table symbols = gb::symbol_table::parse(
+        "; File created by rgblink\n"
+        "[labels]\n"
+        "00:0150 Main\n"
+        "00:0100 Entry ; the header jumps here\n"
+        "02:4000 LoadLevel\n"
+        "00:C000 wBuffer\n");
+
+    // then: the closest label before an address, in its own bank and region
+    ASSERT_EQ(symbols.size(), 4);
+    EXPECT_EQ(symbols.find(0, 0x0120)->name, "Entry");
+    EXPECT_EQ(symbols.find(5, 0x0150)->name, "Main");
+    EXPECT_EQ(symbols.find(2, 0x4123)->name, "LoadLevel");
+    EXPECT_EQ(symbols.find(1, 0x4123), nullptr);
+    EXPECT_EQ(symbols.find(0, 0x0050), nullptr);
+    EXPECT_EQ(symbols.find(0, 0xFF80), nullptr);
+
+    const gb::memory_map mem = make_map(0x00, 0x8000);
+    gb::profiler profiler;
+    profiler.record(mem, 0x0100, 0x00, 1);
+    profiler.record(mem, 0x0151, 0x18, 3);
+    profiler.record(mem, 0xFF80, 0x00, 1);
+    std::ostringstream folded;
+    profiler.write_folded(folded, &symbols);
+    EXPECT_EQ(folded.str(), "Entry;00:0100 1\nMain;00:0151 3\n00:ff80 1\n");
+}
+
+TEST(ProfilerTests, CpuFeedsTheProfiler)
+{
+    if constexpr (!gb::profiler::ENABLED)
+        GTEST_SKIP() << "built without GB_PROFILE";
+
+    // given: a loop of a load, a store and a jump back
+    const uint8_t program[] = {
+        0xFA, 0x00, 0xC0, // ld a,(0xC000)
+        0xEA, 0x01, 0xC0, // ld (0xC001),a
+        0x18, 0xF8}; // back to the start
+    gb::gameboy gb{test_roms::make_rom(program)};
+    test_roms::start(gb);
+    gb::profiler profiler;
+
+    // when:
+    gb.cpu.set_profiler(&profiler);
+    const uint32_t cycles = gb.run_frame();
+    gb.cpu.set_profiler(nullptr);
+    gb.run_frame();
+
+    // then: every instruction of the frame, and nothing after
+    const uint64_t loops = profiler.get_location(0, 0x0106).count;
+    EXPECT_GT(loops, 100);
+    EXPECT_LE(profiler.get_location(0, 0x0100).count - loops, 1);
+    EXPECT_EQ(profiler.get_opcode(0x18).count, loops);
+    EXPECT_EQ(profiler.total_cycles(), cycles);
+}
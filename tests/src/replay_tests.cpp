@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <gameboy.h>
+#include <input_movie.h>
+#include <joypad.h>
+#include <memory>
+#include <replay.h>
+#include "test_roms.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+class ReplayTests : public ::testing::Test
+{
+public:
+    // selects both rows of the joypad and keeps reading the lines into a, copying them to wram as it goes
+    static gb::rom_image make_rom()
+    {
+        const uint8_t program[] = {
+            0xEA, 0x00, 0xFF, // ld (0xFF00),a
+            0xFA, 0x00, 0xFF, // ld a,(0xFF00)
+            0xEA, 0x00, 0xC8, // ld (0xC800),a
+            0x18, 0xF5}; // back to the start
+        return test_roms::make_rom(program);
+    }
+
+    // a = 0 selects both rows
+    static void start(gb::gameboy& gb)
+    {
+        test_roms::start(gb);
+        gb.cpu.AF.full = 0x0000;
+    }
+
+    static gb::input_movie make_movie()
+    {
+        gb::input_movie movie{};
+        for (int frame = 0; frame < 30; frame++)
+            movie.add_frame(frame % 10 < 5 ? 0 : gb::joypad::A);
+        return movie;
+    }
+};
+
+TEST_F(ReplayTests, ReplayMatchesItsRecording)
+{
+    // given:
+    gb::gameboy recorded{make_rom()};
+    start(recorded);
+    gb::input_movie movie = make_movie();
+    gb::record_hashes(recorded, movie);
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "gbemu_replay_matches.gbm";
+    movie.save(path);
+    const gb::input_movie loaded{path};
+    std::filesystem::remove(path);
+
+    // when:
+    gb::gameboy replayed{make_rom()};
+    start(replayed);
+    const gb::replay_result result = gb::verify_replay(replayed, loaded);
+
+    // then:
+    ASSERT_TRUE(loaded.has_hashes());
+    EXPECT_FALSE(result.diverged);
+    EXPECT_EQ(result.frames, 30);
+    EXPECT_NE(loaded.get_hash(4), loaded.get_hash(5));
+}
+
+TEST_F(ReplayTests, ReportsTheFirstFrameThatDiffers)
+{
+    // given: the recording, then a replay where a button is let go a frame early
+    gb::gameboy recorded{make_rom()};
+    start(recorded);
+    gb::input_movie movie = make_movie();
+    gb::record_hashes(recorded, movie);
+
+    gb::input_movie changed{};
+    for (uint64_t frame = 0; frame < movie.frame_count(); frame++)
+        changed.add_frame(frame == 19 ? 0 : movie.get_buttons(frame));
+    std::vector<uint64_t> hashes;
+    for (uint64_t frame = 0; frame < movie.frame_count(); frame++)
+        hashes.push_back(movie.get_hash(frame));
+    changed.set_hashes(std::move(hashes));
+
+    // when:
+    gb::gameboy replayed{make_rom()};
+    start(replayed);
+    const gb::replay_result result = gb::verify_replay(replayed, changed);
+
+    // then:
+    EXPECT_TRUE(result.diverged);
+    EXPECT_EQ(result.first_divergence, 19);
+    EXPECT_EQ(result.frames, 20);
+    EXPECT_EQ(result.expected_hash, movie.get_hash(19));
+    EXPECT_NE(result.actual_hash, result.expected_hash);
+}
+
+TEST_F(ReplayTests, IncrementalHashSeesEveryWrite)
+{
+    // given:
+    gb::gameboy gb{make_rom()};
+    start(gb);
+    gb::state_hasher hasher{gb};
+    const uint64_t before = hasher.hash();
+
+    // when: nothing written
+    EXPECT_EQ(gb.mem.take_written_pages(), 0);
+
+    // when: the first write to a page takes the slow path and gives the page its write access back, the rest
+    // don't go through the tracking at all
+    for (uint16_t address : {0x9ABC, 0xC001, 0xC002, 0xC003, 0xD000, 0xF000})
+        gb.mem.write(address, 0x5A);
+    const uint64_t after = hasher.hash();
+
+    // then: the same as hashing everything
+    {
+        gb::gameboy fork = gb.fork();
+        gb::state_hasher full{fork};
+        EXPECT_EQ(after, full.hash());
+        EXPECT_NE(after, before);
+    }
+    EXPECT_EQ(gb.mem.take_written_pages(), 0);
+
+    // when: a page written through the fast path after the last hash
+    gb.mem.write(0xC004, 0x01);
+    gb.mem.write(0xC005, 0x02);
+
+    // then:
+    EXPECT_EQ(gb.mem.take_written_pages(), 0x04);
+}
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <resampler.h>
+#include <span>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace
+{
+    // a second of a sine at frequency
+    std::vector<float> sine(double frequency, uint32_t rate, float amplitude)
+    {
+        std::vector<float> samples(rate);
+        for (size_t i = 0; i < samples.size(); i++)
+            samples[i] = amplitude * static_cast<float>(std::sin(2.0 * std::numbers::pi * frequency * i / rate));
+        return samples;
+    }
+}
+
+TEST(ResamplerTests, KeepsTonesInThePassBand)
+{
+    // given:
+    gb::resampler resampler{131072, 48000};
+    const std::vector<float> input = sine(1000.0, 131072, 10000.0f);
+
+    // when: a second, in blocks of a frame
+    std::vector<int16_t> output;
+    for (size_t i = 0; i < input.size(); i += 2048)
+    {
+        const std::span<const float> block = std::span(input).subspan(i, 2048);
+        resampler.process(block, block, output);
+    }
+
+    // then: a second out, at the same level once the filter has filled up
+    ASSERT_EQ(output.size(), 2 * 48000);
+    int16_t peak = 0;
+    for (size_t i = 2 * 1000; i < output.size(); i += 2)
+        peak = std::max(peak, output[i]);
+    EXPECT_NEAR(peak, 10000, 50);
+    EXPECT_EQ(output[5000], output[5001]);
+}
+
+TEST(ResamplerTests, RateFactorChangesTheNumberOfSamples)
+{
+    // given:
+    gb::resampler resampler{131072, 48000};
+    const std::vector<float> input(131072, 0.0f);
+
+    // when: 1% faster
+    resampler.set_rate_factor(1.01);
+    std::vector<int16_t> output;
+    resampler.process(input, input, output);
+
+    // then:
+    EXPECT_NEAR(static_cast<double>(output.size()), 2 * 48480, 2);
+}
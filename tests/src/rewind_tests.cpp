@@ -0,0 +1,126 @@
+#include <cstdint>
+#include <delta_codec.h>
+#include <gameboy.h>
+#include <memory>
+#include <rewind.h>
+#include "test_roms.h"
+#include <vector>
+#include <gtest/gtest.h>
+
+class RewindTests : public ::testing::Test
+{
+public:
+    gb::gameboy gb{make_rom()};
+
+    // a "game" that spins on jr -2 at the entry point, so every frame is identical to emulate
+    static gb::rom_image make_rom()
+    {
+        const uint8_t program[] = {0x18, 0xFE}; // jr -2
+        return test_roms::make_rom(program);
+    }
+
+    void SetUp() override
+    {
+        test_roms::start(gb);
+    }
+
+    std::vector<uint8_t> snapshot() const
+    {
+        return test_roms::snapshot(gb);
+    }
+};
+
+TEST(DeltaCodecTests, RoundTripWithAndWithoutReference)
+{
+    // given:
+    std::vector<uint8_t> reference(1000, 0x11);
+    std::vector<uint8_t> data = reference;
+    data[3] = 0x42;
+    data[500] = 0x43;
+    data[501] = 0x44;
+    data[999] = 0x45;
+    std::vector<uint8_t> encoded(gb::delta_codec::max_encoded_size(data.size()));
+
+    // when:
+    const size_t delta_size = gb::delta_codec::encode(data, reference, encoded);
+    std::vector<uint8_t> decoded = reference;
+    const bool delta_ok = gb::delta_codec::decode(std::span{encoded}.first(delta_size), decoded);
+
+    // then: a few changed bytes cost a few bytes
+    EXPECT_TRUE(delta_ok);
+    EXPECT_LT(delta_size, 32);
+    EXPECT_EQ(decoded, data);
+
+    // when: no reference
+    const size_t raw_size = gb::delta_codec::encode(data, {}, encoded);
+    std::vector<uint8_t> raw_decoded(data.size(), 0);
+    const bool raw_ok = gb::delta_codec::decode(std::span{encoded}.first(raw_size), raw_decoded);
+
+    // then:
+    EXPECT_TRUE(raw_ok);
+    EXPECT_EQ(raw_decoded, data);
+}
+
+TEST_F(RewindTests, RewindRestoresCapturedFrame)
+{
+    // given: a capture every frame, with the "game" writing its frame number to wram
+    gb::rewind_buffer rewind{1 << 20, 1};
+    for (int frame = 0; frame < 100; frame++)
+    {
+        gb.mem.write(0xC000, static_cast<uint8_t>(gb.get_frame_count()));
+        gb.run_frame();
+        rewind.on_frame(gb);
+    }
+    const uint64_t end_frame = gb.get_frame_count();
+
+    // when:
+    EXPECT_TRUE(rewind.rewind(gb, 30));
+
+    // then:
+    EXPECT_EQ(gb.get_frame_count(), end_frame - 30);
+    EXPECT_EQ(gb.mem.read(0xC000), static_cast<uint8_t>(end_frame - 31));
+    EXPECT_EQ(rewind.stats().entries, 70);
+}
+
+TEST_F(RewindTests, RewindBetweenCapturesReEmulatesForward)
+{
+    // given: a capture every 4 frames, and the exact state at every frame for reference
+    gb::rewind_buffer rewind{1 << 20, 4};
+    std::vector<std::vector<uint8_t>> states;
+    for (int frame = 0; frame < 40; frame++)
+    {
+        gb.run_frame();
+        rewind.on_frame(gb);
+        states.push_back(snapshot());
+    }
+
+    // when: 6 frames back isn't a captured frame
+    EXPECT_TRUE(rewind.rewind(gb, 6));
+
+    // then: the state is identical to when that frame was first emulated
+    EXPECT_EQ(snapshot(), states[states.size() - 1 - 6]);
+}
+
+TEST_F(RewindTests, FullRingDropsOldestHistory)
+{
+    // given: a ring that only holds a few keyframes, with wram full of noise so they don't compress away
+    for (uint16_t addr = 0xC000; addr < 0xE000; addr++)
+        gb.mem.write(addr, static_cast<uint8_t>(addr * 37 + 1) | 0x01);
+    gb::rewind_buffer rewind{4 * gb.save_state_size(), 1, 8};
+
+    // when:
+    for (int frame = 0; frame < 200; frame++)
+    {
+        gb.mem.write(0xC000 + frame, 0x5A);
+        gb.run_frame();
+        rewind.on_frame(gb);
+    }
+
+    // then: the oldest frames are gone, and rewinding past them clamps to the oldest capture
+    const gb::rewind_stats stats = rewind.stats();
+    EXPECT_LE(stats.used_bytes, stats.capacity_bytes);
+    EXPECT_LT(stats.frames_covered, 199);
+    EXPECT_EQ(stats.captures, 200);
+    EXPECT_TRUE(rewind.rewind(gb, 1000));
+    EXPECT_EQ(gb.get_frame_count(), 200 - stats.frames_covered);
+}
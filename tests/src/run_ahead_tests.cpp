@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <gameboy.h>
+#include <memory>
+#include <ppu.h>
+#include <run_ahead.h>
+#include "test_roms.h"
+#include <triple_buffer.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+class RunAheadTests : public ::testing::Test
+{
+public:
+    // turns the lcd on over stripes of tile 0, then scrolls down a line every vblank, so every frame differs from
+    // the last few
+    static gb::rom_image make_rom()
+    {
+        const uint8_t program[] = {
+            0xFA, 0x01, 0x02, 0xEA, 0x00, 0x80, // ld a,(0x201); ld (0x8000),a
+            0xFA, 0x02, 0x02, 0xEA, 0x47, 0xFF, // ld a,(0x202); ld (BGP),a
+            0xFA, 0x00, 0x02, 0xEA, 0x40, 0xFF, // ld a,(0x200); ld (LCDC),a
+            0xFA, 0x44, 0xFF, 0xFE, 0x90, 0x20, 0xF9, // wait for ly 144
+            0xFA, 0x42, 0xFF, 0x3C, 0xEA, 0x42, 0xFF, // scy++
+            0xFA, 0x44, 0xFF, 0xFE, 0x90, 0x28, 0xF9, // wait for ly to move on
+            0x18, 0xE9}; // back to waiting for ly 144
+        auto rom = test_roms::make_rom(program);
+        (*rom)[0x200] = 0x91;
+        (*rom)[0x201] = 0xFF;
+        (*rom)[0x202] = 0xE4;
+        return rom;
+    }
+};
+
+TEST_F(RunAheadTests, ShowsFramesAheadWithoutChangingTheConsole)
+{
+    // given:
+    constexpr uint32_t AHEAD = 2;
+    gb::gameboy plain{make_rom()};
+    gb::gameboy ahead{make_rom()};
+    test_roms::start(plain);
+    test_roms::start(ahead);
+    gb::run_ahead runner{AHEAD};
+
+    // when: the plain console's screens, for comparing against later
+    std::vector<std::array<uint8_t, gb::ppu::PACKED_FRAME_SIZE>> screens;
+    for (uint32_t frame = 0; frame < 20 + AHEAD; frame++)
+    {
+        plain.run_frame();
+        auto& screen = screens.emplace_back();
+        std::copy(plain.ppu.get_shades().begin(), plain.ppu.get_shades().end(), screen.begin());
+    }
+    ASSERT_NE(screens[10], screens[11]);
+
+    // then: the screen is always AHEAD frames further, the console itself isn't
+    gb::gameboy reference{make_rom()};
+    test_roms::start(reference);
+    for (uint32_t frame = 0; frame < 20; frame++)
+    {
+        reference.run_frame();
+        runner.run_frame(ahead, 0);
+        ASSERT_EQ(test_roms::snapshot(ahead), test_roms::snapshot(reference)) << "frame " << frame;
+        ASSERT_TRUE(std::equal(ahead.ppu.get_shades().begin(), ahead.ppu.get_shades().end(),
+                               screens[frame + AHEAD].begin())) << "frame " << frame;
+    }
+    EXPECT_EQ(ahead.ppu.get_render_policy(), ppu_render_policy::none);
+    EXPECT_EQ(runner.stats().runs, 20);
+    EXPECT_GT(runner.stats().average_us, 0.0);
+}
+
+TEST_F(RunAheadTests, PublishesOnlyTheFramesShown)
+{
+    // given:
+    gb::gameboy gb{make_rom()};
+    test_roms::start(gb);
+    auto frames = std::make_unique<gb::triple_buffer<gb::ppu::frame>>();
+    gb.ppu.set_frame_output(frames.get());
+
+    // when: the console draws nothing itself
+    gb.ppu.set_render_policy(ppu_render_policy::none);
+    gb.run_frame();
+
+    // then:
+    EXPECT_FALSE(frames->acquire());
+
+    // when:
+    gb::run_ahead runner{1};
+    runner.run_frame(gb, 0);
+
+    // then: the frame from ahead, which is the console's screen as well
+    ASSERT_TRUE(frames->acquire());
+    EXPECT_TRUE(std::equal(gb.ppu.get_shades().begin(), gb.ppu.get_shades().end(),
+                           frames->read_buffer().shades.begin()));
+    gb.ppu.set_frame_output(nullptr);
+}
+
+TEST_F(RunAheadTests, StaticScreenPublishesNoChangedLines)
+{
+    // given: the lcd on over stripes of tile 0, then nothing
+    const uint8_t program[] = {
+        0xFA, 0x01, 0x02, 0xEA, 0x00, 0x80, // ld a,(0x201); ld (0x8000),a
+        0xFA, 0x02, 0x02, 0xEA, 0x47, 0xFF, // ld a,(0x202); ld (BGP),a
+        0xFA, 0x00, 0x02, 0xEA, 0x40, 0xFF, // ld a,(0x200); ld (LCDC),a
+        0x18, 0xFE}; // jr -2
+    auto rom = test_roms::make_rom(program);
+    (*rom)[0x200] = 0x91;
+    (*rom)[0x201] = 0xFF;
+    (*rom)[0x202] = 0xE4;
+    gb::gameboy gb{rom};
+    test_roms::start(gb);
+    auto frames = std::make_unique<gb::triple_buffer<gb::ppu::frame>>();
+    gb.ppu.set_frame_output(frames.get());
+    gb::run_ahead runner{2};
+    for (int frame = 0; frame < 3; frame++)
+        runner.run_frame(gb, 0);
+    ASSERT_TRUE(frames->acquire());
+
+    // then: the forks start out with the screen shown, so they don't mark lines they didn't change
+    for (int frame = 0; frame < 5; frame++)
+    {
+        runner.run_frame(gb, 0);
+        ASSERT_TRUE(frames->acquire()) << "frame " << frame;
+        EXPECT_EQ(frames->read_buffer().changed, gb::ppu::line_mask{}) << "frame " << frame;
+    }
+    gb.ppu.set_frame_output(nullptr);
+}
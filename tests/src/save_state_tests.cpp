@@ -0,0 +1,79 @@
+#include <cpu.h>
+#include <cstdint>
+#include <memory_map.h>
+#include <ppu.h>
+#include <save_state.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+class SaveStateTests : public ::testing::Test
+{
+public:
+    gb::memory_map mem{};
+    gb::cpu cpu{};
+    gb::ppu ppu{};
+
+    void SetUp() override
+    {
+        cpu.PC.full = 0xD000;
+    }
+};
+
+TEST_F(SaveStateTests, RoundTripRestoresRegistersAndMemory)
+{
+    // given:
+    std::vector<uint8_t> buffer(gb::save_state_size(cpu, mem, ppu));
+    cpu.BC.full = 0x1234;
+    mem.write(0xC010, 0x42);
+    mem.write(0x8000, 0x24);
+    mem.write(0xFF80, 0x99);
+
+    // when:
+    const size_t written = gb::save_state(cpu, mem, ppu, buffer);
+    cpu.BC.full = 0;
+    cpu.PC.full = 0;
+    mem.write(0xC010, 0);
+    mem.write(0x8000, 0);
+    mem.write(0xFF80, 0);
+
+    // then:
+    EXPECT_EQ(written, buffer.size());
+    EXPECT_TRUE(gb::load_state(cpu, mem, ppu, buffer));
+    EXPECT_EQ(cpu.BC.full, 0x1234);
+    EXPECT_EQ(cpu.PC.full, 0xD000);
+    EXPECT_EQ(mem.read(0xC010), 0x42);
+    EXPECT_EQ(mem.read(0x8000), 0x24);
+    EXPECT_EQ(mem.read(0xFF80), 0x99);
+}
+
+TEST_F(SaveStateTests, TooSmallBufferFails)
+{
+    // given:
+    std::vector<uint8_t> buffer(gb::save_state_size(cpu, mem, ppu) - 1);
+
+    // when:
+    const size_t written = gb::save_state(cpu, mem, ppu, buffer);
+
+    // then: whatever made it into the buffer isn't a state
+    EXPECT_EQ(written, 0);
+    EXPECT_FALSE(gb::load_state(cpu, mem, ppu, buffer));
+}
+
+TEST_F(SaveStateTests, CorruptOrMismatchedStatesAreRejected)
+{
+    // given:
+    std::vector<uint8_t> buffer(gb::save_state_size(cpu, mem, ppu, gb::STATE_FRAMEBUFFER));
+    gb::save_state(cpu, mem, ppu, buffer, gb::STATE_FRAMEBUFFER);
+    cpu.BC.full = 0x5678;
+
+    // when: truncated
+    const bool truncated = gb::load_state(cpu, mem, ppu, std::span{buffer}.first(buffer.size() - 1));
+    // when: wrong magic
+    buffer[0] ^= 0xFF;
+    const bool bad_magic = gb::load_state(cpu, mem, ppu, buffer);
+
+    // then: nothing was restored
+    EXPECT_FALSE(truncated);
+    EXPECT_FALSE(bad_magic);
+    EXPECT_EQ(cpu.BC.full, 0x5678);
+}
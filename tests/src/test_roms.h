@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <gameboy.h>
+#include <memory>
+#include <span>
+#include <vector>
+
+// hand assembled programs for the tests that run the cpu. it can't get through the boot rom yet, so they skip it
+// and start right at the entry point
+namespace test_roms
+{
+    // a 32 KB rom-only cartridge with program at the entry point (0x100), zeroes everywhere else
+    inline std::shared_ptr<std::vector<uint8_t>> make_rom(std::span<const uint8_t> program)
+    {
+        auto rom = std::make_shared<std::vector<uint8_t>>(0x8000, 0x00);
+        std::ranges::copy(program, rom->begin() + 0x100);
+        return rom;
+    }
+
+    // skips the boot rom and jumps to the entry point
+    inline void start(gb::gameboy& gb)
+    {
+        gb.mem.skip_boot_rom();
+        gb.cpu.PC.full = 0x0100;
+    }
+
+    // the whole state, for comparing consoles
+    inline std::vector<uint8_t> snapshot(const gb::gameboy& gb)
+    {
+        std::vector<uint8_t> state(gb.save_state_size());
+        gb.save_state(state);
+        return state;
+    }
+}
@@ -0,0 +1,118 @@
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_map.h>
+#include <ppu.h>
+#include <span>
+#include <thread>
+#include <triple_buffer.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+TEST(TripleBufferTests, ReaderGetsLatestPublished)
+{
+    // given:
+    gb::triple_buffer<int> buffer;
+
+    // then: nothing published yet
+    EXPECT_FALSE(buffer.acquire());
+
+    // when:
+    buffer.write_buffer() = 1;
+    buffer.publish();
+    buffer.write_buffer() = 2;
+    buffer.publish();
+
+    // then: the reader skips to the latest value and keeps it until something new is published
+    EXPECT_TRUE(buffer.acquire());
+    EXPECT_EQ(buffer.read_buffer(), 2);
+    EXPECT_FALSE(buffer.acquire());
+    EXPECT_EQ(buffer.read_buffer(), 2);
+
+    // when:
+    buffer.write_buffer() = 3;
+    buffer.publish();
+
+    // then:
+    EXPECT_TRUE(buffer.acquire());
+    EXPECT_EQ(buffer.read_buffer(), 3);
+}
+
+TEST(TripleBufferTests, ReaderNeverSeesPartialValues)
+{
+    // given: every value is an array filled with one number, counting up
+    using value = std::array<uint32_t, 1024>;
+    auto buffer = std::make_unique<gb::triple_buffer<value>>();
+    constexpr uint32_t COUNT = 20000;
+
+    // when:
+    std::thread writer{[&buffer]
+    {
+        for (uint32_t i = 1; i <= COUNT; i++)
+        {
+            buffer->write_buffer().fill(i);
+            buffer->publish();
+        }
+    }};
+
+    // then: whatever the reader picks up is complete, and never older than what it had before
+    uint32_t last = 0;
+    bool consistent = true;
+    while (last < COUNT && consistent)
+    {
+        if (!buffer->acquire())
+            continue;
+        const value& read = buffer->read_buffer();
+        for (const uint32_t element : read)
+            consistent &= element == read[0];
+        consistent &= read[0] > last;
+        last = read[0];
+    }
+    writer.join();
+
+    EXPECT_TRUE(consistent);
+    EXPECT_EQ(last, COUNT);
+}
+
+class PpuFrameOutputTests : public ::testing::TestWithParam<bool>
+{
+};
+
+TEST_P(PpuFrameOutputTests, PublishesEveryFrameAtVBlank)
+{
+    // given: a background of random tiles
+    gb::memory_map mem{};
+    mem.skip_boot_rom();
+    mem.write(0xFF40, 0x91); // lcdc: lcd, unsigned tiles and background
+    mem.write(0xFF47, 0xE4); // bgp
+    uint32_t seed = 1;
+    for (uint16_t address = 0x8000; address < 0x9C00; address++)
+    {
+        seed = seed * 1103515245 + 12345;
+        mem.write(address, static_cast<uint8_t>(seed >> 16));
+    }
+
+    gb::ppu ppu{};
+    ppu.set_threaded(GetParam(), mem);
+    auto frames = std::make_unique<gb::triple_buffer<gb::ppu::frame>>();
+    ppu.set_frame_output(frames.get());
+
+    // when: the screen scrolls a bit every frame
+    for (uint8_t frame = 1; frame <= 4; frame++)
+    {
+        while (ppu.get_frame_count() < frame)
+            ppu.tick(4, mem);
+        mem.write(0xFF43, frame); // scx
+
+        // then: the published frame is exactly the screen at vblank
+        ppu.finish_rendering();
+        ASSERT_TRUE(frames->acquire());
+        const std::span<const uint8_t> shades = ppu.get_shades();
+        const gb::ppu::frame& published = frames->read_buffer();
+        EXPECT_EQ(std::vector<uint8_t>(published.shades.begin(), published.shades.end()),
+                  std::vector<uint8_t>(shades.begin(), shades.end()));
+    }
+    ppu.set_frame_output(nullptr);
+}
+
+INSTANTIATE_TEST_SUITE_P(InlineAndThreaded, PpuFrameOutputTests, ::testing::Values(false, true));
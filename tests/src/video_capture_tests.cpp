@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory_map.h>
+#include <ppu.h>
+#include <string>
+#include <vector>
+#include <video_capture.h>
+#include <gtest/gtest.h>
+
+class VideoCaptureTests : public ::testing::Test
+{
+public:
+    using frame = std::array<uint8_t, gb::ppu::PACKED_FRAME_SIZE>;
+
+    std::filesystem::path path;
+
+    void SetUp() override
+    {
+        path = std::filesystem::temp_directory_path() /
+               ("gbemu_capture_" + std::string{::testing::UnitTest::GetInstance()->current_test_info()->name()});
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove(path);
+    }
+
+    // mostly static frames with a small moving part, like a game
+    static std::vector<frame> make_frames(size_t count)
+    {
+        std::vector<frame> frames(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            for (size_t byte = 0; byte < frames[i].size(); byte++)
+                frames[i][byte] = static_cast<uint8_t>(byte / 40 * 0x1B);
+            for (size_t byte = 0; byte < 64; byte++)
+                frames[i][(i * 40 + byte) % frames[i].size()] = static_cast<uint8_t>(i + byte);
+        }
+        return frames;
+    }
+};
+
+TEST_F(VideoCaptureTests, ReadsBackWhatWasCaptured)
+{
+    // given: more frames than the queue holds, and a few keyframes
+    const std::vector<frame> frames = make_frames(100);
+
+    // when:
+    uint64_t bytes = 0;
+    {
+        gb::video_capture capture{path, 30};
+        for (const frame& f : frames)
+            capture.add_frame(f);
+        capture.flush();
+
+        EXPECT_TRUE(capture.ok());
+        EXPECT_EQ(capture.frames_written(), frames.size());
+        bytes = capture.bytes_written();
+    }
+
+    // then: every frame comes back exactly, and the deltas are far smaller than the frames
+    EXPECT_EQ(std::filesystem::file_size(path), bytes);
+    EXPECT_LT(bytes, frames.size() * sizeof(frame) / 10);
+
+    gb::video_reader reader{path};
+    EXPECT_EQ(reader.width(), 160);
+    EXPECT_EQ(reader.height(), 144);
+
+    frame decoded{};
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        ASSERT_TRUE(reader.next_frame(decoded)) << "frame " << i;
+        ASSERT_EQ(decoded, frames[i]) << "frame " << i;
+    }
+    EXPECT_FALSE(reader.next_frame(decoded));
+}
+
+TEST_F(VideoCaptureTests, DecodesThePpusShadesFromKeyframesAndDeltas)
+{
+    // given: a background of color ids 0-3 that scrolls a pixel every frame
+    gb::memory_map mem{};
+    gb::ppu ppu{};
+    mem.skip_boot_rom();
+    mem.write(0xFF40, 0x91); // lcdc: lcd, unsigned tiles and background, map at 0x9800 is all tile 0
+    mem.write(0xFF47, 0xE4); // bgp: color ids map to the same shades
+    for (uint16_t address = 0x8000; address < 0x8010; address += 2)
+    {
+        mem.write(address, 0x55);
+        mem.write(address + 1, 0x33);
+    }
+
+    // when: the first frame, and every 5th after it, is a keyframe
+    std::vector<frame> shades;
+    {
+        gb::video_capture capture{path, 5};
+        while (shades.size() < 12)
+        {
+            const uint64_t count = ppu.get_frame_count();
+            while (ppu.get_frame_count() == count)
+                ppu.tick(4, mem);
+            mem.write(0xFF43, static_cast<uint8_t>(shades.size())); // scx
+
+            frame& source = shades.emplace_back();
+            std::ranges::copy(ppu.get_shades(), source.begin());
+            capture.add_frame(source);
+        }
+    }
+
+    // then: the deltas aren't empty, the screen moved
+    for (size_t i = 2; i < shades.size(); i++)
+        ASSERT_NE(shades[i], shades[i - 1]) << "frame " << i;
+
+    // then: the records are keyframes where expected, deltas in between
+    std::ifstream file{path, std::ios::binary};
+    gb::video_capture_header header{};
+    ASSERT_TRUE(file.read(reinterpret_cast<char*>(&header), sizeof(header)));
+    EXPECT_EQ(header.keyframe_interval, 5);
+    for (size_t i = 0; i < shades.size(); i++)
+    {
+        gb::video_record_header record{};
+        ASSERT_TRUE(file.read(reinterpret_cast<char*>(&record), sizeof(record))) << "frame " << i;
+        EXPECT_EQ(record.keyframe, i % 5 == 0 ? 1 : 0) << "frame " << i;
+        file.seekg(record.size, std::ios::cur);
+    }
+
+    // then: they decode to the shades the ppu drew
+    gb::video_reader reader{path};
+    frame decoded{};
+    for (size_t i = 0; i < shades.size(); i++)
+    {
+        ASSERT_TRUE(reader.next_frame(decoded)) << "frame " << i;
+        ASSERT_EQ(decoded, shades[i]) << "frame " << i;
+    }
+    EXPECT_FALSE(reader.next_frame(decoded));
+}
+
+TEST_F(VideoCaptureTests, RejectsOtherFiles)
+{
+    // given:
+    std::ofstream{path} << "not a capture";
+
+    // then:
+    EXPECT_THROW(gb::video_reader{path}, std::runtime_error);
+}
@@ -0,0 +1,91 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <utility>
+
+#include "memory_map.h"
+
+namespace
+{
+    constexpr uint32_t CLOCKS_PER_SECOND = gb::apu::CYCLES_PER_SECOND / 4;
+    constexpr uint32_t FRAMES_PER_SECOND = 60;
+
+    struct scenario
+    {
+        const char* name;
+        std::initializer_list<std::pair<uint16_t, uint8_t>> setup;
+        uint32_t writes_per_frame; // frequency changes on channel 2
+    };
+
+    // all four channels sound in every scenario, what changes is how busy the music is
+    const scenario SCENARIOS[] = {
+        {"held notes", {{0xFF22, 0x51}}, 0},
+        {"busy music", {{0xFF22, 0x21}}, 20},
+        {"hiss", {{0xFF22, 0x00}}, 20}, // noise at its highest rate, a step every 8 cycles
+    };
+
+    // seconds of emulated time spent in the apu, with or without synthesis
+    double run(const scenario& s, uint32_t seconds, uint32_t sample_rate)
+    {
+        gb::memory_map mem{};
+        mem.write(0xFF26, 0x80); // nr52: power on
+        mem.write(0xFF24, 0x77); // nr50: full volume
+        mem.write(0xFF25, 0xFF); // nr51: everything both sides
+        mem.get_apu().set_synthesis(sample_rate, mem.get_clock());
+
+        for (const auto& [address, value] : std::initializer_list<std::pair<uint16_t, uint8_t>>{
+                 {0xFF11, 0x80}, {0xFF12, 0xF0}, {0xFF13, 0x00}, {0xFF14, 0x87}, // square, 50%
+                 {0xFF16, 0x40}, {0xFF17, 0xF0}, {0xFF18, 0x80}, {0xFF19, 0x87}, // square, 25%
+                 {0xFF1A, 0x80}, {0xFF1C, 0x20}, {0xFF1D, 0x00}, {0xFF1E, 0x87}, // wave
+                 {0xFF21, 0xF0}, {0xFF23, 0x80}}) // noise
+        {
+            mem.write(address, value);
+        }
+        for (const auto& [address, value] : s.setup)
+            mem.write(address, value);
+
+        const uint32_t slices = std::max(s.writes_per_frame, 1u);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < seconds * FRAMES_PER_SECOND; frame++)
+        {
+            for (uint32_t i = 0; i < slices; i++)
+            {
+                mem.advance_clock(CLOCKS_PER_SECOND / FRAMES_PER_SECOND / slices);
+                if (s.writes_per_frame)
+                    mem.write(0xFF18, static_cast<uint8_t>(frame + i));
+            }
+            mem.get_apu().synthesize(mem.get_clock());
+            mem.get_apu().clear_samples();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+// the cost of audio per emulated second, synthesis on against the registers alone
+int main(int argc, char* argv[])
+{
+    if (argc > 3)
+    {
+        std::cout << "Usage: gbemu_audio_bench [seconds] [sample rate]" << std::endl;
+        return -1;
+    }
+
+    const uint32_t seconds = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 60;
+    const uint32_t sample_rate = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 48000;
+    if (seconds == 0 || sample_rate == 0)
+    {
+        std::cout << "Usage: gbemu_audio_bench [seconds] [sample rate]" << std::endl;
+        return -1;
+    }
+
+    for (const scenario& s : SCENARIOS)
+    {
+        const double registers = run(s, seconds, 0);
+        const double synthesis = run(s, seconds, sample_rate);
+        std::cout << s.name << ": " << synthesis / seconds * 1000.0 << " ms per emulated second with synthesis, "
+                  << registers / seconds * 1000.0 << " ms without" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "batch.h"
+#include "metrics.h"
+
+// runs every job of a manifest headless, one emulator per job across all cores.
+// per job results go to stdout as csv, the summary to stderr. --metrics appends the runner's metrics to a file as
+// json lines while it runs, for watching long batches
+int main(int argc, char* argv[])
+{
+    std::vector<const char*> args;
+    std::optional<std::filesystem::path> metrics_path;
+    double metrics_interval = 10.0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+            metrics_path = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc)
+            metrics_interval = std::strtod(argv[++i], nullptr);
+        else
+            args.push_back(argv[i]);
+    }
+
+    // the reporter counts in milliseconds, anything shorter would be 0 and report nonstop
+    if (args.empty() || args.size() > 3 || !(metrics_interval >= 0.001))
+    {
+        std::cout << "Usage: gbemu_batch <manifest> [threads] [all|none|N] [--metrics file] [--metrics-interval s]"
+                  << std::endl;
+        std::cout << "manifest lines: <rom> <movie or -> <frames>" << std::endl;
+        std::cout << "frames drawn: all (default), none or every Nth, the last frame of a job always is" << std::endl;
+        std::cout << "metrics: a json line every 10 s (default, at least 0.001) and at the end" << std::endl;
+        return -1;
+    }
+
+    size_t threads = 0;
+    if (args.size() >= 2)
+        threads = std::strtoul(args[1], nullptr, 10);
+
+    ppu_render_policy render = ppu_render_policy::all;
+    uint32_t render_interval = 1;
+    if (args.size() == 3)
+    {
+        const std::string_view policy = args[2];
+        if (policy == "none")
+        {
+            render = ppu_render_policy::none;
+        }
+        else if (policy != "all")
+        {
+            render = ppu_render_policy::every_nth;
+            render_interval = static_cast<uint32_t>(std::strtoul(args[2], nullptr, 10));
+        }
+    }
+
+    try
+    {
+        const std::vector<gb::batch_job> jobs = gb::load_manifest(std::filesystem::absolute(args[0]));
+
+        gb::metrics_registry metrics;
+        std::ofstream metrics_file;
+        std::unique_ptr<gb::metrics_reporter> reporter;
+        if (metrics_path)
+        {
+            metrics_file.open(*metrics_path, std::ios::app);
+            if (!metrics_file)
+                throw std::runtime_error("Failed to open metrics file: " + metrics_path->string());
+            const auto interval = std::chrono::duration<double>(metrics_interval);
+            reporter = std::make_unique<gb::metrics_reporter>(
+                metrics, metrics_file, std::chrono::duration_cast<std::chrono::milliseconds>(interval));
+        }
+
+        const gb::batch_summary summary = gb::run_batch(jobs, threads, render, render_interval, &metrics);
+        reporter.reset(); // the last line
+
+        gb::write_batch_csv(std::cout, jobs, summary);
+
+        size_t failed = 0;
+        for (const gb::batch_result& result : summary.results)
+            failed += result.ok ? 0 : 1;
+
+        std::cerr << summary.results.size() << " instances (" << failed << " failed) on " << summary.threads
+                  << " threads in " << summary.seconds << " s: " << summary.instances_per_second()
+                  << " instances/s, " << summary.frames_per_second() << " frames/s, " << summary.steals
+                  << " steals" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ppu.h"
+#include "video_capture.h"
+
+namespace
+{
+    uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+    {
+        static const std::array<uint32_t, 256> table = []
+        {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = i;
+                for (int bit = 0; bit < 8; bit++)
+                    c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    uint32_t adler32(const std::vector<uint8_t>& data)
+    {
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : data)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        return b << 16 | a;
+    }
+
+    void put_u32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void put_chunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+    {
+        put_u32(png, static_cast<uint32_t>(data.size()));
+        const size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        put_u32(png, crc32(&png[start], png.size() - start));
+    }
+
+    // 2 bit palette png, the palette being the ppu's shades. the image data goes into stored deflate blocks, the
+    // captures are already small and this keeps the tool free of a zlib dependency
+    std::vector<uint8_t> encode_png(const std::vector<uint8_t>& shades, uint16_t width, uint16_t height)
+    {
+        std::vector<uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+        std::vector<uint8_t> ihdr;
+        put_u32(ihdr, width);
+        put_u32(ihdr, height);
+        ihdr.insert(ihdr.end(), {2, 3, 0, 0, 0}); // bit depth 2, indexed color, no interlace
+        put_chunk(png, "IHDR", ihdr);
+
+        std::vector<uint8_t> plte;
+        for (uint32_t color : gb::ppu::SHADE_COLORS)
+            plte.insert(plte.end(), {static_cast<uint8_t>(color >> 16), static_cast<uint8_t>(color >> 8),
+                                     static_cast<uint8_t>(color)});
+        put_chunk(png, "PLTE", plte);
+
+        // each row is a filter byte and the pixels, png wants the leftmost pixel in the high bits
+        const size_t row_size = width / 4;
+        std::vector<uint8_t> raw;
+        raw.reserve(height * (row_size + 1));
+        for (size_t y = 0; y < height; y++)
+        {
+            raw.push_back(0);
+            for (size_t x = 0; x < row_size; x++)
+            {
+                const uint8_t b = shades[y * row_size + x];
+                raw.push_back(static_cast<uint8_t>((b & 0x03) << 6 | (b & 0x0C) << 2 | (b & 0x30) >> 2 | b >> 6));
+            }
+        }
+
+        std::vector<uint8_t> idat{0x78, 0x01};
+        for (size_t offset = 0; offset < raw.size();)
+        {
+            const size_t size = std::min<size_t>(raw.size() - offset, 0xFFFF);
+            offset += size;
+            idat.push_back(offset == raw.size() ? 1 : 0);
+            idat.push_back(static_cast<uint8_t>(size));
+            idat.push_back(static_cast<uint8_t>(size >> 8));
+            idat.push_back(static_cast<uint8_t>(~size));
+            idat.push_back(static_cast<uint8_t>(~size >> 8));
+            idat.insert(idat.end(), raw.begin() + static_cast<std::ptrdiff_t>(offset - size),
+                        raw.begin() + static_cast<std::ptrdiff_t>(offset));
+        }
+        put_u32(idat, adler32(raw));
+        put_chunk(png, "IDAT", idat);
+
+        put_chunk(png, "IEND", {});
+        return png;
+    }
+}
+
+// decodes a capture written by gbemu --capture into one png per frame
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cout << "Usage: gbemu_capture2png <capture> <output directory>" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        gb::video_reader reader{argv[1]};
+        const std::filesystem::path directory = argv[2];
+        std::filesystem::create_directories(directory);
+
+        std::vector<uint8_t> shades(gb::ppu::PACKED_FRAME_SIZE);
+        uint64_t frames = 0;
+        while (reader.next_frame(shades))
+        {
+            std::ostringstream name;
+            name << "frame_" << std::setw(6) << std::setfill('0') << frames++ << ".png";
+
+            const std::vector<uint8_t> png = encode_png(shades, reader.width(), reader.height());
+            std::ofstream file{directory / name.str(), std::ios::binary};
+            if (!file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size())))
+                throw std::runtime_error("Failed to write " + (directory / name.str()).string());
+        }
+
+        std::cerr << frames << " frames written to " << directory.string() << std::endl;
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
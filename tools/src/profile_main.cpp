@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "input_movie.h"
+#include "profiler.h"
+
+// runs a rom from power on for a number of frames, optionally playing an input movie, and prints where the cpu
+// spent its cycles: per address as csv (default), per opcode as csv, or as folded stacks for a flame graph.
+// with a .sym file, the addresses are attributed to the labels they belong to
+int main(int argc, char* argv[])
+{
+    if (argc < 4)
+    {
+        std::cout << "Usage: gbemu_profile <rom> <movie or -> <frames> [--sym file] [--csv|--opcodes|--folded]"
+                  << std::endl;
+        return -1;
+    }
+
+    if constexpr (!gb::profiler::ENABLED)
+    {
+        std::cerr << "gbemu_profile needs a build with the profiler, configure with -DGB_PROFILE=ON" << std::endl;
+        return -1;
+    }
+
+    std::optional<std::filesystem::path> sym_path;
+    std::string_view format = "--csv";
+    for (int i = 4; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--sym") == 0 && i + 1 < argc)
+            sym_path = argv[++i];
+        else
+            format = argv[i];
+    }
+
+    try
+    {
+        // read before running, so a wrong path doesn't cost the whole run
+        std::optional<gb::symbol_table> symbols;
+        if (sym_path)
+            symbols.emplace(*sym_path);
+        const gb::symbol_table* labels = symbols ? &*symbols : nullptr;
+
+        gb::input_movie movie;
+        if (std::strcmp(argv[2], "-") != 0)
+            movie = gb::input_movie{argv[2]};
+        const uint64_t frames = std::strtoull(argv[3], nullptr, 10);
+
+        gb::gameboy gb{gb::cartridge::load_image(argv[1])};
+        gb::profiler profiler;
+        gb.cpu.set_profiler(&profiler);
+        for (uint64_t frame = 0; frame < frames; frame++)
+        {
+            gb.mem.set_buttons(movie.get_buttons(frame));
+            gb.run_frame();
+        }
+        gb.cpu.set_profiler(nullptr);
+
+        if (format == "--opcodes")
+            profiler.write_opcode_csv(std::cout);
+        else if (format == "--folded")
+            profiler.write_folded(std::cout, labels);
+        else
+            profiler.write_csv(std::cout, labels);
+        std::cerr << profiler.total_cycles() << " cycles in " << frames << " frames" << std::endl;
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
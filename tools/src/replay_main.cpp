@@ -0,0 +1,60 @@
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "replay.h"
+
+// replays an input movie from power on, like gbemu_batch does. --record stores the state hash of every frame in
+// the movie, without it the replay is checked against the stored hashes and the first frame that differs is
+// reported, for finding where a change to the emulator made a recorded run go differently
+int main(int argc, char* argv[])
+{
+    const bool record = argc == 4 && std::strcmp(argv[3], "--record") == 0;
+    if (argc != 3 && !record)
+    {
+        std::cout << "Usage: gbemu_replay <rom> <movie> [--record]" << std::endl;
+        return -1;
+    }
+
+    try
+    {
+        const std::filesystem::path movie_path = argv[2];
+        gb::input_movie movie{movie_path};
+        gb::gameboy gb{gb::cartridge::load_image(argv[1])};
+
+        if (record)
+        {
+            gb::record_hashes(gb, movie);
+            movie.save(movie_path);
+            std::cout << "recorded state hashes for " << movie.frame_count() << " frames" << std::endl;
+            return 0;
+        }
+
+        if (!movie.has_hashes())
+        {
+            std::cerr << movie_path.string() << " has no state hashes, record them with --record" << std::endl;
+            return -1;
+        }
+
+        const gb::replay_result result = gb::verify_replay(gb, movie);
+        if (!result.diverged)
+        {
+            std::cout << "replay matches for all " << result.frames << " frames" << std::endl;
+            return 0;
+        }
+
+        std::cout << "replay diverges at frame " << result.first_divergence << ": expected " << std::hex
+                  << std::setfill('0') << std::setw(16) << result.expected_hash << ", got " << std::setw(16)
+                  << result.actual_hash << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}